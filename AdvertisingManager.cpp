@@ -0,0 +1,87 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "AdvertisingManager.h"
+
+AdvertisingManager::AdvertisingManager(uint32_t slowDurationUs) :
+    slowDuration(slowDurationUs),
+    phase(PHASE_NONE),
+    appliedPhase(PHASE_NONE),
+    phaseStart(0)
+{
+    /* empty */
+}
+
+void AdvertisingManager::start(uint32_t now, bool directed)
+{
+    phase      = directed ? PHASE_DIRECTED : PHASE_FAST;
+    phaseStart = now;
+}
+
+void AdvertisingManager::stop(void)
+{
+    /* The stack stops advertising by itself on connection; nothing to apply. */
+    phase        = PHASE_NONE;
+    appliedPhase = PHASE_NONE;
+}
+
+void AdvertisingManager::slowDown(uint32_t now)
+{
+    if ((phase == PHASE_DIRECTED) || (phase == PHASE_FAST)) {
+        phase      = PHASE_SLOW;
+        phaseStart = now;
+    }
+}
+
+bool AdvertisingManager::getNextDeadline(uint32_t &when) const
+{
+    if (phase != appliedPhase) {
+        when = phaseStart; /* due now */
+        return true;
+    }
+    switch (phase) {
+        case PHASE_DIRECTED:
+            when = phaseStart + DIRECTED_DURATION_US;
+            return true;
+        case PHASE_FAST:
+            when = phaseStart + FAST_DURATION_US;
+            return true;
+        case PHASE_SLOW:
+            if (slowDuration == 0) {
+                return false;
+            }
+            when = phaseStart + slowDuration;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool AdvertisingManager::poll(uint32_t now, Phase &newPhase)
+{
+    uint32_t deadline;
+    if ((phase == appliedPhase) && getNextDeadline(deadline) && ((int32_t)(now - deadline) >= 0)) {
+        phase      = (phase == PHASE_DIRECTED) ? PHASE_FAST : ((phase == PHASE_FAST) ? PHASE_SLOW : PHASE_IDLE);
+        phaseStart = now;
+    }
+
+    if (phase == appliedPhase) {
+        return false;
+    }
+    appliedPhase = phase;
+    newPhase     = phase;
+    return true;
+}
@@ -0,0 +1,94 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADVERTISING_MANAGER_H__
+#define __ADVERTISING_MANAGER_H__
+
+#include <stdint.h>
+
+/**
+ * Phased advertising state machine.
+ *
+ * After boot or a disconnection the device advertises fast so that a central
+ * that just lost the link reconnects quickly, then backs off to a slow
+ * interval, and finally stops altogether once the idle timeout expires. When
+ * the last central is known, fast advertising is preceded by a burst of
+ * high duty cycle directed advertising at it, which the SoftDevice ends on
+ * its own after DIRECTED_DURATION_US; a central still scanning for us picks
+ * that up within a few milliseconds.
+ *
+ * The manager only tracks phases; the caller applies them through BLEDevice,
+ * with the intervals of the product (see Sku.h), whenever poll() reports a
+ * change. Times are in microseconds from a free-running 32-bit clock.
+ */
+class AdvertisingManager {
+public:
+    enum Phase {
+        PHASE_NONE,   /* connected, or not started yet */
+        PHASE_DIRECTED,
+        PHASE_FAST,
+        PHASE_SLOW,
+        PHASE_IDLE    /* timed out; advertising stopped */
+    };
+
+    static const uint32_t FAST_DURATION_US     = 30000000;
+    static const uint32_t DIRECTED_DURATION_US = 1280000; /* fixed by the spec for high duty cycle directed */
+
+public:
+    /**
+     * @param slowDurationUs
+     *          How long to keep advertising slowly before going idle; 0 to
+     *          advertise forever.
+     */
+    AdvertisingManager(uint32_t slowDurationUs);
+
+    /**
+     * (Re)start from the fast phase, e.g. at boot, after a disconnection or
+     * on a button press while idle; from the directed phase if 'directed'.
+     */
+    void start(uint32_t now, bool directed = false);
+
+    /**
+     * Stop advertising because a central has connected.
+     */
+    void stop(void);
+
+    /**
+     * Skip ahead to the slow phase, e.g. while nobody is wearing the sensor.
+     * Does nothing unless advertising fast.
+     */
+    void slowDown(uint32_t now);
+
+    /**
+     * Returns true if the phase changed since the last call; 'phase' is set
+     * to the phase that now needs to be applied.
+     */
+    bool poll(uint32_t now, Phase &phase);
+
+    bool getNextDeadline(uint32_t &when) const;
+
+    Phase getPhase(void) const {
+        return phase;
+    }
+
+private:
+    uint32_t slowDuration;
+    Phase    phase;
+    Phase    appliedPhase;
+    uint32_t phaseStart;
+};
+
+#endif /* #ifndef __ADVERTISING_MANAGER_H__ */
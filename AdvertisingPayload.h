@@ -0,0 +1,95 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ADVERTISING_PAYLOAD_H__
+#define __ADVERTISING_PAYLOAD_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+
+/*
+ * Building blocks for advertising and scan response payloads that are laid
+ * out at compile time. Each AD structure is a POD made of bytes only, so it
+ * has no padding, its size is known to the compiler and a 'static const'
+ * instance is placed in flash. Payloads that would not fit are rejected by
+ * ADV_PAYLOAD_ASSERT() when the firmware is built.
+ */
+
+#define ADV_PAYLOAD_MAX_SIZE 31 /* bytes, for both the advertisement and the scan response */
+
+#define ADV_PAYLOAD_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]
+
+#define ADV_UINT16(value) (uint8_t)((value) & 0xFF), (uint8_t)(((value) >> 8) & 0xFF)
+
+/**
+ * One AD structure: length (of type and data), AD type, data.
+ */
+template <unsigned DATA_LENGTH>
+struct AdStructure {
+    enum { SIZE = 2 + DATA_LENGTH };
+
+    uint8_t length;
+    uint8_t type;
+    uint8_t data[DATA_LENGTH];
+};
+
+/**
+ * An AD structure carrying a string, initialised straight from a string
+ * literal. STRING_SIZE includes the terminating NUL, which is stored (C++
+ * insists on it) but is not counted in SIZE or in 'length' and is never put
+ * on the air. Because of that NUL it must be the last fragment of a payload.
+ */
+template <unsigned STRING_SIZE>
+struct AdStringStructure {
+    enum { SIZE = 1 + STRING_SIZE };
+
+    uint8_t length;
+    uint8_t type;
+    uint8_t data[STRING_SIZE];
+};
+
+/**
+ * Two payload fragments back to back.
+ */
+template <typename FIRST, typename SECOND>
+struct AdSequence {
+    enum { SIZE = FIRST::SIZE + SECOND::SIZE };
+
+    FIRST  first;
+    SECOND second;
+};
+
+/**
+ * Hand a compile-time payload image to BLEDevice, one AD structure at a
+ * time. The image lives in flash; this just walks it.
+ */
+template <typename IMAGE>
+void accumulateAdvertisingImage(BLEDevice &ble, const IMAGE &image, bool scanResponse)
+{
+    const uint8_t *p   = reinterpret_cast<const uint8_t *>(&image);
+    const uint8_t *end = p + IMAGE::SIZE;
+    while (((p + 2) <= end) && (p[0] != 0)) {
+        GapAdvertisingData::DataType type = static_cast<GapAdvertisingData::DataType>(p[1]);
+        if (scanResponse) {
+            ble.accumulateScanResponse(type, p + 2, p[0] - 1);
+        } else {
+            ble.accumulateAdvertisingPayload(type, p + 2, p[0] - 1);
+        }
+        p += 1 + p[0];
+    }
+}
+
+#endif /* #ifndef __ADVERTISING_PAYLOAD_H__ */
@@ -0,0 +1,88 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatteryMonitor.h"
+
+/* CR2032 under a light load; linear between the points. */
+static const struct {
+    uint16_t millivolts;
+    uint8_t  level;
+} dischargeCurve[] = {
+    {3000, 100},
+    {2900, 90},
+    {2800, 75},
+    {2700, 55},
+    {2600, 35},
+    {2500, 20},
+    {2400, 10},
+    {2200, 0}
+};
+static const unsigned CURVE_POINTS = sizeof(dischargeCurve) / sizeof(dischargeCurve[0]);
+
+BatteryMonitor::BatteryMonitor() :
+    haveReading(false), filtered(0), level(0), interval(IDLE_INTERVAL_US), lastSampleTime(0)
+{
+    /* empty */
+}
+
+void BatteryMonitor::setLoad(Load load)
+{
+    switch (load) {
+        case LOAD_STREAMING:
+            interval = STREAMING_INTERVAL_US;
+            break;
+        case LOAD_CONNECTED:
+            interval = CONNECTED_INTERVAL_US;
+            break;
+        default:
+            interval = IDLE_INTERVAL_US;
+            break;
+    }
+}
+
+uint8_t BatteryMonitor::levelFor(uint16_t millivolts)
+{
+    if (millivolts >= dischargeCurve[0].millivolts) {
+        return dischargeCurve[0].level;
+    }
+    for (unsigned i = 1; i < CURVE_POINTS; i++) {
+        if (millivolts >= dischargeCurve[i].millivolts) {
+            unsigned span  = dischargeCurve[i - 1].millivolts - dischargeCurve[i].millivolts;
+            unsigned range = dischargeCurve[i - 1].level - dischargeCurve[i].level;
+            return (uint8_t)(dischargeCurve[i].level + (((millivolts - dischargeCurve[i].millivolts) * range) / span));
+        }
+    }
+    return 0;
+}
+
+bool BatteryMonitor::addReading(uint16_t millivolts, uint32_t now)
+{
+    uint32_t sample = (uint32_t)millivolts << 4;
+    if (!haveReading) {
+        filtered    = sample; /* the first reading seeds the filter */
+        haveReading = true;
+    } else {
+        filtered = (uint32_t)((int32_t)filtered + (((int32_t)sample - (int32_t)filtered) >> 2));
+    }
+    lastSampleTime = now;
+
+    uint8_t newLevel = levelFor((uint16_t)((filtered + 8) >> 4));
+    if (newLevel == level) {
+        return false;
+    }
+    level = newLevel;
+    return true;
+}
@@ -0,0 +1,85 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BATTERY_MONITOR_H__
+#define __BATTERY_MONITOR_H__
+
+#include <stdint.h>
+
+/**
+ * Decides when to measure the supply and turns readings into the Battery
+ * Level percentage.
+ *
+ * Measurements are rare and get rarer the less the radio does: a coin cell
+ * sags most under load, so that is when the level moves. Readings are
+ * smoothed before being mapped onto a coin-cell discharge curve, so that a
+ * single reading taken during a radio event doesn't make the level jump
+ * about; the level is only reported as changed when the whole percentage
+ * changes.
+ */
+class BatteryMonitor {
+public:
+    enum Load {
+        LOAD_IDLE,      /* advertising or asleep */
+        LOAD_CONNECTED,
+        LOAD_STREAMING  /* bulk transfers */
+    };
+
+    static const uint32_t IDLE_INTERVAL_US      = 600000000; /* 10 minutes */
+    static const uint32_t CONNECTED_INTERVAL_US = 120000000;
+    static const uint32_t STREAMING_INTERVAL_US = 30000000;
+    static const uint8_t  LOW_LEVEL             = 10; /* percent */
+
+public:
+    BatteryMonitor();
+
+    /**
+     * A heavier load brings the next measurement forward.
+     */
+    void setLoad(Load load);
+
+    bool sampleDue(uint32_t now) const {
+        return !haveReading || ((int32_t)(now - getNextSampleTime()) >= 0);
+    }
+
+    uint32_t getNextSampleTime(void) const {
+        return lastSampleTime + interval;
+    }
+
+    /**
+     * Feed a supply measurement. Returns true if the level changed.
+     */
+    bool addReading(uint16_t millivolts, uint32_t now);
+
+    uint8_t getLevel(void) const {
+        return level;
+    }
+
+    bool isLow(void) const {
+        return haveReading && (level <= LOW_LEVEL);
+    }
+
+    static uint8_t levelFor(uint16_t millivolts);
+
+private:
+    bool     haveReading;
+    uint32_t filtered;  /* millivolts, Q4 */
+    uint8_t  level;
+    uint32_t interval;
+    uint32_t lastSampleTime;
+};
+
+#endif /* #ifndef __BATTERY_MONITOR_H__ */
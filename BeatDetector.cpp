@@ -0,0 +1,161 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BeatDetector.h"
+
+BeatDetector::BeatDetector()
+{
+    reset();
+}
+
+void BeatDetector::reset(void)
+{
+    dcLevel           = -1; /* primed from the first sample */
+    lowPass           = 0;
+    lowPassHistory[0] = 0;
+    lowPassHistory[1] = 0;
+
+    for (unsigned i = 0; i < INTEGRATOR_WINDOW; i++) {
+        window[i] = 0;
+    }
+    windowSum   = 0;
+    windowIndex = 0;
+
+    signalLevel      = 0;
+    noiseLevel       = 0;
+    threshold        = 0;
+    candidatePeak    = 0;
+    inPeak           = false;
+    samplesSinceBeat = 0;
+    samplesSincePeak = 0;
+    seenFirstBeat    = false;
+
+    for (unsigned i = 0; i < RR_HISTORY; i++) {
+        rrHistory[i] = 0;
+    }
+    rrIndex         = 0;
+    validIntervals  = 0;
+    averageInterval = 0;
+    heartRate       = 0;
+}
+
+bool BeatDetector::process(uint16_t sample, Beat &beat)
+{
+    int32_t x = (int32_t)sample << 4; /* Q4 to keep precision in the filters below */
+
+    /* High-pass: subtract a slow DC estimate (corner around 0.3Hz at 128Hz). */
+    if (dcLevel < 0) {
+        dcLevel = x;
+    }
+    dcLevel += (x - dcLevel) >> 6;
+    int32_t highPass = x - dcLevel;
+
+    /* Low-pass: single pole, corner around 5Hz at 128Hz. */
+    lowPass += (highPass - lowPass) >> 2;
+
+    /* Derivative over two samples; only the rising edge of the pulse matters. */
+    int32_t slope = lowPass - lowPassHistory[1];
+    lowPassHistory[1] = lowPassHistory[0];
+    lowPassHistory[0] = lowPass;
+    uint32_t energy = (slope > 0) ? ((uint32_t)slope >> 4) : 0;
+
+    /* Moving-window integration. */
+    windowSum -= window[windowIndex];
+    window[windowIndex] = energy;
+    windowSum += energy;
+    windowIndex = (windowIndex + 1) & (INTEGRATOR_WINDOW - 1);
+
+    samplesSinceBeat++;
+
+    /* Adaptive threshold peak picker. */
+    bool detected = false;
+    if (windowSum > threshold) {
+        if (!inPeak || (windowSum > candidatePeak)) {
+            candidatePeak    = windowSum;
+            samplesSincePeak = 0;
+        }
+        inPeak = true;
+    } else if (inPeak) {
+        inPeak = false;
+        uint32_t interval = samplesSinceBeat - samplesSincePeak;
+        /* A weak peak well before the next beat is due is the dicrotic notch, not a beat. */
+        bool early = (validIntervals > 0) && (interval < ((uint32_t)averageInterval * 5) / 8) &&
+                     (candidatePeak < (signalLevel >> 1));
+        if (!seenFirstBeat || ((interval >= REFRACTORY_SAMPLES) && !early)) {
+            /* Peak accepted as a beat; locate it at the integrator maximum. */
+            if (seenFirstBeat) {
+                signalLevel = signalLevel - (signalLevel >> 2) + (candidatePeak >> 2);
+            } else {
+                signalLevel = candidatePeak; /* seed from the first pulse so the dicrotic wave can't bootstrap */
+            }
+            samplesSinceBeat = samplesSincePeak;
+            if (seenFirstBeat) {
+                detected = acceptBeat(interval, beat);
+            }
+            seenFirstBeat = true;
+        } else {
+            /* Inside the refractory period: treat it as noise. */
+            noiseLevel = noiseLevel - (noiseLevel >> 3) + (candidatePeak >> 3);
+        }
+        threshold = noiseLevel + ((signalLevel > noiseLevel) ? ((signalLevel - noiseLevel) >> 1) : 0);
+    } else {
+        /* Between peaks the integrator output is the noise floor. */
+        noiseLevel = noiseLevel - (noiseLevel >> 6) + (windowSum >> 6);
+        threshold  = noiseLevel + ((signalLevel > noiseLevel) ? ((signalLevel - noiseLevel) >> 1) : 0);
+    }
+    samplesSincePeak++;
+
+    /* Lost the rhythm: let the signal estimate decay so that a weaker pulse is picked up again. */
+    if (samplesSinceBeat > MAX_RR_SAMPLES) {
+        signalLevel      -= signalLevel >> 2;
+        samplesSinceBeat  = 0;
+        seenFirstBeat     = false;
+        validIntervals    = 0;
+    }
+
+    return detected;
+}
+
+void BeatDetector::skip(unsigned missingSamples)
+{
+    samplesSinceBeat += missingSamples;
+    samplesSincePeak += missingSamples;
+    inPeak            = false;
+}
+
+bool BeatDetector::acceptBeat(uint32_t rrSamples, Beat &beat)
+{
+    if ((rrSamples < REFRACTORY_SAMPLES) || (rrSamples > MAX_RR_SAMPLES)) {
+        return false;
+    }
+
+    rrHistory[rrIndex] = (uint16_t)rrSamples;
+    rrIndex = (rrIndex + 1) % RR_HISTORY;
+    if (validIntervals < RR_HISTORY) {
+        validIntervals++;
+    }
+
+    uint32_t sum = 0;
+    for (unsigned i = 0; i < validIntervals; i++) { /* bounded by RR_HISTORY */
+        sum += rrHistory[(rrIndex + RR_HISTORY - 1 - i) % RR_HISTORY];
+    }
+    averageInterval = (uint16_t)(sum / validIntervals);
+    heartRate       = (uint16_t)(((60 * SAMPLE_RATE_HZ * validIntervals) + (sum / 2)) / sum);
+
+    beat.rrInterval = (uint16_t)((rrSamples * 1024) / SAMPLE_RATE_HZ);
+    beat.heartRate  = heartRate;
+    return true;
+}
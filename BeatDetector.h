@@ -0,0 +1,107 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BEAT_DETECTOR_H__
+#define __BEAT_DETECTOR_H__
+
+#include <stdint.h>
+
+/**
+ * Streaming beat detector for a PPG signal sampled at a fixed rate.
+ *
+ * Each sample goes through a band-pass filter (DC-removal high-pass followed
+ * by a single-pole low-pass), a derivative, a positive-slope moving-window
+ * integrator and finally an adaptive-threshold peak picker in the style of
+ * Pan-Tompkins. Everything is integer arithmetic on fixed-size state: there
+ * is no heap usage and no per-sample loop, so the cost of process() is a
+ * small constant number of cycles (no divisions except when a beat is
+ * accepted, which happens at most once per refractory period).
+ */
+class BeatDetector {
+public:
+    static const unsigned SAMPLE_RATE_HZ      = 128;
+    static const unsigned INTEGRATOR_WINDOW   = 16;                       /* 125ms; must be a power of two. */
+    static const unsigned REFRACTORY_SAMPLES  = (SAMPLE_RATE_HZ * 250) / 1000;  /* 240 BPM ceiling. */
+    static const unsigned MAX_RR_SAMPLES      = SAMPLE_RATE_HZ * 2;        /* 30 BPM floor. */
+    static const unsigned RR_HISTORY          = 4;                        /* beats averaged into the heart rate. */
+
+    /**
+     * A detected beat. 'rrInterval' is in units of 1/1024 second, which is
+     * what the Heart Rate Measurement characteristic carries on the air.
+     */
+    struct Beat {
+        uint16_t rrInterval;
+        uint16_t heartRate; /* beats per minute, averaged over RR_HISTORY beats */
+    };
+
+public:
+    BeatDetector();
+
+    void reset(void);
+
+    /**
+     * Feed one raw sample. Returns true and fills in 'beat' if the sample
+     * completes a beat that passed the plausibility checks.
+     */
+    bool process(uint16_t sample, Beat &beat);
+
+    /**
+     * Account for 'missingSamples' samples that were lost upstream (e.g. on a
+     * ring overflow). Time keeps running so that the next RR-interval is
+     * still measured correctly, but any peak in progress is abandoned.
+     */
+    void skip(unsigned missingSamples);
+
+    /**
+     * Most recent averaged heart rate in BPM, or 0 if no rhythm is locked.
+     */
+    uint16_t getHeartRate(void) const {
+        return (validIntervals > 0) ? heartRate : 0;
+    }
+
+private:
+    bool acceptBeat(uint32_t rrSamples, Beat &beat);
+
+private:
+    /* band-pass and derivative */
+    int32_t  dcLevel;      /* Q4 */
+    int32_t  lowPass;      /* Q4 */
+    int32_t  lowPassHistory[2];
+
+    /* moving-window integrator */
+    uint32_t window[INTEGRATOR_WINDOW];
+    uint32_t windowSum;
+    unsigned windowIndex;
+
+    /* peak picker */
+    uint32_t signalLevel;
+    uint32_t noiseLevel;
+    uint32_t threshold;
+    uint32_t candidatePeak;
+    bool     inPeak;
+    uint32_t samplesSinceBeat;
+    uint32_t samplesSincePeak;
+    bool     seenFirstBeat;
+
+    /* rate estimate */
+    uint16_t rrHistory[RR_HISTORY]; /* in samples */
+    unsigned rrIndex;
+    unsigned validIntervals;
+    uint16_t averageInterval; /* in samples */
+    uint16_t heartRate;
+};
+
+#endif /* #ifndef __BEAT_DETECTOR_H__ */
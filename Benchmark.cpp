@@ -0,0 +1,181 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Benchmark.h"
+
+#if BENCHMARK_SCENARIO
+
+#include "mbed.h"
+#include "SensorAcquisition.h"
+
+#define BENCHMARK_WINDOW_PIN p20
+#define BENCHMARK_EVENT_PIN  p21
+
+Benchmark benchmark;
+
+static DigitalOut windowMarker(BENCHMARK_WINDOW_PIN);
+static DigitalOut eventMarker(BENCHMARK_EVENT_PIN);
+
+/* One pulse period of a PPG-like waveform: systolic peak, dicrotic notch, diastolic wave. */
+static const uint16_t pulseShape[32] = {
+      0,  400, 1400, 2800, 3800, 4000, 3600, 3000,
+   2400, 1900, 1600, 1500, 1600, 1700, 1650, 1500,
+   1300, 1100,  900,  750,  600,  500,  400,  320,
+    250,  190,  140,  100,   70,   40,   20,   10,
+};
+static const uint16_t SYNTHETIC_BASELINE = 30000;
+
+static unsigned scenarioHeartRate(void)
+{
+    return (BENCHMARK_SCENARIO == BENCHMARK_CONNECTED_180BPM) ? 180 : 60;
+}
+
+Benchmark::Benchmark() :
+    windowOpen(false),
+    windowPending(false),
+    windowStart(0),
+    connected(false),
+    connectedAt(0)
+{
+    memset(&counters, 0, sizeof(counters));
+    memset(&reported, 0, sizeof(reported));
+}
+
+void Benchmark::begin(uint32_t now)
+{
+    windowMarker = 0;
+    eventMarker  = 0;
+    if (BENCHMARK_SCENARIO == BENCHMARK_IDLE_ADVERTISING) {
+        windowPending = true;
+        windowStart   = now + WARM_UP_US;
+    }
+}
+
+void Benchmark::openWindow(uint32_t now)
+{
+    memset(&counters, 0, sizeof(counters));
+    windowOpen    = true;
+    windowPending = false;
+    windowStart   = now;
+    windowMarker  = 1;
+}
+
+void Benchmark::markEvent(void)
+{
+    eventMarker = !eventMarker;
+}
+
+void Benchmark::onConnected(uint32_t now)
+{
+    connected   = true;
+    connectedAt = now;
+    counters.connections++;
+    markEvent();
+    if (!windowOpen && !windowPending && (BENCHMARK_SCENARIO != BENCHMARK_IDLE_ADVERTISING)) {
+        /* The storm measures the reconnections themselves, so it opens straight away. */
+        windowPending = true;
+        windowStart   = (BENCHMARK_SCENARIO == BENCHMARK_RECONNECT_STORM) ? now : (now + WARM_UP_US);
+    }
+}
+
+void Benchmark::onDisconnected(void)
+{
+    connected = false;
+    counters.disconnections++;
+    markEvent();
+}
+
+void Benchmark::onTransmissionComplete(unsigned count)
+{
+    counters.txComplete += count;
+    markEvent();
+}
+
+void Benchmark::onNotification(void)
+{
+    counters.notifications++;
+}
+
+void Benchmark::onAdvertisingPhase(void)
+{
+    counters.advertisingChanges++;
+    markEvent();
+}
+
+void Benchmark::onBeat(void)
+{
+    counters.beats++;
+}
+
+void Benchmark::onWakeup(void)
+{
+    counters.wakeups++;
+}
+
+Benchmark::Action Benchmark::poll(uint32_t now)
+{
+    if (windowPending && ((int32_t)(now - windowStart) >= 0)) {
+        openWindow(now);
+    }
+
+    if (windowOpen && ((now - windowStart) >= WINDOW_US)) {
+        counters.windowUs = now - windowStart;
+        reported          = counters;
+        windowMarker      = 0; /* a short low pulse separates back-to-back windows */
+        openWindow(now);
+        return ACTION_REPORT;
+    }
+
+    if ((BENCHMARK_SCENARIO == BENCHMARK_RECONNECT_STORM) && connected &&
+        ((now - connectedAt) >= STORM_HOLD_US)) {
+        connected = false; /* only ask once per connection */
+        return ACTION_DISCONNECT;
+    }
+    return ACTION_NONE;
+}
+
+bool Benchmark::getNextDeadline(uint32_t &when) const
+{
+    bool have = false;
+    if (windowPending) {
+        when = windowStart;
+        have = true;
+    } else if (windowOpen) {
+        when = windowStart + WINDOW_US;
+        have = true;
+    }
+    if ((BENCHMARK_SCENARIO == BENCHMARK_RECONNECT_STORM) && connected) {
+        uint32_t drop = connectedAt + STORM_HOLD_US;
+        if (!have || ((int32_t)(drop - when) < 0)) {
+            when = drop;
+            have = true;
+        }
+    }
+    return have;
+}
+
+uint16_t Benchmark::syntheticSample(void)
+{
+    /* 16-bit phase accumulator advanced once per sample: bpm / 60 / SAMPLE_RATE_HZ of a period. */
+    static uint16_t phase = 0;
+    static uint32_t noise = 12345; /* fixed seed: every run sees the same input */
+
+    phase += (uint16_t)((scenarioHeartRate() * 65536UL) / (60 * SensorAcquisition::SAMPLE_RATE_HZ));
+    noise  = (noise * 1103515245UL) + 12345;
+    return SYNTHETIC_BASELINE + pulseShape[phase >> 11] + ((noise >> 24) & 0x3F);
+}
+
+#endif /* #if BENCHMARK_SCENARIO */
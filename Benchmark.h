@@ -0,0 +1,125 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <stdint.h>
+
+/**
+ * Power-profiling scenarios. Building with BENCHMARK_SCENARIO set to one of
+ * these runs the normal firmware with scripted input:
+ *
+ *  - IDLE_ADVERTISING: no central is expected; measures the advertising phases.
+ *  - CONNECTED_REST:   synthetic 60 BPM pulse once a central connects.
+ *  - CONNECTED_180BPM: synthetic 180 BPM pulse once a central connects.
+ *  - RECONNECT_STORM:  synthetic 60 BPM; the device drops the link every
+ *                      STORM_HOLD_US and the central is expected to reconnect.
+ */
+enum BenchmarkScenario {
+    BENCHMARK_NONE = 0,
+    BENCHMARK_IDLE_ADVERTISING,
+    BENCHMARK_CONNECTED_REST,
+    BENCHMARK_CONNECTED_180BPM,
+    BENCHMARK_RECONNECT_STORM
+};
+
+#define BENCHMARK_SCENARIO BENCHMARK_NONE /* Set this to build the power-profiling firmware; results are
+                                           * printed on the console once per measurement window. */
+
+/**
+ * Scenario driver and radio-event counters. The measurement window is
+ * marked on BENCHMARK_WINDOW_PIN (high while measuring) and every radio
+ * event toggles BENCHMARK_EVENT_PIN, so that a power analyser trace can be
+ * lined up with firmware phases. Inputs are deterministic and the window
+ * lengths are fixed, so results are comparable across commits.
+ */
+class Benchmark {
+public:
+    static const unsigned FORMAT_VERSION   = 1;
+    static const uint32_t WARM_UP_US       = 5000000;  /* settle before the window opens */
+    static const uint32_t WINDOW_US        = 60000000;
+    static const uint32_t STORM_HOLD_US    = 2000000;
+
+    enum Action {
+        ACTION_NONE,
+        ACTION_REPORT,     /* a window has closed; print getCounters() */
+        ACTION_DISCONNECT  /* reconnect storm: drop the link now */
+    };
+
+    struct Counters {
+        uint32_t windowUs;
+        uint32_t notifications;
+        uint32_t txComplete;     /* packets reported by onDataSent() */
+        uint32_t connections;
+        uint32_t disconnections;
+        uint32_t advertisingChanges;
+        uint32_t wakeups;        /* returns from waitForEvent() */
+        uint32_t beats;
+    };
+
+public:
+    Benchmark();
+
+    void begin(uint32_t now);
+
+    void onConnected(uint32_t now);
+    void onDisconnected(void);
+    void onTransmissionComplete(unsigned count);
+    void onNotification(void);
+    void onAdvertisingPhase(void);
+    void onBeat(void);
+    void onWakeup(void);
+
+    Action poll(uint32_t now);
+    bool   getNextDeadline(uint32_t &when) const;
+
+    /**
+     * Counters of the window that just closed; valid after ACTION_REPORT.
+     */
+    const Counters &getCounters(void) const {
+        return reported;
+    }
+
+    /**
+     * Synthetic PPG waveform at the scenario's heart rate; installed as the
+     * SensorAcquisition sample source. Runs in interrupt context.
+     */
+    static uint16_t syntheticSample(void);
+
+private:
+    void openWindow(uint32_t now);
+    void markEvent(void);
+
+private:
+    bool     windowOpen;
+    bool     windowPending;
+    uint32_t windowStart;
+    bool     connected;
+    uint32_t connectedAt;
+    Counters counters;
+    Counters reported;
+};
+
+extern Benchmark benchmark;
+
+#if BENCHMARK_SCENARIO
+#define BENCHMARK_HOOK(call) benchmark.call
+#else
+#define BENCHMARK_HOOK(call) /* nothing */
+#endif /* #if BENCHMARK_SCENARIO */
+
+#endif /* #ifndef __BENCHMARK_H__ */
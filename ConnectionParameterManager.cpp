@@ -0,0 +1,210 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConnectionParameterManager.h"
+
+/*
+ * Intervals are in units of 1.25ms, supervision timeouts in units of 10ms.
+ * Each profile satisfies: max >= min + 15ms, max * (latency + 1) <= 2s and
+ * timeout > 3 * max * (latency + 1).
+ */
+static const Gap::ConnectionParams_t profileTable[ConnectionParameterManager::NUM_PROFILES] = {
+    /* min,  max, latency, timeout */
+    {   80,  100,       4,     400}, /* PROFILE_REST:      100-125ms, effective 625ms */
+    {   40,   56,       2,     200}, /* PROFILE_ACTIVE:     50-70ms,  effective 210ms */
+    {  160,  200,       4,     600}, /* PROFILE_LOW_POWER: 200-250ms, effective 1.25s */
+    {   12,   24,       0,     200}, /* PROFILE_BULK:       15-30ms */
+};
+
+ConnectionParameterManager::ConnectionParameterManager() :
+    connected(false),
+    connectedAt(0),
+    windowStart(0),
+    windowCount(0),
+    notificationRate(0),
+    linkQuality(100),
+    batteryLow(false),
+    bulkTransfer(false),
+    negotiated(false),
+    current(PROFILE_REST),
+    currentPoorLink(false),
+    candidate(PROFILE_REST),
+    candidatePoorLink(false),
+    candidateSince(0),
+    requested(PROFILE_REST),
+    requestedPoorLink(false),
+    lastSuccess(0),
+    lastAttempt(0),
+    failures(0)
+{
+    /* empty */
+}
+
+void ConnectionParameterManager::onConnected(uint32_t now)
+{
+    connected        = true;
+    connectedAt      = now;
+    windowStart      = now;
+    windowCount      = 0;
+    notificationRate = 0;
+    negotiated       = false;
+    current          = PROFILE_REST;
+    candidate        = PROFILE_REST;
+    candidateSince   = now;
+    failures         = 0;
+}
+
+void ConnectionParameterManager::onDisconnected(void)
+{
+    connected    = false;
+    bulkTransfer = false;
+}
+
+void ConnectionParameterManager::notificationSent(uint32_t now)
+{
+    rollRateWindow(now);
+    windowCount++;
+}
+
+void ConnectionParameterManager::rollRateWindow(uint32_t now)
+{
+    if (elapsed(now, windowStart, RATE_WINDOW_US)) {
+        /* A window with no traffic at all also resets the rate, so an idle link drops back to rest. */
+        notificationRate = elapsed(now, windowStart, 2 * RATE_WINDOW_US) ? 0 : windowCount;
+        windowCount      = 0;
+        windowStart      = now;
+    }
+}
+
+ConnectionParameterManager::Profile ConnectionParameterManager::selectProfile(void) const
+{
+    if (bulkTransfer) {
+        return PROFILE_BULK;
+    }
+    if (batteryLow) {
+        return PROFILE_LOW_POWER;
+    }
+    if ((notificationRate >= ACTIVE_RATE) || (windowCount >= ACTIVE_RATE)) {
+        return PROFILE_ACTIVE;
+    }
+    return PROFILE_REST;
+}
+
+void ConnectionParameterManager::fillParams(Profile profile, bool poorLink, Gap::ConnectionParams_t &params) const
+{
+    params = profileTable[profile];
+    if (poorLink) {
+        /* Retransmissions need every connection event, and a longer timeout rides out fades. */
+        params.slaveLatency                 = 0;
+        params.connectionSupervisionTimeout = 600;
+    }
+}
+
+bool ConnectionParameterManager::poll(uint32_t now, Gap::ConnectionParams_t &params)
+{
+    if (!connected || !elapsed(now, connectedAt, INITIAL_DELAY_US)) {
+        return false;
+    }
+
+    rollRateWindow(now);
+    Profile wanted = selectProfile();
+    if ((wanted != candidate) || (isLinkPoor() != candidatePoorLink)) {
+        candidate         = wanted;
+        candidatePoorLink = isLinkPoor();
+        candidateSince    = now;
+        failures          = 0;
+    }
+
+    if (negotiated && (candidate == current) && (candidatePoorLink == currentPoorLink)) {
+        return false;
+    }
+
+    if (failures > 0) {
+        if (failures > MAX_RETRIES) {
+            return false; /* give up until the workload changes */
+        }
+        if (!elapsed(now, lastAttempt, RETRY_BASE_US << (failures - 1))) {
+            return false;
+        }
+    } else if ((candidate != PROFILE_BULK) && (!candidatePoorLink || currentPoorLink)) {
+        /* Bulk transfers and a failing link switch straight away; the rest settles and respects the spacing. */
+        if (negotiated && !elapsed(now, candidateSince, SETTLE_TIME_US)) {
+            return false;
+        }
+        if (negotiated && !elapsed(now, lastSuccess, MIN_SPACING_US)) {
+            return false;
+        }
+    }
+
+    requested         = candidate;
+    requestedPoorLink = candidatePoorLink;
+    lastAttempt       = now;
+    fillParams(requested, requestedPoorLink, params);
+    return true;
+}
+
+void ConnectionParameterManager::requestCompleted(uint32_t now, bool success)
+{
+    if (success) {
+        current         = requested;
+        currentPoorLink = requestedPoorLink;
+        negotiated      = true;
+        lastSuccess     = now;
+        failures        = 0;
+    } else {
+        failures++;
+    }
+}
+
+bool ConnectionParameterManager::getNextPollTime(uint32_t now, uint32_t &when) const
+{
+    if (!connected) {
+        return false;
+    }
+    if (!elapsed(now, connectedAt, INITIAL_DELAY_US)) {
+        when = connectedAt + INITIAL_DELAY_US;
+        return true;
+    }
+
+    /* The rate estimate can change the profile on its own once the current window closes. */
+    bool rateMayChange = (windowCount > 0) || (notificationRate > 0);
+    uint32_t rateDeadline = windowStart + RATE_WINDOW_US;
+
+    if (!negotiated || (candidate != current) || (candidatePoorLink != currentPoorLink) ||
+        (selectProfile() != candidate) || (isLinkPoor() != candidatePoorLink)) {
+        if (failures > MAX_RETRIES) {
+            /* Nothing is retried until the workload changes. */
+        } else if (failures > 0) {
+            when = lastAttempt + (RETRY_BASE_US << (failures - 1));
+            return true;
+        } else {
+            when = candidateSince + SETTLE_TIME_US;
+            if ((int32_t)((lastSuccess + MIN_SPACING_US) - when) > 0) {
+                when = lastSuccess + MIN_SPACING_US;
+            }
+            if ((int32_t)(when - now) < 0) {
+                when = now;
+            }
+            return true;
+        }
+    }
+
+    if (rateMayChange) {
+        when = rateDeadline;
+        return true;
+    }
+    return false;
+}
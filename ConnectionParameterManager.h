@@ -0,0 +1,141 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONNECTION_PARAMETER_MANAGER_H__
+#define __CONNECTION_PARAMETER_MANAGER_H__
+
+#include <stdint.h>
+#include "Gap.h"
+
+/**
+ * Chooses connection parameters for the current workload and decides when
+ * to ask the central for them.
+ *
+ * The policy picks one of a few profiles from the recent notification rate,
+ * battery state and whether a bulk transfer is running, and drops slave
+ * latency on a poor link. A new choice has to persist for a while before it
+ * is requested (bulk transfers and a link going poor excepted), successful
+ * requests are rate-limited, and failed requests are retried with
+ * exponential backoff. All profiles stay within the limits that common
+ * centrals (notably iOS) accept.
+ *
+ * The manager only decides; the caller issues ble.updateConnectionParams()
+ * and reports the outcome through requestCompleted(). Times are in
+ * microseconds from a free-running 32-bit clock.
+ */
+class ConnectionParameterManager {
+public:
+    enum Profile {
+        PROFILE_REST,      /* long interval, high slave latency */
+        PROFILE_ACTIVE,    /* moderate interval for sustained notification traffic */
+        PROFILE_LOW_POWER, /* battery is low; trade latency for current */
+        PROFILE_BULK,      /* shortest interval, no latency, for bursts and bulk transfers */
+        NUM_PROFILES
+    };
+
+    static const uint32_t INITIAL_DELAY_US   = 5000000;  /* let the central finish service discovery */
+    static const uint32_t MIN_SPACING_US     = 30000000; /* between successful requests */
+    static const uint32_t SETTLE_TIME_US     = 10000000; /* a new profile must persist this long */
+    static const uint32_t RETRY_BASE_US      = 5000000;  /* doubled on every failed request */
+    static const unsigned MAX_RETRIES        = 4;
+    static const uint32_t RATE_WINDOW_US     = 10000000;
+    static const unsigned ACTIVE_RATE        = 15;       /* notifications per RATE_WINDOW_US */
+    static const uint8_t  POOR_LINK_QUALITY  = 50;       /* percent */
+
+public:
+    ConnectionParameterManager();
+
+    void onConnected(uint32_t now);
+    void onDisconnected(void);
+
+    /**
+     * Count an outgoing notification towards the rate estimate.
+     */
+    void notificationSent(uint32_t now);
+
+    /**
+     * Link quality in percent (100 = no retransmissions), from LinkMonitor.
+     */
+    void setLinkQuality(uint8_t percent) {
+        linkQuality = percent;
+    }
+
+    void setBatteryLow(bool low) {
+        batteryLow = low;
+    }
+
+    void setBulkTransfer(bool active) {
+        bulkTransfer = active;
+    }
+
+    /**
+     * Returns true if 'params' should be requested now.
+     */
+    bool poll(uint32_t now, Gap::ConnectionParams_t &params);
+
+    /**
+     * Earliest time at which poll() could return a different answer, so that
+     * the main loop can sleep until then. Returns false if nothing is
+     * expected to change without outside input.
+     */
+    bool getNextPollTime(uint32_t now, uint32_t &when) const;
+
+    /**
+     * Report the outcome of the request returned by the last poll().
+     */
+    void requestCompleted(uint32_t now, bool success);
+
+    Profile getCurrentProfile(void) const {
+        return current;
+    }
+
+private:
+    void    rollRateWindow(uint32_t now);
+    Profile selectProfile(void) const;
+    void    fillParams(Profile profile, bool poorLink, Gap::ConnectionParams_t &params) const;
+    bool    isLinkPoor(void) const {
+        return linkQuality < POOR_LINK_QUALITY;
+    }
+    bool    elapsed(uint32_t now, uint32_t since, uint32_t duration) const {
+        return (now - since) >= duration;
+    }
+
+private:
+    bool     connected;
+    uint32_t connectedAt;
+
+    uint32_t windowStart;
+    unsigned windowCount;
+    unsigned notificationRate; /* notifications in the last complete window */
+
+    uint8_t  linkQuality;
+    bool     batteryLow;
+    bool     bulkTransfer;
+
+    bool     negotiated;       /* 'current' has been accepted at least once */
+    Profile  current;
+    bool     currentPoorLink;
+    Profile  candidate;
+    bool     candidatePoorLink;
+    uint32_t candidateSince;
+    Profile  requested;
+    bool     requestedPoorLink;
+    uint32_t lastSuccess;
+    uint32_t lastAttempt;
+    unsigned failures;
+};
+
+#endif /* #ifndef __CONNECTION_PARAMETER_MANAGER_H__ */
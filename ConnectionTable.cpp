@@ -0,0 +1,85 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ConnectionTable.h"
+
+ConnectionTable::ConnectionTable() : count(0)
+{
+    for (unsigned i = 0; i < MAX_CONNECTIONS; i++) {
+        contexts[i].open          = false;
+        contexts[i].hrmSubscribed = false;
+    }
+}
+
+ConnectionContext *ConnectionTable::open(Gap::Handle_t handle, const Gap::ConnectionParams_t &params, uint32_t now)
+{
+    for (unsigned i = 0; i < MAX_CONNECTIONS; i++) {
+        ConnectionContext &c = contexts[i];
+        if (!c.open) {
+            c.handle        = handle;
+            c.params        = params;
+            c.hrmSubscribed = false; /* a fresh connection starts unsubscribed */
+            c.parameterManager.onConnected(now);
+            c.linkMonitor.onConnected(now);
+            c.open = true; /* last, so the main loop never sees a half-filled slot */
+            count++;
+            return &c;
+        }
+    }
+    return 0;
+}
+
+void ConnectionTable::close(Gap::Handle_t handle)
+{
+    ConnectionContext *c = find(handle);
+    if (c == 0) {
+        return;
+    }
+    c->open          = false;
+    c->hrmSubscribed = false;
+    c->parameterManager.onDisconnected();
+    count--;
+}
+
+ConnectionContext *ConnectionTable::find(Gap::Handle_t handle)
+{
+    for (unsigned i = 0; i < MAX_CONNECTIONS; i++) {
+        if (contexts[i].open && (contexts[i].handle == handle)) {
+            return &contexts[i];
+        }
+    }
+    return 0;
+}
+
+ConnectionContext *ConnectionTable::getCccdOrigin(void)
+{
+    for (unsigned i = 0; i < MAX_CONNECTIONS; i++) {
+        if (contexts[i].open) {
+            return &contexts[i];
+        }
+    }
+    return 0;
+}
+
+bool ConnectionTable::anySubscribed(void) const
+{
+    for (unsigned i = 0; i < MAX_CONNECTIONS; i++) {
+        if (contexts[i].open && contexts[i].hrmSubscribed) {
+            return true;
+        }
+    }
+    return false;
+}
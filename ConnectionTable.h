@@ -0,0 +1,94 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONNECTION_TABLE_H__
+#define __CONNECTION_TABLE_H__
+
+#include <stdint.h>
+#include "Gap.h"
+#include "ConnectionParameterManager.h"
+#include "LinkMonitor.h"
+
+/**
+ * Everything that belongs to one link.
+ */
+struct ConnectionContext {
+    bool                       open;
+    Gap::Handle_t              handle;
+    Gap::ConnectionParams_t    params;        /* the last ones the central accepted */
+    volatile bool              hrmSubscribed; /* CCCD state of the heart rate measurement */
+    ConnectionParameterManager parameterManager;
+    LinkMonitor                linkMonitor;
+};
+
+/**
+ * Fixed table of connection contexts, indexed by slot. A slot is filled by
+ * open() from the connection callback and emptied by close() from the
+ * disconnection callback; the main loop walks the slots with get(), which
+ * returns 0 for an empty one.
+ *
+ * The S110 SoftDevice is a single-connection peripheral, so MAX_CONNECTIONS
+ * is 1 for now; everything above the table is written for more.
+ */
+class ConnectionTable {
+public:
+    static const unsigned MAX_CONNECTIONS = 1;
+
+public:
+    ConnectionTable();
+
+    /**
+     * Returns the new context, or 0 if the table is full.
+     */
+    ConnectionContext *open(Gap::Handle_t handle, const Gap::ConnectionParams_t &params, uint32_t now);
+    void close(Gap::Handle_t handle);
+
+    ConnectionContext *get(unsigned slot) {
+        return contexts[slot].open ? &contexts[slot] : 0;
+    }
+
+    ConnectionContext *find(Gap::Handle_t handle);
+
+    /**
+     * The link a CCCD write came from. BLE_API doesn't pass the connection
+     * handle to those callbacks, which is only unambiguous while there is
+     * a single link; until it does, CCCD writes go to the first open slot.
+     */
+    ConnectionContext *getCccdOrigin(void);
+
+    /**
+     * The link a transmission complete came from; as getCccdOrigin().
+     */
+    ConnectionContext *getTxOrigin(void) {
+        return getCccdOrigin();
+    }
+
+    unsigned getCount(void) const {
+        return count;
+    }
+
+    bool isFull(void) const {
+        return count >= MAX_CONNECTIONS;
+    }
+
+    bool anySubscribed(void) const;
+
+private:
+    ConnectionContext contexts[MAX_CONNECTIONS];
+    volatile unsigned count;
+};
+
+#endif /* #ifndef __CONNECTION_TABLE_H__ */
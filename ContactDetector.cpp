@@ -0,0 +1,50 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ContactDetector.h"
+
+ContactDetector::ContactDetector()
+{
+    reset();
+}
+
+void ContactDetector::reset(void)
+{
+    state           = STATE_UNKNOWN;
+    disagreeingTime = 0;
+}
+
+bool ContactDetector::process(uint16_t sample, uint32_t periodUs)
+{
+    bool inRange = (sample >= MIN_LEVEL) && (sample <= MAX_LEVEL);
+
+    if (state == STATE_UNKNOWN) {
+        state = inRange ? STATE_ON : STATE_OFF;
+        return true;
+    }
+    if (inRange == (state == STATE_ON)) {
+        disagreeingTime = 0;
+        return false;
+    }
+
+    disagreeingTime += periodUs;
+    if (disagreeingTime < (inRange ? ACQUIRE_US : LOSS_US)) {
+        return false;
+    }
+    state           = inRange ? STATE_ON : STATE_OFF;
+    disagreeingTime = 0;
+    return true;
+}
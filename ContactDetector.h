@@ -0,0 +1,75 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CONTACT_DETECTOR_H__
+#define __CONTACT_DETECTOR_H__
+
+#include <stdint.h>
+
+/**
+ * Tells from the raw PPG level whether the sensor is against the skin.
+ *
+ * Worn, the photodiode sees the LED's light scattered back by the tissue, a
+ * steady level well inside the ADC's range with the pulse riding on it. Off
+ * the skin it sees either next to nothing (in a bag, face down) or ambient
+ * light that drives it into saturation. A sample is "in range" between
+ * MIN_LEVEL and MAX_LEVEL; the limits suit the reference front-end and may
+ * need adjusting for another one.
+ *
+ * Contact is reported as soon as the signal has been in range for
+ * ACQUIRE_US, which is a single sample at contact detection rate, and lost
+ * only once it has stayed out of range for LOSS_US, so that a motion
+ * artefact doesn't drop the measurement. Samples at any rate can be fed in;
+ * each one counts for the sampling period passed with it.
+ */
+class ContactDetector {
+public:
+    enum State {
+        STATE_UNKNOWN, /* nothing sampled since reset(); the first sample decides */
+        STATE_OFF,
+        STATE_ON
+    };
+
+    static const uint16_t MIN_LEVEL  = 0x0800;
+    static const uint16_t MAX_LEVEL  = 0xF800;
+    static const uint32_t ACQUIRE_US = 250000;
+    static const uint32_t LOSS_US    = 2000000;
+
+public:
+    ContactDetector();
+
+    void reset(void);
+
+    /**
+     * Feed one raw sample taken 'periodUs' after the previous one. Returns
+     * true if the state changed.
+     */
+    bool process(uint16_t sample, uint32_t periodUs);
+
+    State getState(void) const {
+        return state;
+    }
+
+    bool isInContact(void) const {
+        return state == STATE_ON;
+    }
+
+private:
+    State    state;
+    uint32_t disagreeingTime; /* how long the samples have contradicted 'state' */
+};
+
+#endif /* #ifndef __CONTACT_DETECTOR_H__ */
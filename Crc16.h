@@ -0,0 +1,30 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __CRC16_H__
+#define __CRC16_H__
+
+#include <stdint.h>
+
+#define CRC16_INITIAL_VALUE 0xFFFF
+
+/**
+ * CRC-16-CCITT (polynomial 0x1021), bitwise to avoid a 512-byte table.
+ * Pass the previous result as 'crc' to checksum data in pieces.
+ */
+uint16_t crc16(const uint8_t *data, unsigned length, uint16_t crc = CRC16_INITIAL_VALUE);
+
+#endif /* #ifndef __CRC16_H__ */
@@ -0,0 +1,554 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "nrf_soc.h"
+#include "ble_gap.h"
+#include "DfuService.h"
+#include "Crc16.h"
+#include "VendorUUID.h"
+
+static const uint32_t ERASED_WORD = 0xFFFFFFFF;
+
+static inline const uint32_t *stateWords(void)
+{
+    return reinterpret_cast<const uint32_t *>(DFU_STATE_START);
+}
+
+static inline uint32_t stateWordAddress(unsigned index)
+{
+    return DFU_STATE_START + (index * sizeof(uint32_t));
+}
+
+static uint32_t getUint32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DfuService::DfuService(BLEDevice &bleDevice, const uint8_t *key, unsigned keyLength) :
+    ble(bleDevice),
+    imageKey(key),
+    imageKeyLength(keyLength),
+    connectionHandle(0),
+    controlChar(0),
+    packetChar(0),
+    commandPending(false),
+    disconnected(false),
+    state(STATE_IDLE),
+    operation(OPERATION_NONE),
+    operationFailed(false),
+    headerStored(false),
+    imageSize(0),
+    imageCrc(0),
+    pagesStored(0),
+    imageValid(false),
+    activateMarked(false),
+    stateErased(false),
+    writeLength(0),
+    writeCaptured(false),
+    fillChunk(0),
+    received(0),
+    expectedPacket(0),
+    accepting(false),
+    packetError(false),
+    receiptPacket(0),
+    receiptInterval(MAX_RECEIPT_INTERVAL),
+    storedReported(false),
+    drainChunk(0),
+    written(0),
+    pageErased(false),
+    validatedBytes(0),
+    validationCrc(CRC16_INITIAL_VALUE),
+    imageAuthentic(false),
+    activationReported(false),
+    activationTime(0)
+{
+    /* empty */
+}
+
+void DfuService::addService(GattArena &arena)
+{
+    controlChar = arena.addCharacteristic(DFU_CONTROL_CHAR_UUID, arena.allocateValue(CONTROL_SIZE), 1, CONTROL_SIZE,
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    packetChar  = arena.addCharacteristic(DFU_PACKET_CHAR_UUID, arena.allocateValue(PACKET_SIZE), 1, PACKET_SIZE,
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE_WITHOUT_RESPONSE);
+
+    GattCharacteristic **chars = arena.allocateList(2);
+    chars[0] = controlChar;
+    chars[1] = packetChar;
+    ble.addService(*arena.addService(DFU_SERVICE_UUID, chars, 2));
+}
+
+void DfuService::init(void)
+{
+    const uint32_t *words = stateWords();
+    uint16_t        crc   = crc16(reinterpret_cast<const uint8_t *>(&words[1]), 2 * sizeof(uint32_t));
+
+    /* Anything else, including a header cut short by a reset, is erased by the next COMMAND_START. */
+    headerStored = (words[0] == STATE_MAGIC) && (words[3] == (0xFFFF0000 | crc)) && (words[1] <= BANK_SIZE);
+    if (!headerStored) {
+        return;
+    }
+    imageSize   = words[1];
+    imageCrc    = (uint16_t)words[2];
+    pagesStored = 0;
+    while ((pagesStored < pagesFor(imageSize)) &&
+           (words[HEADER_WORDS + pagesStored] == (PROGRESS_MAGIC | pagesStored))) {
+        pagesStored++;
+    }
+    imageValid     = (words[VALID_WORD] == STATE_MAGIC);
+    activateMarked = (words[ACTIVATE_WORD] == STATE_MAGIC);
+}
+
+void DfuService::onWriteEvent(const uint8_t *data, unsigned length)
+{
+    writeCaptured = (length <= sizeof(writeData)); /* anything longer isn't a packet */
+    if (writeCaptured) {
+        memcpy(writeData, data, length);
+        writeLength = (uint8_t)length;
+    }
+}
+
+void DfuService::onDataWritten(uint16_t charHandle)
+{
+    if ((controlChar != 0) && (charHandle == controlChar->getHandle())) {
+        commandPending = true;
+    } else if ((packetChar != 0) && (charHandle == packetChar->getHandle()) && writeCaptured) {
+        acceptPacket();
+    }
+    writeCaptured = false;
+}
+
+/**
+ * Stage the packet onWriteEvent() captured. Runs in the stack's event
+ * handler.
+ */
+void DfuService::acceptPacket(void)
+{
+    if (!accepting || (writeLength <= PACKET_HEADER)) {
+        return;
+    }
+
+    const uint8_t *packet  = writeData;
+    uint16_t       number  = (uint16_t)(packet[0] | (packet[1] << 8));
+    unsigned       payload = writeLength - PACKET_HEADER;
+    if ((number != expectedPacket) || (payload > (imageSize - received))) {
+        accepting   = false;
+        packetError = true;
+        return;
+    }
+
+    const uint8_t *p = &packet[PACKET_HEADER];
+    while (payload > 0) {
+        Chunk &chunk = chunks[fillChunk];
+        if (chunk.full) {
+            /* The central didn't wait for its receipt. */
+            accepting   = false;
+            packetError = true;
+            return;
+        }
+        unsigned n = CHUNK_SIZE - chunk.length;
+        if (n > payload) {
+            n = payload;
+        }
+        memcpy(reinterpret_cast<uint8_t *>(chunk.words) + chunk.length, p, n);
+        chunk.length += n;
+        received     += n;
+        p            += n;
+        payload      -= n;
+        if ((chunk.length == CHUNK_SIZE) || (received == imageSize)) {
+            /* Flash is written in whole words; the tail of the last one stays erased. */
+            unsigned padded = (chunk.length + 3) & ~3u;
+            memset(reinterpret_cast<uint8_t *>(chunk.words) + chunk.length, 0xFF, padded - chunk.length);
+            chunk.full = true;
+            fillChunk  = (fillChunk + 1) % CHUNK_COUNT;
+        }
+    }
+    expectedPacket++;
+    if (received == imageSize) {
+        accepting = false;
+    }
+}
+
+void DfuService::respond(uint8_t code, uint32_t value)
+{
+    uint8_t response[RESPONSE_SIZE];
+    response[0] = code;
+    response[1] = (uint8_t)(value);
+    response[2] = (uint8_t)(value >> 8);
+    response[3] = (uint8_t)(value >> 16);
+    response[4] = (uint8_t)(value >> 24);
+    ble.updateCharacteristicValue(controlChar->getHandle(), response, sizeof(response));
+}
+
+/**
+ * Back to idle with a last response. An operation still in flight
+ * completes on its own; nothing is waiting for it any more.
+ */
+void DfuService::finish(uint8_t code, uint32_t value)
+{
+    accepting = false;
+    state     = STATE_IDLE;
+    respond(code, value);
+}
+
+/**
+ * Encrypted, with whatever keys pairing produced. Image data is only
+ * accepted after a COMMAND_START, so checking the commands covers it too.
+ */
+bool DfuService::linkEncrypted(void) const
+{
+    ble_gap_conn_sec_t security;
+    if (sd_ble_gap_conn_sec_get(connectionHandle, &security) != NRF_SUCCESS) {
+        return false;
+    }
+    return (security.sec_mode.sm == 1) && (security.sec_mode.lv >= 2);
+}
+
+void DfuService::handleCommand(void)
+{
+    uint8_t  command[CONTROL_SIZE];
+    uint16_t length = sizeof(command);
+    if ((ble.readCharacteristicValue(controlChar->getHandle(), command, &length) != BLE_ERROR_NONE) || (length < 1)) {
+        return;
+    }
+    if (!linkEncrypted()) {
+        respond(RESPONSE_INSECURE_LINK, 0);
+        return;
+    }
+
+    switch (command[0]) {
+        case COMMAND_START:
+            if (length < 7) {
+                respond(RESPONSE_UNKNOWN_COMMAND, 0);
+            } else if (state != STATE_IDLE) {
+                respond(RESPONSE_BUSY, 0);
+            } else {
+                start(getUint32(&command[1]), (uint16_t)(command[5] | (command[6] << 8)));
+            }
+            break;
+
+        case COMMAND_RECEIPT_INTERVAL:
+            if ((length < 2) || (command[1] == 0) || (command[1] > MAX_RECEIPT_INTERVAL)) {
+                respond(RESPONSE_UNKNOWN_COMMAND, MAX_RECEIPT_INTERVAL);
+            } else {
+                receiptInterval = command[1];
+            }
+            break;
+
+        case COMMAND_VALIDATE:
+            if ((state != STATE_RECEIVING) || !storedReported) {
+                respond(RESPONSE_BUSY, 0);
+                break;
+            }
+            state          = STATE_VALIDATING;
+            stateErased    = false;
+            validatedBytes = 0;
+            validationCrc  = CRC16_INITIAL_VALUE;
+            validationTag.start(imageKey, imageKeyLength);
+            imageAuthentic = false;
+            break;
+
+        case COMMAND_ACTIVATE:
+            if ((state != STATE_IDLE) || !headerStored || !imageValid) {
+                respond(RESPONSE_INVALID, 0);
+                break;
+            }
+            state              = STATE_ACTIVATING;
+            activationReported = false;
+            break;
+
+        case COMMAND_ABORT:
+            if ((state == STATE_PREPARING) || (state == STATE_RECEIVING)) {
+                finish(RESPONSE_ABORTED, headerStored ? getStoredOffset() : 0);
+            }
+            break;
+
+        default:
+            respond(RESPONSE_UNKNOWN_COMMAND, 0);
+            break;
+    }
+}
+
+/**
+ * Resume the image already in the bank if it is the same one, or start
+ * over with a fresh state page.
+ */
+void DfuService::start(uint32_t size, uint16_t crc)
+{
+    if ((size <= TAG_SIZE) || (size > BANK_SIZE)) {
+        respond(RESPONSE_TOO_LARGE, BANK_SIZE);
+        return;
+    }
+    if (headerStored && (size == imageSize) && (crc == imageCrc)) {
+        beginReceiving(getStoredOffset());
+        return;
+    }
+    imageSize   = size;
+    imageCrc    = crc;
+    state       = STATE_PREPARING;
+    stateErased = false;
+}
+
+void DfuService::beginReceiving(uint32_t offset)
+{
+    for (unsigned i = 0; i < CHUNK_COUNT; i++) {
+        chunks[i].length = 0;
+        chunks[i].full   = false;
+    }
+    fillChunk      = 0;
+    drainChunk     = 0;
+    received       = offset;
+    written        = offset;
+    pageErased     = false;
+    expectedPacket = 0;
+    receiptPacket  = 0;
+    packetError    = false;
+    storedReported = false;
+    state          = STATE_RECEIVING;
+    respond(RESPONSE_READY, offset);
+    accepting      = (offset < imageSize); /* last: packets may arrive from now on */
+}
+
+bool DfuService::startErase(Operation next, uint32_t address, uint32_t now)
+{
+    if (!flashStore.erasePage(address, this, now)) {
+        return false;
+    }
+    operation = next;
+    return true;
+}
+
+bool DfuService::startWrite(Operation next, uint32_t address, const uint32_t *words, unsigned count, uint32_t now)
+{
+    if (!flashStore.write(address, words, count, this, now)) {
+        return false;
+    }
+    operation = next;
+    return true;
+}
+
+/**
+ * Write staged chunks to the bank, erasing each page as it is reached, and
+ * record every completed page. Receipts go out once the chunks other than
+ * the one being filled are free again.
+ */
+void DfuService::pollReceiving(uint32_t now)
+{
+    if (packetError) {
+        finish(RESPONSE_PACKET_ERROR, getStoredOffset());
+        return;
+    }
+
+    Chunk   &chunk     = chunks[drainChunk];
+    unsigned pagesDone = (written == imageSize) ? pagesFor(imageSize) : (written / FLASH_PAGE_SIZE);
+    if (pagesStored < pagesDone) {
+        record[0] = PROGRESS_MAGIC | pagesStored;
+        startWrite(OPERATION_WRITE_PROGRESS, stateWordAddress(HEADER_WORDS + pagesStored), record, 1, now);
+    } else if (chunk.full && !pageErased && ((written % FLASH_PAGE_SIZE) == 0)) {
+        startErase(OPERATION_ERASE_BANK_PAGE, DFU_BANK_START + written, now);
+    } else if (chunk.full) {
+        startWrite(OPERATION_WRITE_CHUNK, DFU_BANK_START + written, chunk.words, (chunk.length + 3) / 4, now);
+    } else if ((written == imageSize) && !storedReported) {
+        storedReported = true;
+        respond(RESPONSE_RECEIPT, imageSize);
+        return;
+    }
+
+    if (accepting && ((uint16_t)(expectedPacket - receiptPacket) >= receiptInterval)) {
+        for (unsigned i = 0; i < CHUNK_COUNT; i++) {
+            if ((i != fillChunk) && chunks[i].full) {
+                return;
+            }
+        }
+        receiptPacket = expectedPacket;
+        respond(RESPONSE_RECEIPT, received);
+    }
+}
+
+/**
+ * Compare without an early exit, so that the time taken says nothing about
+ * how much of a forged tag was right.
+ */
+static bool tagsMatch(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t difference = 0;
+    for (unsigned i = 0; i < DfuService::TAG_SIZE; i++) {
+        difference |= a[i] ^ b[i];
+    }
+    return difference == 0;
+}
+
+/**
+ * Checksum and authenticate the bank a page per pass, so that the main
+ * loop keeps running.
+ */
+void DfuService::pollValidating(uint32_t now)
+{
+    const uint8_t *bank      = reinterpret_cast<const uint8_t *>(DFU_BANK_START);
+    uint32_t       tagOffset = imageSize - TAG_SIZE;
+    if (validatedBytes < imageSize) {
+        uint32_t length = imageSize - validatedBytes;
+        if (length > FLASH_PAGE_SIZE) {
+            length = FLASH_PAGE_SIZE;
+        }
+        validationCrc = crc16(bank + validatedBytes, length, validationCrc);
+        if (validatedBytes < tagOffset) {
+            uint32_t signedLength = tagOffset - validatedBytes;
+            validationTag.update(bank + validatedBytes, (signedLength < length) ? signedLength : length);
+        }
+        validatedBytes += length;
+        if (validatedBytes == imageSize) {
+            uint8_t tag[TAG_SIZE];
+            validationTag.finish(tag);
+            imageAuthentic = (validationCrc == imageCrc) && tagsMatch(tag, bank + tagOffset);
+        }
+        return;
+    }
+
+    if (!imageAuthentic) {
+        /* Start over from scratch next time rather than resume into the same image. */
+        if (!stateErased) {
+            startErase(OPERATION_ERASE_STATE, DFU_STATE_START, now);
+            return;
+        }
+        finish(RESPONSE_INVALID, 0);
+        return;
+    }
+    if (!imageValid) {
+        record[0] = STATE_MAGIC;
+        startWrite(OPERATION_WRITE_VALID, stateWordAddress(VALID_WORD), record, 1, now);
+        return;
+    }
+    finish(RESPONSE_VALID, imageSize);
+}
+
+void DfuService::poll(uint32_t now)
+{
+    if (disconnected) {
+        disconnected   = false;
+        commandPending = false;
+        if ((state == STATE_PREPARING) || (state == STATE_RECEIVING) || (state == STATE_VALIDATING)) {
+            accepting = false;
+            state     = STATE_IDLE; /* what is in flash is kept, to resume from */
+        }
+    }
+    if (commandPending) {
+        commandPending = false;
+        handleCommand();
+    }
+
+    if ((operation != OPERATION_NONE) || flashStore.isBusy()) {
+        return;
+    }
+    if (operationFailed) {
+        operationFailed = false;
+        if (state != STATE_IDLE) {
+            finish(RESPONSE_FLASH_ERROR, headerStored ? getStoredOffset() : 0);
+        }
+        return;
+    }
+
+    switch (state) {
+        case STATE_PREPARING:
+            if (!stateErased) {
+                startErase(OPERATION_ERASE_STATE, DFU_STATE_START, now);
+            } else if (!headerStored) {
+                record[0] = STATE_MAGIC;
+                record[1] = imageSize;
+                record[2] = 0xFFFF0000 | imageCrc;
+                record[3] = 0xFFFF0000 | crc16(reinterpret_cast<const uint8_t *>(&record[1]), 2 * sizeof(uint32_t));
+                startWrite(OPERATION_WRITE_HEADER, DFU_STATE_START, record, HEADER_WORDS, now);
+            } else {
+                beginReceiving(0);
+            }
+            break;
+
+        case STATE_RECEIVING:
+            pollReceiving(now);
+            break;
+
+        case STATE_VALIDATING:
+            pollValidating(now);
+            break;
+
+        case STATE_ACTIVATING:
+            if (!activateMarked) {
+                record[0] = STATE_MAGIC;
+                startWrite(OPERATION_WRITE_ACTIVATE, stateWordAddress(ACTIVATE_WORD), record, 1, now);
+            } else if (!activationReported) {
+                respond(RESPONSE_ACTIVATING, imageSize);
+                activationReported = true;
+                activationTime     = now;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void DfuService::flashOperationComplete(bool success)
+{
+    Operation done = operation;
+    operation = OPERATION_NONE;
+    if (!success) {
+        /* The bank page or state word may hold anything now; the next START erases it again. */
+        if ((done == OPERATION_WRITE_CHUNK) || (done == OPERATION_ERASE_BANK_PAGE)) {
+            pageErased = false;
+        }
+        operationFailed = true;
+        return;
+    }
+
+    switch (done) {
+        case OPERATION_ERASE_STATE:
+            headerStored   = false;
+            pagesStored    = 0;
+            imageValid     = false;
+            activateMarked = false;
+            stateErased    = true;
+            break;
+        case OPERATION_WRITE_HEADER:
+            headerStored = true;
+            break;
+        case OPERATION_ERASE_BANK_PAGE:
+            pageErased = true;
+            break;
+        case OPERATION_WRITE_CHUNK:
+            if (state == STATE_RECEIVING) {
+                Chunk &chunk = chunks[drainChunk];
+                written     += chunk.length;
+                chunk.length = 0;
+                chunk.full   = false; /* last: the event handler may fill it again */
+                drainChunk   = (drainChunk + 1) % CHUNK_COUNT;
+                pageErased   = (written % FLASH_PAGE_SIZE) != 0;
+            }
+            break;
+        case OPERATION_WRITE_PROGRESS:
+            pagesStored++;
+            break;
+        case OPERATION_WRITE_VALID:
+            imageValid = true;
+            break;
+        case OPERATION_WRITE_ACTIVATE:
+            activateMarked = true;
+            break;
+        default:
+            break;
+    }
+}
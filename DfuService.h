@@ -0,0 +1,309 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DFU_SERVICE_H__
+#define __DFU_SERVICE_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "FlashLayout.h"
+#include "FlashStore.h"
+#include "Sha256.h"
+
+/**
+ * Vendor service that receives a firmware image over the air into the DFU
+ * bank, for a bootloader to install. None is part of this tree: until one
+ * that honours ACTIVATE_WORD is flashed, COMMAND_ACTIVATE only marks the
+ * image and resets into the running application.
+ *
+ * Only authorised images are installed: the last TAG_SIZE bytes of an
+ * image are an HMAC-SHA256, keyed with the product's image key, of the
+ * bytes before them, and COMMAND_VALIDATE checks it as well as the CRC. The
+ * CRC only guards the transfer, and resumes, against corruption; it is the
+ * central's own. Commands are refused, with RESPONSE_INSECURE_LINK, until
+ * the link is encrypted.
+ *
+ * The central subscribes to the control point and writes commands to it:
+ *
+ *   COMMAND_START [u32 size][u16 CRC-16]
+ *                  receive this image, tag included; answered with
+ *                  RESPONSE_READY and the offset to send from, which is past
+ *                  whatever an earlier, interrupted transfer of the same
+ *                  image already stored
+ *   COMMAND_RECEIPT_INTERVAL [u8 packets]
+ *                  send RESPONSE_RECEIPT every so many packets, at most
+ *                  MAX_RECEIPT_INTERVAL (the default)
+ *   COMMAND_VALIDATE  check the stored image against its CRC and tag;
+ *                  answered with RESPONSE_VALID or RESPONSE_INVALID
+ *   COMMAND_ACTIVATE  hand a valid image to the bootloader; answered with
+ *                  RESPONSE_ACTIVATING, then the device resets
+ *   COMMAND_ABORT  stop receiving; what has been stored is kept for a resume
+ *
+ * Responses are [code][u32 value], little-endian; the value is a byte
+ * offset where one applies. Image data goes to the packet characteristic,
+ * written without response so that several packets fit in a connection
+ * event, as [u16 packet number][up to 18 image bytes]. Each packet is taken
+ * from the SoftDevice's write event (see onWriteEvent()), since by the time
+ * BLE_API reports a write the characteristic may already hold the next one.
+ * Numbers count from 0 after every RESPONSE_READY. A gap in them or an
+ * overrun ends the transfer with RESPONSE_PACKET_ERROR and the offset to
+ * resume from. The central keeps at most the receipt interval
+ * of packets in flight; receipts are held back until there is room for as
+ * many more. Once the whole image is in flash, a last RESPONSE_RECEIPT
+ * carries its size.
+ *
+ * Received data is staged in CHUNK_SIZE buffers and written to the bank
+ * from the main loop. The DFU state page records the image being received
+ * and every bank page that has been completely written, so that a transfer
+ * cut short by a disconnection or a reset resumes where it left off:
+ *
+ *   word 0         STATE_MAGIC
+ *   word 1         image size
+ *   word 2         0xFFFF0000 | image CRC-16
+ *   word 3         0xFFFF0000 | CRC-16 of words 1 .. 2
+ *   word 4 + n     PROGRESS_MAGIC | n, once bank page n has been written
+ *   VALID_WORD     STATE_MAGIC, once the image has been validated
+ *   ACTIVATE_WORD  STATE_MAGIC: for the bootloader to copy the bank over
+ *                  the application at the next reset and erase this page
+ *
+ * onWriteEvent(), onDataWritten() and onDisconnected() may be called from
+ * the stack's callbacks; everything else happens in poll(), from the main
+ * loop.
+ */
+class DfuService : public FlashClient {
+public:
+    enum {
+        COMMAND_START            = 0x01,
+        COMMAND_RECEIPT_INTERVAL = 0x02,
+        COMMAND_VALIDATE         = 0x03,
+        COMMAND_ACTIVATE         = 0x04,
+        COMMAND_ABORT            = 0x05
+    };
+
+    enum {
+        RESPONSE_READY           = 0x01,
+        RESPONSE_RECEIPT         = 0x02,
+        RESPONSE_VALID           = 0x03,
+        RESPONSE_ACTIVATING      = 0x04,
+        RESPONSE_ABORTED         = 0x05,
+        RESPONSE_INVALID         = 0xE0,
+        RESPONSE_BUSY            = 0xE1,
+        RESPONSE_UNKNOWN_COMMAND = 0xE2,
+        RESPONSE_TOO_LARGE       = 0xE3,
+        RESPONSE_PACKET_ERROR    = 0xE4,
+        RESPONSE_FLASH_ERROR     = 0xE5,
+        RESPONSE_INSECURE_LINK   = 0xE6
+    };
+
+    static const unsigned PACKET_SIZE          = 20; /* default ATT_MTU (23) minus the write header */
+    static const unsigned PACKET_HEADER        = 2;
+    static const unsigned PACKET_PAYLOAD       = PACKET_SIZE - PACKET_HEADER;
+    static const unsigned CONTROL_SIZE         = 7;  /* the longest command */
+    static const unsigned RESPONSE_SIZE        = 5;
+    static const unsigned CHUNK_SIZE           = 256; /* bytes staged per flash write */
+    static const unsigned CHUNK_COUNT          = 2;
+    /* A receipt means a whole chunk is free, which must hold everything sent until the next one. */
+    static const unsigned MAX_RECEIPT_INTERVAL = CHUNK_SIZE / PACKET_PAYLOAD;
+    static const uint32_t BANK_SIZE            = DFU_BANK_PAGES * FLASH_PAGE_SIZE;
+    static const uint32_t ACTIVATION_DELAY_US  = 500000; /* for RESPONSE_ACTIVATING to go out */
+    static const unsigned TAG_SIZE             = HmacSha256::TAG_SIZE; /* at the end of every image */
+
+    static const uint32_t STATE_MAGIC    = 0x31554644; /* "DFU1" */
+    static const uint32_t PROGRESS_MAGIC = 0x50470000; /* "GP", page number below */
+
+    enum {
+        HEADER_WORDS  = 4,
+        VALID_WORD    = (FLASH_PAGE_SIZE / sizeof(uint32_t)) - 2,
+        ACTIVATE_WORD = (FLASH_PAGE_SIZE / sizeof(uint32_t)) - 1
+    };
+
+    static const unsigned GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(CONTROL_SIZE) +
+                                           GATT_CHARACTERISTIC_FOOTPRINT(PACKET_SIZE);
+
+public:
+    /**
+     * 'imageKey' (at most Sha256::BLOCK_SIZE bytes) authenticates images; it
+     * must outlive the service.
+     */
+    DfuService(BLEDevice &ble, const uint8_t *imageKey, unsigned imageKeyLength);
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * GATT table.
+     */
+    void addService(GattArena &arena);
+
+    /**
+     * Read back what the state page says about the bank. Call once at
+     * startup.
+     */
+    void init(void);
+
+    /**
+     * True while an image is being received, validated or activated.
+     */
+    bool isActive(void) const {
+        return state != STATE_IDLE;
+    }
+
+    /**
+     * True while poll() has work of its own, waiting on neither the central
+     * nor the flash: the bank is checked a page per call.
+     */
+    bool isValidating(void) const {
+        return state == STATE_VALIDATING;
+    }
+
+    void onConnected(Gap::Handle_t handle) {
+        connectionHandle = handle;
+    }
+
+    /**
+     * The data of a GATT write, from the SoftDevice's event, just ahead of
+     * the onDataWritten() for the same write.
+     */
+    void onWriteEvent(const uint8_t *data, unsigned length);
+
+    void onDataWritten(uint16_t charHandle);
+
+    void onDisconnected(void) {
+        disconnected = true;
+    }
+
+    void poll(uint32_t now);
+
+    /**
+     * An image has been handed to the bootloader and the response has had
+     * time to go out: reset now.
+     */
+    bool resetDue(uint32_t now) const {
+        return (state == STATE_ACTIVATING) && activationReported && ((now - activationTime) >= ACTIVATION_DELAY_US);
+    }
+
+    bool getNextDeadline(uint32_t &when) const {
+        if ((state != STATE_ACTIVATING) || !activationReported) {
+            return false;
+        }
+        when = activationTime + ACTIVATION_DELAY_US;
+        return true;
+    }
+
+    virtual void flashOperationComplete(bool success);
+
+private:
+    enum State {
+        STATE_IDLE,
+        STATE_PREPARING,  /* erasing the state page, then writing the header */
+        STATE_RECEIVING,
+        STATE_VALIDATING,
+        STATE_ACTIVATING
+    };
+
+    enum Operation {
+        OPERATION_NONE,
+        OPERATION_ERASE_STATE,
+        OPERATION_WRITE_HEADER,
+        OPERATION_ERASE_BANK_PAGE,
+        OPERATION_WRITE_CHUNK,
+        OPERATION_WRITE_PROGRESS,
+        OPERATION_WRITE_VALID,
+        OPERATION_WRITE_ACTIVATE
+    };
+
+    struct Chunk {
+        uint32_t          words[CHUNK_SIZE / sizeof(uint32_t)];
+        volatile unsigned length; /* bytes */
+        volatile bool     full;   /* handed to the main loop for writing */
+    };
+
+    bool linkEncrypted(void) const;
+    void handleCommand(void);
+    void start(uint32_t size, uint16_t crc);
+    void beginReceiving(uint32_t offset);
+    void acceptPacket(void);
+    void pollReceiving(uint32_t now);
+    void pollValidating(uint32_t now);
+    bool startErase(Operation next, uint32_t address, uint32_t now);
+    bool startWrite(Operation next, uint32_t address, const uint32_t *words, unsigned count, uint32_t now);
+    void finish(uint8_t code, uint32_t value);
+    void respond(uint8_t code, uint32_t value);
+
+    static unsigned pagesFor(uint32_t bytes) {
+        return (bytes + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+    }
+
+    /* Bytes up to the first bank page not recorded as written. */
+    uint32_t getStoredOffset(void) const {
+        uint32_t offset = pagesStored * FLASH_PAGE_SIZE;
+        return (offset < imageSize) ? offset : imageSize;
+    }
+
+private:
+    BLEDevice          &ble;
+    const uint8_t      *imageKey;
+    unsigned            imageKeyLength;
+    Gap::Handle_t       connectionHandle;
+
+    GattCharacteristic *controlChar;
+    GattCharacteristic *packetChar;
+
+    volatile bool       commandPending;
+    volatile bool       disconnected;
+
+    State               state;
+    Operation           operation;       /* in flight through flashStore */
+    bool                operationFailed;
+
+    /* What the state page says. */
+    bool                headerStored;
+    uint32_t            imageSize;
+    uint16_t            imageCrc;
+    unsigned            pagesStored;
+    bool                imageValid;
+    bool                activateMarked;
+    bool                stateErased;     /* since entering the current state */
+    uint32_t            record[HEADER_WORDS];
+
+    /* The write onDataWritten() is about to report. */
+    uint8_t             writeData[PACKET_SIZE];
+    uint8_t             writeLength;
+    bool                writeCaptured;
+
+    /* Filled from onDataWritten(), drained by poll(). */
+    Chunk               chunks[CHUNK_COUNT];
+    volatile unsigned   fillChunk;
+    volatile uint32_t   received;        /* image bytes staged so far */
+    volatile uint16_t   expectedPacket;  /* also the number accepted since RESPONSE_READY */
+    volatile bool       accepting;
+    volatile bool       packetError;
+
+    uint16_t            receiptPacket;   /* expectedPacket when the last receipt went out */
+    unsigned            receiptInterval;
+    bool                storedReported;
+    unsigned            drainChunk;
+    uint32_t            written;         /* image bytes in the bank */
+    bool                pageErased;      /* the page 'written' points into */
+
+    uint32_t            validatedBytes;
+    uint16_t            validationCrc;
+    HmacSha256          validationTag;
+    bool                imageAuthentic;  /* CRC and tag, once the whole image has been read */
+    bool                activationReported;
+    uint32_t            activationTime;
+};
+
+#endif /* #ifndef __DFU_SERVICE_H__ */
@@ -0,0 +1,100 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "DiagnosticsService.h"
+#include "VendorUUID.h"
+
+DiagnosticsService::DiagnosticsService(BLEDevice &bleDevice, const TelemetryLog &telemetryLog) :
+    ble(bleDevice),
+    log(telemetryLog),
+    telemetryChar(0),
+    requestPending(false)
+{
+    /* empty */
+}
+
+void DiagnosticsService::addService(GattArena &arena)
+{
+    telemetryChar = arena.addCharacteristic(DIAGNOSTICS_TELEMETRY_CHAR_UUID, arena.allocateValue(VALUE_SIZE), 1,
+                                            VALUE_SIZE,
+                                            GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
+                                            GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+                                            GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    GattCharacteristic **chars = arena.allocateList(1);
+    chars[0] = telemetryChar;
+    ble.addService(*arena.addService(DIAGNOSTICS_SERVICE_UUID, chars, 1));
+}
+
+static uint8_t *putUint16(uint8_t *p, uint32_t value)
+{
+    if (value > 0xFFFF) {
+        value = 0xFFFF;
+    }
+    p[0] = (uint8_t)(value);
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+static uint8_t *putUint32(uint8_t *p, uint32_t value)
+{
+    p[0] = (uint8_t)(value);
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+    return p + 4;
+}
+
+void DiagnosticsService::poll(void)
+{
+    if (!requestPending) {
+        return;
+    }
+    requestPending = false;
+
+    uint8_t  value[VALUE_SIZE];
+    uint16_t length = sizeof(value);
+    if ((ble.readCharacteristicValue(telemetryChar->getHandle(), value, &length) != BLE_ERROR_NONE) || (length < 1)) {
+        return;
+    }
+    uint8_t run = value[0];
+
+    TelemetryLog::Counters counters;
+    TelemetryLog::Source   source = TelemetryLog::SOURCE_NONE;
+    if (run == RUN_CURRENT) {
+        counters = log.getCurrent();
+        source   = TelemetryLog::SOURCE_LIVE;
+    } else if (run == RUN_PREVIOUS) {
+        source = log.getPrevious(counters);
+    }
+    if (source == TelemetryLog::SOURCE_NONE) {
+        memset(&counters, 0, sizeof(counters));
+    }
+    uint32_t meanLoopUs = (counters.loopPasses > 0) ? (counters.loopBusyUs / counters.loopPasses) : 0;
+
+    uint8_t *p = value;
+    *p++ = run;
+    *p++ = (uint8_t)source;
+    p    = putUint16(p, counters.bootCount);
+    p    = putUint32(p, counters.resetReason);
+    p    = putUint32(p, counters.uptimeSeconds);
+    p    = putUint16(p, counters.peakLoopUs);
+    p    = putUint16(p, meanLoopUs);
+    p    = putUint16(p, counters.measurementsDropped);
+    p    = putUint16(p, counters.minSupplyMillivolts);
+    ble.updateCharacteristicValue(telemetryChar->getHandle(), value, sizeof(value));
+}
@@ -0,0 +1,78 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DIAGNOSTICS_SERVICE_H__
+#define __DIAGNOSTICS_SERVICE_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "TelemetryLog.h"
+
+/**
+ * Vendor service that reports the TelemetryLog counters.
+ *
+ * The central writes [u8 run] to the telemetry characteristic, RUN_CURRENT
+ * or RUN_PREVIOUS; the counters of that run become the characteristic's
+ * value, notified to a subscribed central and readable by any:
+ *
+ *   [u8 run][u8 source][u16 boot count][u32 reset reason][u32 uptime, s]
+ *   [u16 peak loop time, us][u16 mean loop time, us]
+ *   [u16 measurements dropped][u16 minimum supply, mV]
+ *
+ * little-endian, saturating. The source is a TelemetryLog::Source; it is
+ * SOURCE_NONE, with the rest zero, for a run nothing is known about.
+ *
+ * onDataWritten() may be called from the stack's callbacks; poll() runs in
+ * the main loop.
+ */
+class DiagnosticsService {
+public:
+    enum {
+        RUN_CURRENT  = 0x00,
+        RUN_PREVIOUS = 0x01
+    };
+
+    static const unsigned VALUE_SIZE = 20;
+
+    static const unsigned GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(VALUE_SIZE);
+
+public:
+    DiagnosticsService(BLEDevice &ble, const TelemetryLog &log);
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * GATT table.
+     */
+    void addService(GattArena &arena);
+
+    void onDataWritten(uint16_t charHandle) {
+        if ((telemetryChar != 0) && (charHandle == telemetryChar->getHandle())) {
+            requestPending = true;
+        }
+    }
+
+    void poll(void);
+
+private:
+    BLEDevice          &ble;
+    const TelemetryLog &log;
+
+    GattCharacteristic *telemetryChar;
+    volatile bool       requestPending;
+};
+
+#endif /* #ifndef __DIAGNOSTICS_SERVICE_H__ */
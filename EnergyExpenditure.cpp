@@ -0,0 +1,60 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EnergyExpenditure.h"
+
+/* RR-intervals are in 1/1024 s, rates per minute. */
+static const uint32_t UNITS_PER_JOULE = 1024 * 60;
+
+EnergyExpenditure::EnergyExpenditure(uint8_t weightKg, uint8_t ageYears, bool female)
+{
+    if (female) {
+        slope     = 447;
+        intercept = -20402 - (126 * (int32_t)weightKg) + (74 * (int32_t)ageYears);
+    } else {
+        slope     = 631;
+        intercept = -55097 + (199 * (int32_t)weightKg) + (202 * (int32_t)ageYears);
+    }
+    reset();
+}
+
+void EnergyExpenditure::reset(void)
+{
+    joules   = 0;
+    fraction = 0;
+}
+
+void EnergyExpenditure::addBeat(uint16_t rrInterval, uint16_t heartRate)
+{
+    int32_t rate = (slope * heartRate) + intercept;
+    if (rate <= 0) {
+        return;
+    }
+
+    /* At most ~150kJ/min times a 2s interval: well inside 32 bits. */
+    fraction += (uint32_t)rate * rrInterval;
+    if (fraction >= UNITS_PER_JOULE) {
+        uint32_t whole = fraction / UNITS_PER_JOULE; /* one division per beat */
+        joules   += whole;
+        fraction -= whole * UNITS_PER_JOULE;
+    }
+}
+
+uint16_t EnergyExpenditure::getKiloJoules(void) const
+{
+    uint32_t kiloJoules = joules / 1000;
+    return (kiloJoules > MAX_KILOJOULES) ? MAX_KILOJOULES : (uint16_t)kiloJoules;
+}
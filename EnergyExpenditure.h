@@ -0,0 +1,64 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __ENERGY_EXPENDITURE_H__
+#define __ENERGY_EXPENDITURE_H__
+
+#include <stdint.h>
+
+/**
+ * Energy expended, accumulated beat by beat from the heart rate.
+ *
+ * The rate of expenditure follows the heart rate regression of Keytel et al.
+ * (2005), which also takes the wearer's sex, weight and age:
+ *
+ *   male    J/min = -55097 + 631 * bpm + 199 * kg + 202 * years
+ *   female  J/min = -20402 + 447 * bpm - 126 * kg +  74 * years
+ *
+ * clamped at zero below the heart rates it was fitted for. Every beat adds
+ * rate * RR-interval: the product is collected in 1/61440 J (the RR-interval
+ * is in 1/1024 s and the rate per minute) and carried into whole joules, so
+ * nothing is lost to rounding however long the session and nothing is ever
+ * recomputed. The Heart Rate Measurement carries kilojoules, which saturate
+ * at 0xFFFF as the characteristic specifies until the central resets them.
+ */
+class EnergyExpenditure {
+public:
+    static const uint16_t MAX_KILOJOULES = 0xFFFF;
+
+public:
+    EnergyExpenditure(uint8_t weightKg, uint8_t ageYears, bool female);
+
+    /**
+     * Account for one beat: 'rrInterval' (1/1024 s) spent at 'heartRate'.
+     */
+    void addBeat(uint16_t rrInterval, uint16_t heartRate);
+
+    /**
+     * Start again from zero, when the central writes the control point.
+     */
+    void reset(void);
+
+    uint16_t getKiloJoules(void) const;
+
+private:
+    int32_t  slope;     /* J/min per bpm */
+    int32_t  intercept; /* J/min */
+    uint32_t joules;
+    uint32_t fraction;  /* 1/61440 J not yet carried into 'joules' */
+};
+
+#endif /* #ifndef __ENERGY_EXPENDITURE_H__ */
@@ -0,0 +1,77 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "EventDispatcher.h"
+#include "Trace.h"
+
+EventDispatcher::EventDispatcher(const EventDescriptor *eventsIn, unsigned count) :
+    events(eventsIn),
+    eventCount((count < MAX_EVENTS) ? count : MAX_EVENTS)
+{
+    for (unsigned i = 0; i < MAX_EVENTS; i++) {
+        pending[i]   = 0;
+        coalesced[i] = 0;
+    }
+}
+
+void EventDispatcher::collect(void)
+{
+    for (unsigned source = 0; source < NUM_SOURCES; source++) {
+        uint8_t  batch[QUEUE_CAPACITY];
+        unsigned count = queues[source].pop(batch, QUEUE_CAPACITY);
+        for (unsigned i = 0; i < count; i++) {
+            if ((batch[i] < eventCount) && (pending[batch[i]] < 0xFF)) {
+                pending[batch[i]]++;
+            }
+        }
+    }
+}
+
+unsigned EventDispatcher::dispatch(void)
+{
+    unsigned handled = 0;
+    while (true) {
+        /* Again before every handler, so that anything posted meanwhile competes on priority. */
+        collect();
+
+        unsigned next = eventCount;
+        for (unsigned i = 0; i < eventCount; i++) {
+            if ((pending[i] > 0) && ((next == eventCount) || (events[i].priority < events[next].priority))) {
+                next = i;
+            }
+        }
+        if (next == eventCount) {
+            return handled;
+        }
+
+        if (pending[next] > 1) {
+            coalesced[next] += pending[next] - 1;
+            TRACE_EVENT(TRACE_EVENT_COALESCED, pending[next] - 1, next);
+        }
+        pending[next] = 0;
+        events[next].handler();
+        handled++;
+    }
+}
+
+uint32_t EventDispatcher::getDroppedCount(void) const
+{
+    uint32_t dropped = 0;
+    for (unsigned source = 0; source < NUM_SOURCES; source++) {
+        dropped += queues[source].getOverflowCount();
+    }
+    return dropped;
+}
@@ -0,0 +1,117 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __EVENT_DISPATCHER_H__
+#define __EVENT_DISPATCHER_H__
+
+#include <stdint.h>
+#include "RingBuffer.h"
+
+/**
+ * Run-to-completion dispatcher for the main loop.
+ *
+ * Interrupt handlers and callbacks post event identifiers; the main thread
+ * collects them and runs each pending event's handler, always picking the
+ * highest priority one next, so that work posted while a background
+ * handler runs only ever waits for that handler to return. Handlers must
+ * therefore be short, doing one step of a longer job per call.
+ *
+ * The Cortex-M0 has no exclusive-access instructions, so a queue shared by
+ * several interrupt priorities would need a critical section around every
+ * post. Instead every posting context has a lock-free single-producer
+ * RingBuffer of its own; an event may only be posted from the source that
+ * is named with it. All the queues are drained into per-event counts
+ * before each dispatch. An event posted again before its handler got to
+ * run is coalesced into one call and counted, and a post that finds its
+ * queue full is dropped and counted, so a main loop that falls behind
+ * shows up in the counters rather than silently.
+ */
+class EventDispatcher {
+public:
+    enum Priority {
+        PRIORITY_RADIO,      /* feeds the next connection event */
+        PRIORITY_SIGNAL,     /* sample processing; the ring has some headroom */
+        PRIORITY_CONTROL,    /* link and user events */
+        PRIORITY_BACKGROUND, /* policy polls, flash */
+        PRIORITY_IDLE        /* diagnostics */
+    };
+
+    /**
+     * Posting contexts. Each must only post from one interrupt priority.
+     */
+    enum Source {
+        SOURCE_MAIN,   /* the main thread, handlers included */
+        SOURCE_TIMER,  /* Ticker and Timeout callbacks, which share the us_ticker interrupt */
+        SOURCE_GPIO,   /* InterruptIn callbacks */
+        SOURCE_STACK,  /* BLE_API callbacks, from the SoftDevice event interrupt */
+        NUM_SOURCES
+    };
+
+    typedef void (*Handler)(void);
+
+    struct EventDescriptor {
+        const char *name;
+        Priority    priority;
+        Handler     handler;
+    };
+
+    static const unsigned MAX_EVENTS     = 16;
+    static const unsigned QUEUE_CAPACITY = 8; /* per source */
+
+public:
+    /**
+     * 'events' is indexed by event identifier and must outlive the
+     * dispatcher.
+     */
+    EventDispatcher(const EventDescriptor *events, unsigned count);
+
+    /**
+     * Safe to call from interrupt context, from 'source' only.
+     */
+    void post(Source source, uint8_t event) {
+        queues[source].push(event);
+    }
+
+    /**
+     * Run handlers, highest priority first, until nothing is pending, and
+     * return how many ran. Main thread only.
+     */
+    unsigned dispatch(void);
+
+    /**
+     * Posts that were folded into an earlier one's handler call.
+     */
+    uint32_t getCoalescedCount(uint8_t event) const {
+        return coalesced[event];
+    }
+
+    /**
+     * Posts lost to a full queue, over all sources.
+     */
+    uint32_t getDroppedCount(void) const;
+
+private:
+    void collect(void);
+
+private:
+    const EventDescriptor                *events;
+    unsigned                              eventCount;
+    RingBuffer<uint8_t, QUEUE_CAPACITY>   queues[NUM_SOURCES];
+    uint8_t                               pending[MAX_EVENTS]; /* posts not handled yet */
+    uint32_t                              coalesced[MAX_EVENTS];
+};
+
+#endif /* #ifndef __EVENT_DISPATCHER_H__ */
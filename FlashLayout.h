@@ -0,0 +1,75 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FLASH_LAYOUT_H__
+#define __FLASH_LAYOUT_H__
+
+#define DFU_SERVICE 0 /* Set this to add the over-the-air update service (see DfuService.h), and the DFU bank it
+                       * receives images into. main.cpp must then also define DFU_IMAGE_KEY. */
+
+/*
+ * Application data kept in the nRF51822's internal flash, allocated
+ * downwards from the top of the 256KB code area. The SoftDevice and the
+ * application image occupy the bottom; the application must stay below
+ * FLASH_DATA_START.
+ *
+ *   0x18000 - 0x3AFFF  application image, above the S110; with DFU_SERVICE
+ *                      only up to 0x297FF, the rest being the DFU bank
+ *   0x29800 - 0x3AFFF  DFU bank, as large as the application's; a received
+ *                      image waits here for a bootloader
+ *   0x3B000 - 0x3EFFF  session log, SESSION_LOG_PAGES pages used as a ring
+ *   0x3F000 - 0x3F3FF  peer cache, the last centrals that connected
+ *   0x3F400 - 0x3F7FF  DFU state: the image in the bank and how much of it
+ *                      has been received
+ *   0x3F800 - 0x3FBFF  telemetry checkpoints, for the reason of a reset
+ *   0x3FC00 - 0x3FFFF  reserved for small persistent records
+ *
+ * The mbed build's scatter file and linker script know nothing of the data
+ * pages, so the image size the build reports must stay below
+ * APPLICATION_END - APPLICATION_START; the layout itself is checked here.
+ */
+#define FLASH_PAGE_SIZE         1024
+#define FLASH_END               0x40000
+
+#define APPLICATION_START       0x18000
+
+#define SESSION_LOG_PAGES       16
+#define SESSION_LOG_START       0x3B000
+#define SESSION_LOG_END         (SESSION_LOG_START + (SESSION_LOG_PAGES * FLASH_PAGE_SIZE))
+
+#if DFU_SERVICE
+#define DFU_BANK_PAGES          (((SESSION_LOG_START - APPLICATION_START) / FLASH_PAGE_SIZE) / 2)
+#else
+#define DFU_BANK_PAGES          0
+#endif
+#define DFU_BANK_START          (SESSION_LOG_START - (DFU_BANK_PAGES * FLASH_PAGE_SIZE))
+
+#define PEER_CACHE_START        0x3F000
+#define DFU_STATE_START         0x3F400
+#define TELEMETRY_START         0x3F800
+
+#define FLASH_DATA_START        DFU_BANK_START
+#define APPLICATION_END         FLASH_DATA_START
+
+#if (DFU_BANK_PAGES * FLASH_PAGE_SIZE) < (DFU_SERVICE ? (APPLICATION_END - APPLICATION_START) : 0)
+#error "the DFU bank can't hold an image as large as the application's area"
+#endif
+#if (SESSION_LOG_END > PEER_CACHE_START) || (PEER_CACHE_START >= DFU_STATE_START) || \
+    (DFU_STATE_START >= TELEMETRY_START) || (TELEMETRY_START >= FLASH_END)
+#error "the flash data areas overlap"
+#endif
+
+#endif /* #ifndef __FLASH_LAYOUT_H__ */
@@ -0,0 +1,138 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "nrf_soc.h"
+#include "FlashStore.h"
+#include "FlashLayout.h"
+
+FlashStore flashStore;
+
+FlashStore::FlashStore() :
+    client(0),
+    issued(false),
+    outcome(OUTCOME_PENDING),
+    erasing(false),
+    address(0),
+    words(0),
+    wordCount(0),
+    startTime(0)
+{
+    /* empty */
+}
+
+/**
+ * Hand the operation to the SoftDevice. Returns false if it was refused for
+ * good; NRF_ERROR_BUSY leaves it to be issued again from poll().
+ */
+bool FlashStore::issue(void)
+{
+    outcome = OUTCOME_PENDING; /* first: the system event can come in before the call returns */
+    uint32_t result = erasing ? sd_flash_page_erase(address / FLASH_PAGE_SIZE) :
+                                sd_flash_write((uint32_t *)address, words, wordCount);
+    issued = (result == NRF_SUCCESS);
+    return issued || (result == NRF_ERROR_BUSY);
+}
+
+bool FlashStore::erasePage(uint32_t pageAddress, FlashClient *owner, uint32_t now)
+{
+    if (isBusy()) {
+        return false;
+    }
+    erasing = true;
+    address = pageAddress;
+    if (!issue()) {
+        return false;
+    }
+    client    = owner;
+    startTime = now;
+    return true;
+}
+
+bool FlashStore::write(uint32_t dest, const uint32_t *src, unsigned count, FlashClient *owner, uint32_t now)
+{
+    if (isBusy()) {
+        return false;
+    }
+    erasing   = false;
+    address   = dest;
+    words     = src;
+    wordCount = count;
+    if (!issue()) {
+        return false;
+    }
+    client    = owner;
+    startTime = now;
+    return true;
+}
+
+bool FlashStore::landed(void) const
+{
+    const volatile uint32_t *flash = (const volatile uint32_t *)address;
+    if (erasing) {
+        for (unsigned i = 0; i < (FLASH_PAGE_SIZE / sizeof(uint32_t)); i++) {
+            if (flash[i] != 0xFFFFFFFF) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    for (unsigned i = 0; i < wordCount; i++) {
+        if (flash[i] != words[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * The SoftDevice runs one flash operation at a time, so while ours is
+ * accepted the event is for it; anything recorded before that is reset by
+ * the next issue().
+ */
+bool FlashStore::onSystemEvent(uint32_t event)
+{
+    if (event == NRF_EVT_FLASH_OPERATION_SUCCESS) {
+        outcome = OUTCOME_SUCCESS;
+    } else if (event == NRF_EVT_FLASH_OPERATION_ERROR) {
+        outcome = OUTCOME_ERROR;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void FlashStore::poll(uint32_t now)
+{
+    if (!isBusy()) {
+        return;
+    }
+
+    bool timedOut = (now - startTime) >= TIMEOUT_US;
+    if (!issued && !timedOut && issue()) {
+        return; /* accepted now, or still busy */
+    }
+    if ((outcome == OUTCOME_PENDING) && issued && !timedOut) {
+        return;
+    }
+
+    /* Without its event in time, the flash says whether the operation happened. */
+    bool success = issued && ((outcome == OUTCOME_SUCCESS) || ((outcome == OUTCOME_PENDING) && landed()));
+
+    FlashClient *owner = client;
+    client = 0; /* the callback may start the next operation */
+    owner->flashOperationComplete(success);
+}
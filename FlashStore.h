@@ -0,0 +1,118 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FLASH_STORE_H__
+#define __FLASH_STORE_H__
+
+#include <stdint.h>
+
+/**
+ * Implemented by anything that starts flash operations; told once the
+ * operation it started has finished.
+ */
+class FlashClient {
+public:
+    virtual void flashOperationComplete(bool success) = 0;
+
+protected:
+    ~FlashClient() {}
+};
+
+/**
+ * Serialises page erases and word writes to the internal flash through the
+ * SoftDevice, which schedules them between radio events. Only one operation
+ * is in flight at a time, and it completes with the SoftDevice's
+ * NRF_EVT_FLASH_OPERATION_SUCCESS or _ERROR system event. The SoftDevice
+ * refuses an operation with NRF_ERROR_BUSY while another is pending; that
+ * is retried from poll() rather than failed. Without a system event within
+ * TIMEOUT_US, reading the flash back (it is memory-mapped) decides.
+ *
+ * The SDK's event interrupt reads the system events, on behalf of the
+ * nRF51822 library as much as ours, and hands each to onSystemEvent()
+ * through the tap in SoftDeviceEvents.h. poll() must be called from the
+ * main loop after that, and at the deadline; completion callbacks run from
+ * there.
+ */
+class FlashStore {
+public:
+    static const uint32_t TIMEOUT_US = 500000;
+
+public:
+    FlashStore();
+
+    /**
+     * Also true while an operation waits for the SoftDevice to accept it.
+     */
+    bool isBusy(void) const {
+        return client != 0;
+    }
+
+    /**
+     * Start erasing the page at 'address'. Returns false if another
+     * operation is in flight or the SoftDevice refused it.
+     */
+    bool erasePage(uint32_t address, FlashClient *owner, uint32_t now);
+
+    /**
+     * Start writing 'wordCount' words to 'address' (word aligned). 'words'
+     * must stay valid and unchanged until the operation completes.
+     */
+    bool write(uint32_t address, const uint32_t *words, unsigned wordCount, FlashClient *owner, uint32_t now);
+
+    /**
+     * Called from the SoftDevice event interrupt for each system event.
+     * Returns true if it ended a flash operation, ours or not, so that
+     * poll() gets to run: the next operation may be accepted now.
+     */
+    bool onSystemEvent(uint32_t event);
+
+    void poll(uint32_t now);
+
+    /**
+     * When the operation in flight times out; poll() needs to run then.
+     */
+    bool getNextDeadline(uint32_t &when) const {
+        if (!isBusy()) {
+            return false;
+        }
+        when = startTime + TIMEOUT_US;
+        return true;
+    }
+
+private:
+    enum Outcome {
+        OUTCOME_PENDING,
+        OUTCOME_SUCCESS,
+        OUTCOME_ERROR
+    };
+
+    bool issue(void);
+    bool landed(void) const;
+
+private:
+    FlashClient    *client;
+    bool            issued;      /* accepted by the SoftDevice */
+    volatile Outcome outcome;    /* from its system event */
+    bool            erasing;
+    uint32_t        address;
+    const uint32_t *words;
+    unsigned        wordCount;
+    uint32_t        startTime;
+};
+
+extern FlashStore flashStore;
+
+#endif /* #ifndef __FLASH_STORE_H__ */
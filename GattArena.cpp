@@ -0,0 +1,61 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <new>
+#include <string.h>
+#include "mbed.h"
+#include "GattArena.h"
+
+GattArena::GattArena(uint32_t *words, unsigned bytes) : storage((uint8_t *)words), size(bytes), used(0)
+{
+    /* empty */
+}
+
+void *GattArena::allocate(unsigned bytes)
+{
+    bytes = GATT_ARENA_ALIGN(bytes);
+    if ((size - used) < bytes) {
+        error("GATT arena overflow: %u of %u bytes used, %u more requested\r\n", used, size, bytes);
+    }
+
+    void *block = storage + used;
+    used += bytes;
+    return block;
+}
+
+uint8_t *GattArena::allocateValue(unsigned bytes)
+{
+    uint8_t *value = (uint8_t *)allocate(bytes);
+    memset(value, 0, bytes);
+    return value;
+}
+
+GattCharacteristic *GattArena::addCharacteristic(const UUID &uuid, uint8_t *value, uint16_t initialLength,
+                                                 uint16_t maxLength, uint8_t properties)
+{
+    return new (allocate(sizeof(GattCharacteristic))) GattCharacteristic(uuid, value, initialLength, maxLength,
+                                                                         properties);
+}
+
+GattCharacteristic **GattArena::allocateList(unsigned count)
+{
+    return (GattCharacteristic **)allocate(count * sizeof(GattCharacteristic *));
+}
+
+GattService *GattArena::addService(const UUID &uuid, GattCharacteristic **characteristics, unsigned count)
+{
+    return new (allocate(sizeof(GattService))) GattService(uuid, characteristics, count);
+}
@@ -0,0 +1,89 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __GATT_ARENA_H__
+#define __GATT_ARENA_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+
+/*
+ * Arena footprint of the pieces of a GATT service, for sizing the arena at
+ * compile time. Every allocation is rounded up to a word.
+ */
+#define GATT_ARENA_ALIGN(size)                   (((size) + 3) & ~3u)
+#define GATT_SERVICE_FOOTPRINT                   GATT_ARENA_ALIGN(sizeof(GattService))
+#define GATT_CHARACTERISTIC_FOOTPRINT(valueSize) (GATT_ARENA_ALIGN(sizeof(GattCharacteristic)) + \
+                                                  GATT_ARENA_ALIGN(valueSize) +                 \
+                                                  GATT_ARENA_ALIGN(sizeof(GattCharacteristic *)))
+
+/**
+ * Bump allocator holding every GattService and GattCharacteristic, their
+ * characteristic lists and their value buffers. Nothing is ever freed: the
+ * GATT table is built once, at startup, so the layout is the same on every
+ * boot.
+ *
+ * The arena is sized from the footprints the services declare (see the
+ * macros above), so running out means that a service allocates more than
+ * it declared; that stops the firmware on its first boot, through mbed's
+ * error(), rather than corrupting memory.
+ */
+class GattArena {
+public:
+    /**
+     * A zeroed value buffer.
+     */
+    uint8_t *allocateValue(unsigned size);
+
+    GattCharacteristic *addCharacteristic(const UUID &uuid, uint8_t *value, uint16_t initialLength,
+                                          uint16_t maxLength, uint8_t properties);
+
+    GattCharacteristic **allocateList(unsigned count);
+
+    GattService *addService(const UUID &uuid, GattCharacteristic **characteristics, unsigned count);
+
+    unsigned getUsed(void) const {
+        return used;
+    }
+
+    unsigned getSize(void) const {
+        return size;
+    }
+
+protected:
+    GattArena(uint32_t *storage, unsigned size);
+
+private:
+    void *allocate(unsigned bytes);
+
+private:
+    uint8_t *storage;
+    unsigned size;
+    unsigned used;
+};
+
+template <unsigned SIZE>
+class StaticGattArena : public GattArena {
+public:
+    StaticGattArena() : GattArena(words, sizeof(words)) {
+        /* empty */
+    }
+
+private:
+    uint32_t words[GATT_ARENA_ALIGN(SIZE) / sizeof(uint32_t)];
+};
+
+#endif /* #ifndef __GATT_ARENA_H__ */
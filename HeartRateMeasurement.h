@@ -0,0 +1,188 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HEART_RATE_MEASUREMENT_H__
+#define __HEART_RATE_MEASUREMENT_H__
+
+#include <stdint.h>
+#include "IndexWrap.h"
+
+/**
+ * Optional fields of the Heart Rate Measurement; a profile's FEATURES is a
+ * mask of these. The RR-interval list is enabled by a non-zero capacity.
+ */
+enum HeartRateFeature {
+    HRM_FEATURE_SENSOR_CONTACT  = 0x01,
+    HRM_FEATURE_ENERGY_EXPENDED = 0x02
+};
+
+/**
+ * Encoder for the Heart Rate Measurement characteristic.
+ * See --> https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.heart_rate_measurement.xml
+ *
+ * Collects the heart rate, sensor contact status, energy expended and the
+ * RR-intervals measured since the last notification, then packs as much as
+ * fits into a single ATT payload. Fields are little-endian on the air.
+ *
+ * Fields that aren't in FEATURES are never encoded and their setters compile
+ * to nothing; MAX_PAYLOAD is the longest encoding the enabled fields allow,
+ * so that frame buffers can be sized to it.
+ */
+template <unsigned RR_CAPACITY, unsigned FEATURES>
+class HeartRateMeasurement {
+public:
+    static const bool     HAS_SENSOR_CONTACT  = (FEATURES & HRM_FEATURE_SENSOR_CONTACT) != 0;
+    static const bool     HAS_ENERGY_EXPENDED = (FEATURES & HRM_FEATURE_ENERGY_EXPENDED) != 0;
+    static const bool     HAS_RR_INTERVALS    = RR_CAPACITY > 0;
+    static const unsigned RR_QUEUE_CAPACITY   = RR_CAPACITY;
+
+    static const unsigned ATT_PAYLOAD = 20; /* default ATT_MTU (23) minus the notification header */
+    static const unsigned LONGEST     = 3 + (HAS_ENERGY_EXPENDED ? 2 : 0) + (2 * RR_CAPACITY); /* flags, uint16 rate */
+    static const unsigned MAX_PAYLOAD = (LONGEST < ATT_PAYLOAD) ? LONGEST : ATT_PAYLOAD;
+
+    enum {
+        FLAG_VALUE_FORMAT_UINT16       = 0x01,
+        FLAG_SENSOR_CONTACT_DETECTED   = 0x02,
+        FLAG_SENSOR_CONTACT_SUPPORTED  = 0x04,
+        FLAG_ENERGY_EXPENDED_PRESENT   = 0x08,
+        FLAG_RR_INTERVALS_PRESENT      = 0x10
+    };
+
+public:
+    HeartRateMeasurement() :
+        heartRate(0),
+        contactDetected(false),
+        energyExpended(0),
+        energyExpendedPending(false),
+        rrHead(0),
+        rrCount(0)
+    {
+        /* empty */
+    }
+
+    void setHeartRate(uint16_t bpm) {
+        heartRate = bpm;
+    }
+
+    void setSensorContact(bool detected) {
+        contactDetected = HAS_SENSOR_CONTACT && detected;
+    }
+
+    /**
+     * Energy expended in kilojoules; carried in the next encoded packet.
+     */
+    void setEnergyExpended(uint16_t kiloJoules) {
+        energyExpended        = kiloJoules;
+        energyExpendedPending = HAS_ENERGY_EXPENDED;
+    }
+
+    /**
+     * Queue an RR-interval (1/1024 second units). If the queue is full the
+     * oldest interval is discarded, as permitted by the characteristic
+     * definition.
+     */
+    void addRRInterval(uint16_t rrInterval) {
+        if (!HAS_RR_INTERVALS) {
+            return;
+        }
+        if (rrCount == RR_QUEUE_CAPACITY) {
+            rrHead = wrapIndex<RR_SLOTS>(rrHead + 1);
+            rrCount--;
+        }
+        rrQueue[wrapIndex<RR_SLOTS>(rrHead + rrCount)] = rrInterval;
+        rrCount++;
+    }
+
+    unsigned getPendingRRIntervals(void) const {
+        return rrCount;
+    }
+
+    /**
+     * Pack the current measurement into 'buffer' and return the number of
+     * bytes written. As many queued RR-intervals as fit in 'maxLength' are
+     * included (oldest first) and removed from the queue; the remainder stay
+     * queued for the next packet.
+     */
+    unsigned encode(uint8_t *buffer, unsigned maxLength);
+
+private:
+    static const unsigned RR_SLOTS = HAS_RR_INTERVALS ? RR_CAPACITY : 1;
+
+    static uint8_t *putUint16(uint8_t *p, uint16_t value) {
+        p[0] = (uint8_t)(value & 0xFF);
+        p[1] = (uint8_t)(value >> 8);
+        return p + 2;
+    }
+
+private:
+    uint16_t heartRate;
+    bool     contactDetected;
+    uint16_t energyExpended;
+    bool     energyExpendedPending;
+
+    uint16_t rrQueue[RR_SLOTS];
+    unsigned rrHead; /* index of the oldest queued interval */
+    unsigned rrCount;
+};
+
+template <unsigned RR_CAPACITY, unsigned FEATURES>
+unsigned HeartRateMeasurement<RR_CAPACITY, FEATURES>::encode(uint8_t *buffer, unsigned maxLength)
+{
+    uint8_t  flags = 0;
+    uint8_t *p     = buffer + 1; /* flags are filled in last */
+    uint8_t *end   = buffer + maxLength;
+
+    if (maxLength < 2) {
+        return 0;
+    }
+
+    if (heartRate > 0xFF) {
+        if (maxLength < 3) {
+            return 0;
+        }
+        flags |= FLAG_VALUE_FORMAT_UINT16;
+        p = putUint16(p, heartRate);
+    } else {
+        *p++ = (uint8_t)heartRate;
+    }
+
+    if (HAS_SENSOR_CONTACT) {
+        flags |= FLAG_SENSOR_CONTACT_SUPPORTED;
+        if (contactDetected) {
+            flags |= FLAG_SENSOR_CONTACT_DETECTED;
+        }
+    }
+
+    if (HAS_ENERGY_EXPENDED && energyExpendedPending && ((end - p) >= 2)) {
+        flags |= FLAG_ENERGY_EXPENDED_PRESENT;
+        p = putUint16(p, energyExpended);
+        energyExpendedPending = false;
+    }
+
+    if (HAS_RR_INTERVALS && (rrCount > 0) && ((end - p) >= 2)) {
+        flags |= FLAG_RR_INTERVALS_PRESENT;
+        while ((rrCount > 0) && ((end - p) >= 2)) {
+            p = putUint16(p, rrQueue[rrHead]);
+            rrHead = wrapIndex<RR_SLOTS>(rrHead + 1);
+            rrCount--;
+        }
+    }
+
+    buffer[0] = flags;
+    return (unsigned)(p - buffer);
+}
+
+#endif /* #ifndef __HEART_RATE_MEASUREMENT_H__ */
@@ -0,0 +1,131 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HEART_RATE_PROFILE_H__
+#define __HEART_RATE_PROFILE_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "HeartRateMeasurement.h"
+
+/**
+ * The Heart Rate Service of one product, fixed at compile time: where the
+ * sensor is worn, how many RR-intervals a measurement can queue, which
+ * optional measurement fields it reports (a mask of HeartRateFeature), and
+ * how long the notification scheduler may hold new data to coalesce it
+ * with more (see NotificationScheduler).
+ *
+ * The measurement encoder, the characteristic sizes and the arena footprint
+ * all follow from the template arguments, so a product without RR-intervals
+ * or energy expended carries neither the code nor the buffers for them.
+ * With energy expended the service also has the Heart Rate Control Point,
+ * through which the central resets it.
+ * See --> https://developer.bluetooth.org/gatt/services/Pages/ServiceViewer.aspx?u=org.bluetooth.service.heart_rate.xml
+ *
+ * onDataWritten() may be called from the stack's callback; the write is
+ * picked up by energyResetRequested() in the main loop.
+ */
+template <uint8_t LOCATION, unsigned RR_CAPACITY, unsigned FEATURES, unsigned HOLD_TIME_MS>
+class HeartRateProfile {
+public:
+    typedef HeartRateMeasurement<RR_CAPACITY, FEATURES> Measurement;
+
+    static const uint8_t  SENSOR_LOCATION      = LOCATION;
+    static const uint32_t HOLD_TIME_US         = (uint32_t)HOLD_TIME_MS * 1000;
+    static const unsigned INITIAL_LENGTH       = 2; /* flags, uint8_t HRM value; measurements go out as notifications */
+    static const unsigned CHARACTERISTIC_COUNT = Measurement::HAS_ENERGY_EXPENDED ? 3 : 2;
+    static const unsigned GATT_FOOTPRINT       = GATT_SERVICE_FOOTPRINT +
+                                                 GATT_CHARACTERISTIC_FOOTPRINT(INITIAL_LENGTH) +
+                                                 GATT_CHARACTERISTIC_FOOTPRINT(1) +
+                                                 (Measurement::HAS_ENERGY_EXPENDED ? GATT_CHARACTERISTIC_FOOTPRINT(1) : 0);
+
+    /* Heart Rate Control Point values. */
+    enum {
+        CONTROL_RESET_ENERGY_EXPENDED = 0x01
+    };
+
+public:
+    HeartRateProfile(BLEDevice &ble) : ble(ble), measurementChar(0), controlPointChar(0), controlPending(false) {
+        /* empty */
+    }
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * stack. Call once at startup.
+     */
+    void addService(GattArena &arena) {
+        measurementChar = arena.addCharacteristic(GattCharacteristic::UUID_HEART_RATE_MEASUREMENT_CHAR,
+                                                  arena.allocateValue(INITIAL_LENGTH), INITIAL_LENGTH,
+                                                  Measurement::MAX_PAYLOAD,
+                                                  GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+        uint8_t *location = arena.allocateValue(1);
+        *location = SENSOR_LOCATION;
+
+        GattCharacteristic **chars = arena.allocateList(CHARACTERISTIC_COUNT);
+        chars[0] = measurementChar;
+        chars[1] = arena.addCharacteristic(GattCharacteristic::UUID_BODY_SENSOR_LOCATION_CHAR, location, 1, 1,
+                                           GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
+        if (Measurement::HAS_ENERGY_EXPENDED) {
+            controlPointChar = arena.addCharacteristic(GattCharacteristic::UUID_HEART_RATE_CONTROL_POINT_CHAR,
+                                                       arena.allocateValue(1), 1, 1,
+                                                       GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE);
+            chars[2] = controlPointChar;
+        }
+        ble.addService(*arena.addService(GattService::UUID_HEART_RATE_SERVICE, chars, CHARACTERISTIC_COUNT));
+    }
+
+    uint16_t getMeasurementHandle(void) const {
+        return measurementChar->getHandle();
+    }
+
+    void onDataWritten(uint16_t charHandle) {
+        if ((controlPointChar != 0) && (charHandle == controlPointChar->getHandle())) {
+            controlPending = true;
+        }
+    }
+
+    /**
+     * Returns true once for every write of CONTROL_RESET_ENERGY_EXPENDED to
+     * the control point. Other values are ignored: BLE_API acknowledges
+     * writes before the application sees them, so the "Control Point not
+     * supported" error can't be returned.
+     */
+    bool energyResetRequested(void) {
+        if (!controlPending) {
+            return false;
+        }
+        controlPending = false;
+
+        uint8_t  value;
+        uint16_t length = sizeof(value);
+        return (ble.readCharacteristicValue(controlPointChar->getHandle(), &value, &length) == BLE_ERROR_NONE) &&
+               (length == 1) && (value == CONTROL_RESET_ENERGY_EXPENDED);
+    }
+
+    Measurement &getMeasurement(void) {
+        return measurement;
+    }
+
+private:
+    BLEDevice          &ble;
+    GattCharacteristic *measurementChar;
+    GattCharacteristic *controlPointChar; /* with energy expended only */
+    volatile bool       controlPending;
+    Measurement         measurement;
+};
+
+#endif /* #ifndef __HEART_RATE_PROFILE_H__ */
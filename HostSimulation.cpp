@@ -0,0 +1,918 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host-native simulation of the measurement path, for benchmarking and
+ * regression-testing the signal processing off-target. It replays a PPG
+ * trace through the same acquisition ring, MeasurementPipeline and
+ * NotificationScheduler the firmware uses, against a simulated link and
+ * clock, as fast as the host allows.
+ *
+ * The firmware build compiles this file to nothing. To build and run it on
+ * a PC (with BENCHMARK_SCENARIO off):
+ *
+ *   g++ -O2 -DHOST_SIMULATION -o hrmsim HostSimulation.cpp BeatDetector.cpp ContactDetector.cpp \
+ *       MotionCanceller.cpp EnergyExpenditure.cpp NotificationScheduler.cpp
+ *   ./hrmsim [-d seconds] [-r bpm] [-m] [-i interval_ms] [-b tx_buffers] [-l loss_percent] [-o off_seconds]
+ *            [trace]
+ *
+ * A trace is a text file of one sample per line at 128Hz, "ppg" or
+ * "ppg,motion" as raw 16-bit ADC readings; '#' starts a comment. Without
+ * one, a synthetic pulse at -r BPM is generated, with a breathing-rate
+ * wobble and, with -m, a motion artefact and its accelerometer reference.
+ * With -o, the sensor is taken off for that long a third and two thirds
+ * of the way through, the second time one contact detection period
+ * longer so that it goes back on in either phase of a contact batch.
+ * While contact is lost, acquisition drops to contact detection as in the
+ * firmware, and the time from putting the sensor back on to the first
+ * measurement is reported.
+ *
+ * Reported are nanoseconds per sample for each stage, heap allocations
+ * made while processing (the firmware has no heap; anything non-zero is a
+ * regression), and a histogram of the latency from the sample that
+ * completed a beat to the connection event that carried its RR-interval.
+ * The run fails if measurements didn't resume with the first beat found
+ * after contact came back.
+ */
+#if HOST_SIMULATION
+
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "HeartRateMeasurement.h"
+#include "MeasurementPipeline.h"
+#include "RingBuffer.h"
+
+/* The reference design's measurement layout (see Sku.h), without the GATT side. */
+typedef HeartRateMeasurement<9, HRM_FEATURE_SENSOR_CONTACT | HRM_FEATURE_ENERGY_EXPENDED> SimMeasurement;
+typedef MeasurementPipeline<SimMeasurement, 3>                                              SimPipeline;
+
+/* Acquisition as in SensorAcquisition: a ring drained in batches. */
+static const unsigned SAMPLE_RATE_HZ = BeatDetector::SAMPLE_RATE_HZ;
+static const unsigned RING_CAPACITY  = 64;
+static const unsigned BATCH_SIZE     = 32;
+
+/* ... and contact detection while the sensor is off, as in SensorAcquisition. */
+static const unsigned CONTACT_RATE_HZ        = 4;
+static const unsigned CONTACT_BATCH_SIZE     = 1;
+static const unsigned CONTACT_PERIOD_SAMPLES = SAMPLE_RATE_HZ / CONTACT_RATE_HZ;
+static const uint16_t OFF_SKIN_LEVEL         = 0x0100; /* face down in a bag */
+static const unsigned OFF_WINDOWS            = 2;      /* times the sensor is taken off with -o */
+
+static const unsigned MAX_PACKETS_PER_EVENT = 6;    /* what the S110 sends in one connection event */
+static const uint32_t CLOCK_START           = 0xFF000000; /* the 32-bit clock wraps ~4.7 minutes in */
+
+static const unsigned LATENCY_BIN_US    = 10000;
+static const unsigned LATENCY_BINS      = 500;  /* the last bin collects everything from 5s on */
+static const unsigned LATENCY_PRINT_BIN = 10;   /* histogram rows of 100ms */
+
+/*
+ * Heap accounting. Nothing on the measurement path may allocate; the trace
+ * is loaded before counting starts.
+ */
+#if __cplusplus >= 201103L
+#define SIM_THROW_BAD_ALLOC
+#define SIM_NOTHROW         noexcept
+#else
+#define SIM_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define SIM_NOTHROW         throw()
+#endif
+
+static unsigned long allocationCount = 0;
+static unsigned long allocationBytes = 0;
+
+void *operator new(size_t size) SIM_THROW_BAD_ALLOC
+{
+    allocationCount++;
+    allocationBytes += size;
+    void *p = malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size) SIM_THROW_BAD_ALLOC
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) SIM_NOTHROW
+{
+    free(p);
+}
+
+void operator delete[](void *p) SIM_NOTHROW
+{
+    free(p);
+}
+
+#if __cpp_sized_deallocation
+void operator delete(void *p, size_t) SIM_NOTHROW
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) SIM_NOTHROW
+{
+    free(p);
+}
+#endif
+
+static uint64_t hostNanoseconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * What reading the clock twice costs, to take out of the stage times that
+ * are measured a call at a time.
+ */
+static uint64_t measureTimerOverhead(void)
+{
+    static const unsigned ROUNDS = 10000;
+    uint64_t total = 0;
+    for (unsigned i = 0; i < ROUNDS; i++) {
+        uint64_t start = hostNanoseconds();
+        total += hostNanoseconds() - start;
+    }
+    return total / ROUNDS;
+}
+
+struct Options {
+    const char *tracePath;
+    unsigned    durationS;
+    unsigned    heartRate;
+    bool        motion;
+    unsigned    intervalMs;
+    unsigned    txBuffers;
+    unsigned    lossPercent;
+    unsigned    offS;
+};
+
+struct TraceSample {
+    uint16_t ppg;
+    uint16_t motion;
+};
+
+/**
+ * Read a recorded trace; returns false if the file can't be read or holds
+ * no samples.
+ */
+static bool loadTrace(const char *path, std::vector<TraceSample> &samples)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *p = line;
+        while ((*p == ' ') || (*p == '\t')) {
+            p++;
+        }
+        if ((*p == '#') || (*p == '\n') || (*p == '\r') || (*p == '\0')) {
+            continue;
+        }
+        TraceSample sample;
+        sample.ppg    = (uint16_t)strtoul(p, &p, 0);
+        sample.motion = SENSOR_MOTION_REST;
+        while ((*p == ' ') || (*p == '\t')) {
+            p++;
+        }
+        if (*p == ',') {
+            sample.motion = (uint16_t)strtoul(p + 1, NULL, 0);
+        }
+        samples.push_back(sample);
+    }
+    fclose(file);
+    return !samples.empty();
+}
+
+/**
+ * A PPG-like pulse (systolic peak, dicrotic notch, diastolic wave) at
+ * 'heartRate', wobbling by 4 BPM over a 4s breath. With 'motion', a 1.7Hz
+ * swing of the hand also leaks into the optical signal, and the
+ * accelerometer sees it.
+ */
+static void generateTrace(const Options &options, std::vector<TraceSample> &samples)
+{
+    static const double PI = 3.14159265358979;
+    unsigned count = options.durationS * SAMPLE_RATE_HZ;
+    double   phase = 0;
+    uint32_t noise = 12345; /* fixed seed: every run sees the same input */
+
+    samples.resize(count);
+    for (unsigned i = 0; i < count; i++) {
+        double t   = (double)i / SAMPLE_RATE_HZ;
+        double bpm = options.heartRate + (4 * sin(2 * PI * t / 4));
+        phase += bpm / (60.0 * SAMPLE_RATE_HZ);
+        phase -= floor(phase);
+
+        double pulse = (4000 * exp(-pow((phase - 0.15) / 0.06, 2))) + (1600 * exp(-pow((phase - 0.42) / 0.1, 2)));
+        double swing = options.motion ? sin(2 * PI * 1.7 * t) : 0;
+        noise = (noise * 1103515245UL) + 12345;
+
+        samples[i].ppg    = (uint16_t)(30000 + pulse + (6000 * swing) + ((noise >> 24) & 0x3F));
+        samples[i].motion = (uint16_t)(SENSOR_MOTION_REST + (8000 * swing));
+    }
+}
+
+/**
+ * Times of beats whose RR-intervals haven't been transmitted yet, oldest
+ * first, so that a transmitted interval can be traced back to the sample
+ * that completed its beat.
+ */
+class BeatTimes {
+public:
+    static const unsigned CAPACITY = 64;
+
+    struct Entry {
+        uint16_t rrInterval;
+        uint32_t time;
+    };
+
+public:
+    BeatTimes() : head(0), count(0), dropped(0) {
+        /* empty */
+    }
+
+    void push(uint16_t rrInterval, uint32_t time) {
+        if (count == CAPACITY) {
+            pop();
+            dropped++;
+        }
+        entries[(head + count) % CAPACITY].rrInterval = rrInterval;
+        entries[(head + count) % CAPACITY].time       = time;
+        count++;
+    }
+
+    /**
+     * Find the oldest beat with this interval. Older ones were dropped by
+     * the encoder when its queue overflowed.
+     */
+    bool match(uint16_t rrInterval, uint32_t &time) {
+        while (count > 0) {
+            Entry entry = pop();
+            if (entry.rrInterval == rrInterval) {
+                time = entry.time;
+                return true;
+            }
+            dropped++;
+        }
+        return false;
+    }
+
+    unsigned long getDroppedCount(void) const {
+        return dropped;
+    }
+
+private:
+    Entry pop(void) {
+        Entry entry = entries[head];
+        head = (head + 1) % CAPACITY;
+        count--;
+        return entry;
+    }
+
+private:
+    Entry         entries[CAPACITY];
+    unsigned      head;
+    unsigned      count;
+    unsigned long dropped;
+};
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() : count(0), total(0), worst(0) {
+        memset(bins, 0, sizeof(bins));
+    }
+
+    void add(uint32_t latencyUs) {
+        unsigned bin = latencyUs / LATENCY_BIN_US;
+        bins[(bin < LATENCY_BINS) ? bin : (LATENCY_BINS - 1)]++;
+        count++;
+        total += latencyUs;
+        if (latencyUs > worst) {
+            worst = latencyUs;
+        }
+    }
+
+    /**
+     * Upper edge of the bin holding the given fraction of all samples, in
+     * milliseconds, but never more than the worst latency seen: that bin's
+     * samples may all sit low in it, and the last bin has no upper edge.
+     */
+    unsigned percentileMs(unsigned percent) const {
+        unsigned long wanted = ((count * percent) + 99) / 100;
+        unsigned long seen   = 0;
+        for (unsigned i = 0; i < LATENCY_BINS; i++) {
+            seen += bins[i];
+            if ((seen >= wanted) && (seen > 0)) {
+                uint32_t edgeUs = (i + 1) * LATENCY_BIN_US;
+                return (((i + 1) < LATENCY_BINS) && (edgeUs < worst)) ? (edgeUs / 1000) : (worst / 1000);
+            }
+        }
+        return 0;
+    }
+
+    void print(void) const;
+
+private:
+    unsigned long bins[LATENCY_BINS];
+    unsigned long count;
+    uint64_t      total;
+    uint32_t      worst;
+};
+
+void LatencyHistogram::print(void) const
+{
+    if (count == 0) {
+        printf("latency: no RR-interval was transmitted\n");
+        return;
+    }
+    printf("latency, beat detected to RR-interval on the air (%lu intervals):\n", count);
+    printf("  mean %lums  p50 %ums  p90 %ums  p99 %ums  max %lums\n", (unsigned long)(total / count / 1000),
+           percentileMs(50), percentileMs(90), percentileMs(99), (unsigned long)(worst / 1000));
+
+    unsigned long peak = 0;
+    unsigned      last = 0;
+    for (unsigned row = 0; row < (LATENCY_BINS / LATENCY_PRINT_BIN); row++) {
+        unsigned long rowCount = 0;
+        for (unsigned i = 0; i < LATENCY_PRINT_BIN; i++) {
+            rowCount += bins[(row * LATENCY_PRINT_BIN) + i];
+        }
+        if (rowCount > peak) {
+            peak = rowCount;
+        }
+        if (rowCount > 0) {
+            last = row;
+        }
+    }
+    for (unsigned row = 0; row <= last; row++) {
+        unsigned long rowCount = 0;
+        for (unsigned i = 0; i < LATENCY_PRINT_BIN; i++) {
+            rowCount += bins[(row * LATENCY_PRINT_BIN) + i];
+        }
+        char bar[41];
+        unsigned width = (unsigned)((rowCount * 40) / peak);
+        memset(bar, '#', width);
+        bar[width] = '\0';
+        unsigned from = (row * LATENCY_PRINT_BIN * LATENCY_BIN_US) / 1000;
+        printf("  %4u-%4ums %7lu %s\n", from, from + ((LATENCY_PRINT_BIN * LATENCY_BIN_US) / 1000), rowCount, bar);
+    }
+}
+
+/**
+ * A single connected central, subscribed throughout. Accepted frames sit
+ * in the stack's transmit buffers until the next connection event that
+ * isn't lost.
+ */
+class SimLink : public MeasurementLink {
+public:
+    static const unsigned MAX_TX_BUFFERS = 8;
+
+    struct Packet {
+        uint8_t data[SimMeasurement::MAX_PAYLOAD];
+        uint8_t length;
+    };
+
+public:
+    SimLink(unsigned txBuffersIn, BeatTimes &beatTimesIn, LatencyHistogram &latencyIn) :
+        txBuffers((txBuffersIn < MAX_TX_BUFFERS) ? txBuffersIn : MAX_TX_BUFFERS),
+        beatTimes(beatTimesIn),
+        latency(latencyIn),
+        queued(0),
+        refused(0),
+        transmitted(0) {
+        /* empty */
+    }
+
+    virtual bool isSubscribed(void) {
+        return true;
+    }
+
+    virtual bool send(const uint8_t *data, unsigned length) {
+        if (queued >= txBuffers) {
+            refused++;
+            return false; /* BLE_ERROR_NO_TX_BUFFERS */
+        }
+        memcpy(buffers[queued].data, data, length);
+        buffers[queued].length = (uint8_t)length;
+        queued++;
+        return true;
+    }
+
+    virtual void discard(void) {
+        /* nothing is ever discarded while subscribed */
+    }
+
+    /**
+     * Transmit what is buffered, as a connection event at 'now' would.
+     * Returns the number of packets sent.
+     */
+    unsigned connectionEvent(uint32_t now);
+
+    unsigned long getRefusedCount(void) const {
+        return refused;
+    }
+
+    unsigned long getTransmittedCount(void) const {
+        return transmitted;
+    }
+
+private:
+    void traceRRIntervals(const Packet &packet, uint32_t now);
+
+private:
+    unsigned          txBuffers;
+    BeatTimes        &beatTimes;
+    LatencyHistogram &latency;
+    Packet            buffers[MAX_TX_BUFFERS];
+    unsigned          queued;
+    unsigned long     refused;
+    unsigned long     transmitted;
+};
+
+unsigned SimLink::connectionEvent(uint32_t now)
+{
+    unsigned sent = (queued < MAX_PACKETS_PER_EVENT) ? queued : MAX_PACKETS_PER_EVENT;
+    for (unsigned i = 0; i < sent; i++) {
+        traceRRIntervals(buffers[i], now);
+    }
+    memmove(&buffers[0], &buffers[sent], (queued - sent) * sizeof(buffers[0]));
+    queued      -= sent;
+    transmitted += sent;
+    return sent;
+}
+
+/**
+ * Decode the RR-intervals of a Heart Rate Measurement and record how long
+ * each one took to get here.
+ */
+void SimLink::traceRRIntervals(const Packet &packet, uint32_t now)
+{
+    uint8_t  flags  = packet.data[0];
+    unsigned offset = (flags & SimMeasurement::FLAG_VALUE_FORMAT_UINT16) ? 3 : 2;
+    if (flags & SimMeasurement::FLAG_ENERGY_EXPENDED_PRESENT) {
+        offset += 2;
+    }
+    if (!(flags & SimMeasurement::FLAG_RR_INTERVALS_PRESENT)) {
+        return;
+    }
+    for (; (offset + 2) <= packet.length; offset += 2) {
+        uint16_t rrInterval = (uint16_t)(packet.data[offset] | (packet.data[offset + 1] << 8));
+        uint32_t beatTime;
+        if (beatTimes.match(rrInterval, beatTime)) {
+            latency.add(now - beatTime);
+        }
+    }
+}
+
+class SimObserver : public MeasurementObserver {
+public:
+    SimObserver(BeatTimes &beatTimesIn) :
+        beatTimes(beatTimesIn), sampleTime(0), lastBeatTime(0), beats(0), notifications(0), dropped(0) {
+        /* empty */
+    }
+
+    virtual void onBeat(const BeatDetector::Beat &beat) {
+        beatTimes.push(beat.rrInterval, sampleTime);
+        beats++;
+        lastBeatTime = sampleTime;
+    }
+
+    virtual void onContactChanged(bool worn) {
+        printf("sensor contact %s at %.2fs\n", worn ? "on" : "off", (double)(sampleTime - CLOCK_START) / 1000000);
+    }
+
+    virtual void onMeasurementSent(void) {
+        notifications++;
+    }
+
+    virtual void onMeasurementDropped(void) {
+        dropped++;
+    }
+
+    void setSampleTime(uint32_t time) {
+        sampleTime = time;
+    }
+
+    unsigned long getBeatCount(void) const {
+        return beats;
+    }
+
+    uint32_t getLastBeatTime(void) const {
+        return lastBeatTime;
+    }
+
+    unsigned long getNotificationCount(void) const {
+        return notifications;
+    }
+
+    unsigned long getDroppedCount(void) const {
+        return dropped;
+    }
+
+private:
+    BeatTimes    &beatTimes;
+    uint32_t      sampleTime; /* acquisition time of the sample being processed */
+    uint32_t      lastBeatTime;
+    unsigned long beats;
+    unsigned long notifications;
+    unsigned long dropped;
+};
+
+/**
+ * How quickly measurements come back once the sensor is put on again: the
+ * contact detector should see it within one sampling period at contact
+ * detection rate, and the first beat detected since should go out in a
+ * measurement before the next one.
+ */
+class ResumeCheck {
+public:
+    ResumeCheck() :
+        state(STATE_IDLE), backOn(0), contactSeen(0), firstBeat(0), firstMeasurement(0), beatsBefore(0),
+        notificationsBefore(0), beatsMeasured(0) {
+        /* empty */
+    }
+
+    void sensorBackOn(uint32_t now, const SimObserver &observer) {
+        state               = STATE_WAITING_FOR_CONTACT;
+        backOn              = now;
+        beatsBefore         = observer.getBeatCount();
+        notificationsBefore = observer.getNotificationCount();
+    }
+
+    /**
+     * Call after anything that may have detected contact, a beat, or sent a
+     * measurement.
+     */
+    void update(uint32_t now, const SimObserver &observer, bool inContact);
+
+    /**
+     * Returns false if the check failed.
+     */
+    bool report(uint32_t offUs) const;
+
+private:
+    enum State {
+        STATE_IDLE,
+        STATE_WAITING_FOR_CONTACT,
+        STATE_WAITING_FOR_MEASUREMENT,
+        STATE_DONE
+    };
+
+private:
+    State         state;
+    uint32_t      backOn;
+    uint32_t      contactSeen;
+    uint32_t      firstBeat;
+    uint32_t      firstMeasurement;
+    unsigned long beatsBefore;
+    unsigned long notificationsBefore;
+    unsigned long beatsMeasured; /* beats detected by the first measurement */
+};
+
+void ResumeCheck::update(uint32_t now, const SimObserver &observer, bool inContact)
+{
+    if ((state == STATE_WAITING_FOR_CONTACT) && inContact) {
+        state       = STATE_WAITING_FOR_MEASUREMENT;
+        contactSeen = now;
+    }
+    if (state != STATE_WAITING_FOR_MEASUREMENT) {
+        return;
+    }
+    if ((firstBeat == 0) && (observer.getBeatCount() > beatsBefore)) {
+        firstBeat = observer.getLastBeatTime();
+    }
+    if (observer.getNotificationCount() > notificationsBefore) {
+        state            = STATE_DONE;
+        firstMeasurement = now;
+        beatsMeasured    = observer.getBeatCount() - beatsBefore;
+    }
+}
+
+bool ResumeCheck::report(uint32_t offUs) const
+{
+    if (state == STATE_IDLE) {
+        printf("resume: contact was never lost in %lums off the skin\n", (unsigned long)(offUs / 1000));
+        return false;
+    }
+    if (state != STATE_DONE) {
+        printf("resume: no measurement after the sensor went back on\n");
+        return false;
+    }
+    bool pass = ((contactSeen - backOn) <= (1000000 / CONTACT_RATE_HZ)) && (beatsMeasured == 1);
+    printf("resume after %lums off: contact seen after %lums, first beat after %lums, first measurement after "
+           "%lums with %lu beat(s): %s\n", (unsigned long)(offUs / 1000),
+           (unsigned long)((contactSeen - backOn) / 1000), (unsigned long)((firstBeat - backOn) / 1000),
+           (unsigned long)((firstMeasurement - backOn) / 1000), beatsMeasured, pass ? "ok" : "FAILED");
+    return pass;
+}
+
+struct StageTime {
+    const char   *name;
+    uint64_t      ns;
+    unsigned long calls;
+};
+
+static void printStage(StageTime stage, unsigned long samples, uint64_t timerOverhead)
+{
+    uint64_t overhead = timerOverhead * stage.calls;
+    stage.ns = (stage.ns > overhead) ? (stage.ns - overhead) : 0;
+    printf("  %-16s %9.1f %10lu %9.1f\n", stage.name, (double)stage.ns / samples, stage.calls,
+           stage.calls ? ((double)stage.ns / stage.calls) : 0.0);
+}
+
+/**
+ * Each signal processing stage on its own over the whole trace, for a
+ * clean per-sample cost.
+ */
+static void benchmarkStages(const std::vector<TraceSample> &trace)
+{
+    unsigned long         samples = trace.size();
+    std::vector<uint16_t> cleaned(samples);
+    StageTime             stages[3] = {{"contact", 0, 0}, {"motion cancel", 0, 0}, {"beat detection", 0, 0}};
+    volatile unsigned     sink = 0; /* keeps the results alive */
+
+    ContactDetector contactDetector;
+    uint64_t        start = hostNanoseconds();
+    for (unsigned long i = 0; i < samples; i++) {
+        sink += contactDetector.process(trace[i].ppg, 1000000 / SAMPLE_RATE_HZ);
+    }
+    stages[0].ns    = hostNanoseconds() - start;
+    stages[0].calls = samples;
+
+    MotionCanceller motionCanceller;
+    start = hostNanoseconds();
+    for (unsigned long i = 0; i < samples; i++) {
+#if MOTION_SENSOR_ENABLED
+        cleaned[i] = motionCanceller.process(trace[i].ppg, trace[i].motion);
+#else
+        cleaned[i] = trace[i].ppg;
+#endif
+    }
+    stages[1].ns    = hostNanoseconds() - start;
+    stages[1].calls = samples;
+    (void)motionCanceller;
+
+    BeatDetector beatDetector;
+    start = hostNanoseconds();
+    for (unsigned long i = 0; i < samples; i++) {
+        BeatDetector::Beat beat;
+        sink += beatDetector.process(cleaned[i], beat);
+    }
+    stages[2].ns    = hostNanoseconds() - start;
+    stages[2].calls = samples;
+    (void)sink;
+
+    printf("per stage, standalone:\n");
+    printf("  %-16s %9s %10s %9s\n", "stage", "ns/sample", "calls", "ns/call");
+    for (unsigned i = 0; i < (sizeof(stages) / sizeof(stages[0])); i++) {
+        printStage(stages[i], samples, 0);
+    }
+}
+
+/**
+ * The whole path, in simulated time: samples enter the ring at the
+ * acquisition rate and are processed a batch at a time, as the main loop
+ * does; flushes happen when the scheduler asks, and the link transmits at
+ * every connection event that isn't lost.
+ */
+static bool simulate(const std::vector<TraceSample> &trace, const Options &options)
+{
+    BeatTimes             beatTimes;
+    static LatencyHistogram latency; /* too large for some stacks */
+    SimMeasurement        encoder;
+    EnergyExpenditure     energy(75, 35, false);
+    NotificationScheduler scheduler;
+    SimLink               link(options.txBuffers, beatTimes, latency);
+    SimObserver           observer(beatTimes);
+    SimPipeline           pipeline(encoder, energy, scheduler, link, observer);
+    ResumeCheck           resume[OFF_WINDOWS];
+
+    RingBuffer<SensorSample, RING_CAPACITY> ring;
+    SensorSample                            batch[BATCH_SIZE];
+    StageTime stages[4] = {{"acquisition", 0, 0}, {"pipeline", 0, 0}, {"flush", 0, 0}, {"send", 0, 0}};
+
+    uint64_t timerOverhead      = measureTimerOverhead();
+    uint32_t connectionInterval = options.intervalMs * 1000;
+    uint32_t nextEvent          = CLOCK_START + connectionInterval;
+    uint32_t lossSeed           = 1;
+    unsigned long lostEvents    = 0;
+
+    unsigned long samples       = trace.size();
+    unsigned long offFrom[OFF_WINDOWS];
+    unsigned long offUntil[OFF_WINDOWS];
+    for (unsigned w = 0; w < OFF_WINDOWS; w++) {
+        offFrom[w]  = (options.offS > 0) ? ((samples * (w + 1)) / (OFF_WINDOWS + 1)) : samples;
+        offUntil[w] = offFrom[w] + ((unsigned long)options.offS * SAMPLE_RATE_HZ) + (w * CONTACT_PERIOD_SAMPLES);
+    }
+    bool          contactMode   = false; /* acquiring at CONTACT_RATE_HZ, since sample 'contactFrom' */
+    unsigned long contactFrom   = 0;
+
+    scheduler.setConnectionInterval((uint16_t)((options.intervalMs * 4) / 5));
+    scheduler.onConnected(CLOCK_START);
+    pipeline.restart();
+
+    unsigned long allocationsBefore = allocationCount;
+    unsigned long bytesBefore       = allocationBytes;
+    uint64_t      wallStart         = hostNanoseconds();
+    for (unsigned long i = 0; i < samples; i++) {
+        uint32_t now = CLOCK_START + (uint32_t)(((uint64_t)i * 1000000) / SAMPLE_RATE_HZ);
+
+        /* Everything due before this sample: flushes and connection events, in order. */
+        while (true) {
+            bool flushFirst = scheduler.isPending() && ((int32_t)(scheduler.getFlushTime() - nextEvent) <= 0);
+            uint32_t when   = flushFirst ? scheduler.getFlushTime() : nextEvent;
+            if ((int32_t)(when - now) > 0) {
+                break;
+            }
+            uint64_t start = hostNanoseconds();
+            if (flushFirst) {
+                pipeline.flush(when);
+                stages[2].ns += hostNanoseconds() - start;
+                stages[2].calls++;
+                for (unsigned w = 0; w < OFF_WINDOWS; w++) {
+                    resume[w].update(when, observer, pipeline.getContactState() == ContactDetector::STATE_ON);
+                }
+                continue;
+            }
+            nextEvent += connectionInterval;
+            lossSeed   = (lossSeed * 1103515245UL) + 12345;
+            if (((lossSeed >> 16) % 100) < options.lossPercent) {
+                lostEvents++;
+                continue;
+            }
+            if (link.connectionEvent(when) > 0) {
+                scheduler.onTransmissionComplete(when);
+                if (pipeline.getQueuedCount() > 0) {
+                    pipeline.send();
+                }
+                stages[3].ns += hostNanoseconds() - start;
+                stages[3].calls++;
+                for (unsigned w = 0; w < OFF_WINDOWS; w++) {
+                    resume[w].update(when, observer, pipeline.getContactState() == ContactDetector::STATE_ON);
+                }
+            }
+        }
+
+        bool offSkin = false;
+        for (unsigned w = 0; w < OFF_WINDOWS; w++) {
+            if ((i == offUntil[w]) && contactMode) {
+                resume[w].sensorBackOn(now, observer);
+            }
+            offSkin |= (i >= offFrom[w]) && (i < offUntil[w]);
+        }
+        /* The sampling ticker only fires every so often in contact detection, starting a period in. */
+        if (contactMode && ((i == contactFrom) || (((i - contactFrom) % CONTACT_PERIOD_SAMPLES) != 0))) {
+            continue;
+        }
+
+        uint64_t start = hostNanoseconds();
+        SensorSample sample;
+        sample.ppg    = offSkin ? OFF_SKIN_LEVEL : trace[i].ppg;
+        sample.motion = (offSkin || contactMode) ? SENSOR_MOTION_REST : trace[i].motion;
+        sample.tick   = (uint16_t)i;
+        ring.push(sample);
+        unsigned count = 0;
+        if (ring.count() >= (contactMode ? CONTACT_BATCH_SIZE : BATCH_SIZE)) {
+            count = ring.pop(batch, BATCH_SIZE);
+        }
+        stages[0].ns += hostNanoseconds() - start;
+        stages[0].calls++;
+        if (count == 0) {
+            continue;
+        }
+
+        /* One sample at a time, so that every beat is stamped with its own sample's time. */
+        start = hostNanoseconds();
+        if (contactMode) {
+            observer.setSampleTime(now);
+            pipeline.processContactSamples(batch, count, 1000000 / CONTACT_RATE_HZ, now);
+        } else {
+            for (unsigned j = 0; j < count; j++) {
+                observer.setSampleTime(now - (uint32_t)((((uint64_t)(count - 1 - j)) * 1000000) / SAMPLE_RATE_HZ));
+                pipeline.processSamples(&batch[j], 1, now);
+            }
+        }
+        stages[1].ns += hostNanoseconds() - start;
+        stages[1].calls++;
+
+        /* Acquisition follows contact, as updateAcquisition() does. */
+        bool standby = pipeline.getContactState() == ContactDetector::STATE_OFF;
+        if (standby != contactMode) {
+            ring.flush();
+            contactMode = standby;
+            contactFrom = i;
+            if (!standby) {
+                pipeline.restart();
+            }
+        }
+        for (unsigned w = 0; w < OFF_WINDOWS; w++) {
+            resume[w].update(now, observer, pipeline.getContactState() == ContactDetector::STATE_ON);
+        }
+    }
+    uint64_t      wallNs      = hostNanoseconds() - wallStart;
+    unsigned long allocations = allocationCount - allocationsBefore;
+    unsigned long bytes       = allocationBytes - bytesBefore;
+
+    double simulatedS = (double)samples / SAMPLE_RATE_HZ;
+    printf("end to end, %lu samples (%.1fs) in %.3fs: %.0fx real time\n", samples, simulatedS,
+           (double)wallNs / 1e9, simulatedS / ((double)wallNs / 1e9));
+    printf("  %-16s %9s %10s %9s\n", "stage", "ns/sample", "calls", "ns/call");
+    for (unsigned i = 0; i < (sizeof(stages) / sizeof(stages[0])); i++) {
+        printStage(stages[i], samples, timerOverhead);
+    }
+    printf("heap allocations while processing: %lu (%lu bytes)\n", allocations, bytes);
+    printf("beats %lu, notifications %lu (%lu dropped), packets on the air %lu, refused by the stack %lu\n",
+           observer.getBeatCount(), observer.getNotificationCount(), observer.getDroppedCount(),
+           link.getTransmittedCount(), link.getRefusedCount());
+    printf("connection events lost %lu, RR-intervals dropped %lu, energy expended %ukJ\n", lostEvents,
+           beatTimes.getDroppedCount(), energy.getKiloJoules());
+    latency.print();
+
+    bool pass = true;
+    for (unsigned w = 0; (w < OFF_WINDOWS) && (options.offS > 0); w++) {
+        pass &= resume[w].report((uint32_t)((offUntil[w] - offFrom[w]) * 1000000) / SAMPLE_RATE_HZ);
+    }
+    return pass;
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-d seconds] [-r bpm] [-m] [-i interval_ms] [-b tx_buffers] [-l loss_percent] "
+                    "[-o off_seconds] [trace]\n", program);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    Options options = {NULL, 600, 72, false, 30, 7, 0, 0};
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if ((arg[0] != '-') && (options.tracePath == NULL)) {
+            options.tracePath = arg;
+        } else if (strcmp(arg, "-m") == 0) {
+            options.motion = true;
+        } else if (((i + 1) < argc) && (strlen(arg) == 2)) {
+            unsigned value = (unsigned)strtoul(argv[++i], NULL, 0);
+            switch (arg[1]) {
+                case 'd': options.durationS   = value; break;
+                case 'r': options.heartRate   = value; break;
+                case 'i': options.intervalMs  = value; break;
+                case 'b': options.txBuffers   = value; break;
+                case 'l': options.lossPercent = value; break;
+                case 'o': options.offS        = value; break;
+                default:  usage(argv[0]);
+            }
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if ((options.intervalMs < 8) || (options.intervalMs > 4000) || (options.txBuffers == 0)) {
+        usage(argv[0]);
+    }
+
+    std::vector<TraceSample> trace;
+    if (options.tracePath != NULL) {
+        if (!loadTrace(options.tracePath, trace)) {
+            fprintf(stderr, "%s: no samples\n", options.tracePath);
+            return 1;
+        }
+    } else {
+        generateTrace(options, trace);
+        if (trace.empty()) {
+            usage(argv[0]);
+        }
+    }
+
+    printf("HRMSIM v1 samples=%lu interval_ms=%u tx_buffers=%u loss_percent=%u motion_cancel=%u\n",
+           (unsigned long)trace.size(), options.intervalMs, options.txBuffers, options.lossPercent,
+           MOTION_SENSOR_ENABLED);
+    benchmarkStages(trace);
+    return simulate(trace, options) ? 0 : 1;
+}
+
+#endif /* #if HOST_SIMULATION */
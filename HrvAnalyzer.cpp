@@ -0,0 +1,165 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HrvAnalyzer.h"
+
+/*
+ * (1/1024 s)^2 to (0.1ms)^2 is a factor of (10000 / 1024)^2 = 390625 / 4096.
+ */
+static const uint32_t SQUARED_SCALE_NUMERATOR   = 390625;
+static const uint32_t SQUARED_SCALE_DENOMINATOR = 4096;
+
+/**
+ * Integer square root, rounded down; only run from getResult().
+ */
+static uint32_t squareRoot(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit  = (uint64_t)1 << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root   = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+static uint16_t saturate(uint32_t value)
+{
+    return (value > 0xFFFF) ? 0xFFFF : (uint16_t)value;
+}
+
+HrvAnalyzer::HrvAnalyzer(const uint16_t *lengths, unsigned count) :
+    windowCount((count < MAX_WINDOWS) ? count : MAX_WINDOWS)
+{
+    for (unsigned i = 0; i < windowCount; i++) {
+        uint16_t length   = (lengths[i] > MIN_WINDOW_BEATS) ? lengths[i] : MIN_WINDOW_BEATS;
+        windows[i].length = (length < MAX_WINDOW_BEATS) ? length : MAX_WINDOW_BEATS;
+    }
+    reset();
+}
+
+void HrvAnalyzer::reset(void)
+{
+    for (unsigned i = 0; i < windowCount; i++) {
+        Window &w = windows[i];
+        w.beats                = 0;
+        w.differences          = 0;
+        w.nn50                 = 0;
+        w.sum                  = 0;
+        w.sumSquares           = 0;
+        w.sumDifferenceSquares = 0;
+    }
+    newest = 0;
+}
+
+/**
+ * The interval 'age' beats before the newest one.
+ */
+uint16_t HrvAnalyzer::beat(unsigned age) const
+{
+    return ring[(newest + MAX_WINDOW_BEATS - age) % MAX_WINDOW_BEATS];
+}
+
+/**
+ * Add (sign > 0) or take off the successive difference between two
+ * neighbouring intervals. Whether it counts only depends on the two, so it
+ * is taken off exactly as it was added.
+ */
+void HrvAnalyzer::addDifference(Window &w, uint16_t earlier, uint16_t later, int sign)
+{
+    uint32_t difference = (later > earlier) ? (later - earlier) : (earlier - later);
+    if ((difference * 5) > earlier) {
+        return; /* a missed or extra beat */
+    }
+    uint32_t square   = difference * difference;
+    bool     over50ms = (difference * 1000) > (50 * 1024);
+    if (sign > 0) {
+        w.differences++;
+        w.sumDifferenceSquares += square;
+        w.nn50                 += over50ms ? 1 : 0;
+    } else {
+        w.differences--;
+        w.sumDifferenceSquares -= square;
+        w.nn50                 -= over50ms ? 1 : 0;
+    }
+}
+
+void HrvAnalyzer::addBeat(uint16_t rrInterval)
+{
+    if ((rrInterval < MIN_RR_INTERVAL) || (rrInterval > MAX_RR_INTERVAL)) {
+        return;
+    }
+
+    for (unsigned i = 0; i < windowCount; i++) {
+        Window &w = windows[i];
+        if (w.beats == w.length) {
+            /* The oldest beat in the window makes room, with the difference to its successor. */
+            uint16_t oldest = beat(w.length - 1);
+            w.beats--;
+            w.sum        -= oldest;
+            w.sumSquares -= (uint32_t)oldest * oldest;
+            addDifference(w, oldest, beat(w.length - 2), -1);
+        }
+        if (w.beats > 0) {
+            addDifference(w, beat(0), rrInterval, 1);
+        }
+        w.beats++;
+        w.sum        += rrInterval;
+        w.sumSquares += (uint32_t)rrInterval * rrInterval;
+    }
+
+    /* Only now, as the longest window's oldest beat was still needed above. */
+    newest       = (newest + 1) % MAX_WINDOW_BEATS;
+    ring[newest] = rrInterval;
+}
+
+bool HrvAnalyzer::getResult(unsigned window, Result &result) const
+{
+    if (window >= windowCount) {
+        return false;
+    }
+    const Window &w = windows[window];
+    uint32_t      n = w.beats;
+    if (n < 2) {
+        return false;
+    }
+
+    result.beats  = (uint16_t)n;
+    result.meanRr = saturate((w.sum * 125) / (n * 128)); /* * 1000 / 1024 */
+
+    /* Sample standard deviation: (n * sum of squares - sum^2) / (n * (n - 1)), exact up to the scaling. */
+    uint64_t spread = (uint64_t)n * w.sumSquares - (uint64_t)w.sum * w.sum;
+    result.sdnn     = saturate(squareRoot((spread * SQUARED_SCALE_NUMERATOR) /
+                                          ((uint64_t)n * (n - 1) * SQUARED_SCALE_DENOMINATOR)));
+
+    if (w.differences > 0) {
+        result.rmssd = saturate(squareRoot((w.sumDifferenceSquares * SQUARED_SCALE_NUMERATOR) /
+                                           ((uint64_t)w.differences * SQUARED_SCALE_DENOMINATOR)));
+        result.pnn50 = (uint16_t)(((uint32_t)w.nn50 * 1000) / w.differences);
+    } else {
+        result.rmssd = 0;
+        result.pnn50 = 0;
+    }
+    return true;
+}
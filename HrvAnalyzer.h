@@ -0,0 +1,107 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HRV_ANALYZER_H__
+#define __HRV_ANALYZER_H__
+
+#include <stdint.h>
+
+/**
+ * Heart rate variability over the last few RR-intervals: RMSSD, SDNN and
+ * pNN50, each over up to MAX_WINDOWS rolling windows of a fixed number of
+ * beats.
+ *
+ * The RR-intervals of the longest window are kept in a ring. Every window
+ * keeps running sums of its intervals, their squares, the squared
+ * successive differences and the number of those over 50ms; a beat adds its
+ * terms and takes those of the beat falling out of the window off again, so
+ * the cost per beat is constant and independent of the window length. The
+ * sums are exact integers, in units of 1/1024 s, so nothing drifts however
+ * long the window has been rolling, and the divisions and square roots that
+ * turn them into statistics are only done by getResult(), when a central
+ * asks.
+ *
+ * Intervals outside MIN_RR_INTERVAL .. MAX_RR_INTERVAL are not beats and
+ * are left out. A successive difference of more than a fifth of the
+ * earlier interval is taken for a missed or extra beat and left out of
+ * RMSSD and pNN50 (not out of SDNN, which such a beat hardly moves).
+ */
+class HrvAnalyzer {
+public:
+    static const unsigned MAX_WINDOWS      = 3;
+    static const unsigned MIN_WINDOW_BEATS = 2;    /* the fewest that give a successive difference */
+    static const unsigned MAX_WINDOW_BEATS = 256;
+    static const uint16_t MIN_RR_INTERVAL  = 307;  /* 1/1024 s: 300ms, 200 bpm */
+    static const uint16_t MAX_RR_INTERVAL  = 2048; /* 2s, 30 bpm */
+
+    struct Result {
+        uint16_t beats;       /* in the window so far */
+        uint16_t meanRr;      /* ms */
+        uint16_t rmssd;       /* 0.1ms */
+        uint16_t sdnn;        /* 0.1ms */
+        uint16_t pnn50;       /* 0.1% */
+    };
+
+public:
+    /**
+     * 'lengths' are the windows, in beats, each clamped to
+     * MIN_WINDOW_BEATS .. MAX_WINDOW_BEATS.
+     */
+    HrvAnalyzer(const uint16_t *lengths, unsigned count);
+
+    /**
+     * Forget every beat, when beat detection starts over.
+     */
+    void reset(void);
+
+    void addBeat(uint16_t rrInterval);
+
+    unsigned getWindowCount(void) const {
+        return windowCount;
+    }
+
+    uint16_t getWindowLength(unsigned window) const {
+        return windows[window].length;
+    }
+
+    /**
+     * The statistics of 'window'. Returns false if it has fewer than two
+     * beats to go by.
+     */
+    bool getResult(unsigned window, Result &result) const;
+
+private:
+    struct Window {
+        uint16_t length;
+        uint16_t beats;
+        uint16_t differences; /* successive differences counted, at most beats - 1 */
+        uint16_t nn50;
+        uint32_t sum;
+        uint64_t sumSquares;
+        uint64_t sumDifferenceSquares;
+    };
+
+    uint16_t beat(unsigned age) const;
+    void     addDifference(Window &window, uint16_t earlier, uint16_t later, int sign);
+
+private:
+    Window   windows[MAX_WINDOWS];
+    unsigned windowCount;
+    uint16_t ring[MAX_WINDOW_BEATS];
+    unsigned newest; /* index in 'ring' */
+};
+
+#endif /* #ifndef __HRV_ANALYZER_H__ */
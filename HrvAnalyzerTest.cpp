@@ -0,0 +1,224 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host-native test of HrvAnalyzer: RR series are fed a beat at a time and
+ * every window's statistics are compared, after each beat, with the same
+ * statistics worked out from scratch over the window's beats. Window
+ * lengths outside MIN_WINDOW_BEATS .. MAX_WINDOW_BEATS must be clamped.
+ *
+ * The firmware build compiles this file to nothing. To build and run it on
+ * a PC:
+ *
+ *   g++ -O2 -DHOST_SIMULATION -o hrvtest HrvAnalyzerTest.cpp HrvAnalyzer.cpp
+ *   ./hrvtest
+ *
+ * It prints one line per case and exits non-zero if any check failed.
+ */
+#if HOST_SIMULATION
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "HrvAnalyzer.h"
+
+typedef std::vector<uint16_t> Series;
+
+static unsigned failures = 0;
+
+#define CHECK(condition)                                                       \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+/* The analyzer rounds down in integer arithmetic; allow for the last digit. */
+static bool near(uint16_t value, double expected)
+{
+    return fabs((double)value - expected) <= 1.0;
+}
+
+/**
+ * The statistics of the last 'length' beats of 'beats', in floating point.
+ * Returns false where the analyzer has no result either.
+ */
+static bool expectedResult(const Series &beats, unsigned length, HrvAnalyzer::Result &result,
+                           double &meanRr, double &rmssd, double &sdnn, double &pnn50)
+{
+    size_t n     = (beats.size() < length) ? beats.size() : length;
+    size_t first = beats.size() - n;
+    if (n < 2) {
+        return false;
+    }
+
+    double sum = 0;
+    for (size_t i = first; i < beats.size(); i++) {
+        sum += beats[i];
+    }
+    double mean   = sum / n;
+    double spread = 0;
+    for (size_t i = first; i < beats.size(); i++) {
+        spread += (beats[i] - mean) * (beats[i] - mean);
+    }
+
+    double   differenceSquares = 0;
+    unsigned differences       = 0;
+    unsigned nn50              = 0;
+    for (size_t i = first + 1; i < beats.size(); i++) {
+        double difference = fabs((double)beats[i] - beats[i - 1]);
+        if ((difference * 5) > beats[i - 1]) {
+            continue; /* a missed or extra beat */
+        }
+        differenceSquares += difference * difference;
+        differences++;
+        nn50 += ((difference * 1000) > (50 * 1024)) ? 1 : 0;
+    }
+
+    result.beats = (uint16_t)n;
+    meanRr       = (mean * 1000) / 1024;
+    sdnn         = (sqrt(spread / (n - 1)) * 10000) / 1024;
+    rmssd        = (differences > 0) ? ((sqrt(differenceSquares / differences) * 10000) / 1024) : 0;
+    pnn50        = (differences > 0) ? floor(((double)nn50 * 1000) / differences) : 0;
+    return true;
+}
+
+/**
+ * Feed 'series' to an analyzer with windows of 'lengths', checking every
+ * window after every beat. Returns the number of comparisons made.
+ */
+static unsigned checkSeries(const char *name, const uint16_t *lengths, unsigned count, const Series &series)
+{
+    HrvAnalyzer analyzer(lengths, count);
+    Series      accepted;
+    unsigned    compared = 0;
+    bool        ok       = true;
+
+    for (size_t i = 0; ok && (i < series.size()); i++) {
+        analyzer.addBeat(series[i]);
+        if ((series[i] >= HrvAnalyzer::MIN_RR_INTERVAL) && (series[i] <= HrvAnalyzer::MAX_RR_INTERVAL)) {
+            accepted.push_back(series[i]);
+        }
+        for (unsigned w = 0; ok && (w < analyzer.getWindowCount()); w++) {
+            HrvAnalyzer::Result result;
+            HrvAnalyzer::Result expected;
+            double              meanRr, rmssd, sdnn, pnn50;
+            bool                have = analyzer.getResult(w, result);
+            ok = (have == expectedResult(accepted, analyzer.getWindowLength(w), expected, meanRr, rmssd, sdnn,
+                                         pnn50));
+            if (ok && have) {
+                ok = (result.beats == expected.beats) && near(result.meanRr, meanRr) && near(result.rmssd, rmssd) &&
+                     near(result.sdnn, sdnn) && near(result.pnn50, pnn50);
+                compared++;
+            }
+            if (!ok) {
+                printf("  beat %lu, window %u of %u beats: %u beats, mean %u, rmssd %u, sdnn %u, pnn50 %u\n",
+                       (unsigned long)i, w, analyzer.getWindowLength(w), result.beats, result.meanRr,
+                       result.rmssd, result.sdnn, result.pnn50);
+            }
+        }
+    }
+    printf("%-24s %6lu beats, %7u results\n", name, (unsigned long)series.size(), compared);
+    CHECK(ok);
+    return compared;
+}
+
+/**
+ * A resting rhythm around 'rrInterval', with breathing-rate variability,
+ * some noise and, every so often, a missed beat or one out of range.
+ */
+static void restingRhythm(Series &series, unsigned count, uint16_t rrInterval)
+{
+    for (unsigned i = 0; i < count; i++) {
+        int swing = (int)(60 * sin(i * 0.4)) + ((rand() % 21) - 10);
+        int rr    = rrInterval + swing;
+        if ((i % 97) == 50) {
+            rr *= 2; /* a missed beat */
+        } else if ((i % 131) == 70) {
+            rr = 100; /* noise, not a beat */
+        }
+        series.push_back((uint16_t)rr);
+    }
+}
+
+static void testRollingWindows(void)
+{
+    static const uint16_t lengths[] = {8, 30, 256};
+    Series                series;
+    restingRhythm(series, 1000, 1000);
+    checkSeries("rolling windows", lengths, 3, series);
+}
+
+static void testWindowClamping(void)
+{
+    static const uint16_t lengths[] = {0, 1, 1000};
+    HrvAnalyzer           analyzer(lengths, 3);
+    CHECK(analyzer.getWindowLength(0) == HrvAnalyzer::MIN_WINDOW_BEATS);
+    CHECK(analyzer.getWindowLength(1) == HrvAnalyzer::MIN_WINDOW_BEATS);
+    CHECK(analyzer.getWindowLength(2) == HrvAnalyzer::MAX_WINDOW_BEATS);
+
+    Series series;
+    restingRhythm(series, 600, 800);
+    checkSeries("clamped windows", lengths, 3, series);
+}
+
+static void testTooManyWindows(void)
+{
+    static const uint16_t lengths[] = {4, 16, 64, 128};
+    HrvAnalyzer           analyzer(lengths, 4);
+    CHECK(analyzer.getWindowCount() == HrvAnalyzer::MAX_WINDOWS);
+    HrvAnalyzer::Result result;
+    CHECK(!analyzer.getResult(HrvAnalyzer::MAX_WINDOWS, result));
+}
+
+static void testReset(void)
+{
+    static const uint16_t lengths[] = {2, 10};
+    HrvAnalyzer           analyzer(lengths, 2);
+    Series                series;
+    restingRhythm(series, 40, 900);
+    for (size_t i = 0; i < series.size(); i++) {
+        analyzer.addBeat(series[i]);
+    }
+    analyzer.reset();
+
+    HrvAnalyzer::Result result;
+    CHECK(!analyzer.getResult(0, result));
+    analyzer.addBeat(900);
+    CHECK(!analyzer.getResult(1, result));
+    analyzer.addBeat(1000);
+    CHECK(analyzer.getResult(1, result) && (result.beats == 2)); /* nothing from before the reset */
+    printf("%-24s %6lu beats\n", "reset", (unsigned long)series.size() + 2);
+}
+
+int main(void)
+{
+    srand(1);
+    testRollingWindows();
+    testWindowClamping();
+    testTooManyWindows();
+    testReset();
+    if (failures != 0) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
+
+#endif /* #if HOST_SIMULATION */
@@ -0,0 +1,82 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "HrvService.h"
+#include "VendorUUID.h"
+
+HrvService::HrvService(BLEDevice &bleDevice, const HrvAnalyzer &hrvAnalyzer) :
+    ble(bleDevice),
+    analyzer(hrvAnalyzer),
+    resultChar(0),
+    requestPending(false)
+{
+    /* empty */
+}
+
+void HrvService::addService(GattArena &arena)
+{
+    resultChar = arena.addCharacteristic(HRV_RESULT_CHAR_UUID, arena.allocateValue(RESULT_SIZE), 1, RESULT_SIZE,
+                                         GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
+                                         GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+                                         GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    GattCharacteristic **chars = arena.allocateList(1);
+    chars[0] = resultChar;
+    ble.addService(*arena.addService(HRV_SERVICE_UUID, chars, 1));
+}
+
+static uint8_t *putUint16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value);
+    p[1] = (uint8_t)(value >> 8);
+    return p + 2;
+}
+
+void HrvService::poll(void)
+{
+    if (!requestPending) {
+        return;
+    }
+    requestPending = false;
+
+    uint8_t  value[RESULT_SIZE];
+    uint16_t length = sizeof(value);
+    if ((ble.readCharacteristicValue(resultChar->getHandle(), value, &length) != BLE_ERROR_NONE) || (length < 1)) {
+        return;
+    }
+    unsigned window = value[0];
+
+    HrvAnalyzer::Result result;
+    memset(&result, 0, sizeof(result));
+    uint8_t code = RESPONSE_RESULT;
+    if (window >= analyzer.getWindowCount()) {
+        code = RESPONSE_UNKNOWN_WINDOW;
+    } else if (!analyzer.getResult(window, result)) {
+        code = RESPONSE_NOT_ENOUGH_BEATS;
+    }
+
+    uint8_t *p = value;
+    *p++ = code;
+    *p++ = (uint8_t)window;
+    p    = putUint16(p, (code == RESPONSE_UNKNOWN_WINDOW) ? 0 : analyzer.getWindowLength(window));
+    p    = putUint16(p, result.beats);
+    p    = putUint16(p, result.meanRr);
+    p    = putUint16(p, result.rmssd);
+    p    = putUint16(p, result.sdnn);
+    p    = putUint16(p, result.pnn50);
+    ble.updateCharacteristicValue(resultChar->getHandle(), value, sizeof(value));
+}
@@ -0,0 +1,83 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HRV_SERVICE_H__
+#define __HRV_SERVICE_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "HrvAnalyzer.h"
+
+/**
+ * Vendor service that hands out heart rate variability statistics, so that
+ * a central no longer needs every RR-interval to work them out.
+ *
+ * The central writes [u8 window] to the results characteristic; the
+ * statistics of that HrvAnalyzer window are computed then, and only then,
+ * and become the characteristic's value, notified to a subscribed central
+ * and readable by any:
+ *
+ *   [code][u8 window][u16 window length, beats][u16 beats in the window]
+ *   [u16 mean RR-interval, ms][u16 RMSSD, 0.1ms][u16 SDNN, 0.1ms]
+ *   [u16 pNN50, 0.1%]
+ *
+ * little-endian. The code is RESPONSE_RESULT, or RESPONSE_NOT_ENOUGH_BEATS
+ * with the statistics zero, or RESPONSE_UNKNOWN_WINDOW past the last window
+ * (so a central can find out what the windows are by asking for each in
+ * turn).
+ *
+ * onDataWritten() may be called from the stack's callbacks; poll() runs in
+ * the main loop.
+ */
+class HrvService {
+public:
+    enum {
+        RESPONSE_RESULT           = 0x01,
+        RESPONSE_NOT_ENOUGH_BEATS = 0xE0,
+        RESPONSE_UNKNOWN_WINDOW   = 0xE1
+    };
+
+    static const unsigned RESULT_SIZE = 14;
+
+    static const unsigned GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(RESULT_SIZE);
+
+public:
+    HrvService(BLEDevice &ble, const HrvAnalyzer &analyzer);
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * GATT table.
+     */
+    void addService(GattArena &arena);
+
+    void onDataWritten(uint16_t charHandle) {
+        if ((resultChar != 0) && (charHandle == resultChar->getHandle())) {
+            requestPending = true;
+        }
+    }
+
+    void poll(void);
+
+private:
+    BLEDevice          &ble;
+    const HrvAnalyzer  &analyzer;
+
+    GattCharacteristic *resultChar;
+    volatile bool       requestPending;
+};
+
+#endif /* #ifndef __HRV_SERVICE_H__ */
@@ -0,0 +1,32 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __INDEX_WRAP_H__
+#define __INDEX_WRAP_H__
+
+/**
+ * 'index' modulo SIZE, for an index below 2 * SIZE, as in a ring that is
+ * never stepped by more than its size. A compare and subtract rather than a
+ * division: the Cortex-M0 has no divider, and SIZE needn't be a power of
+ * two.
+ */
+template <unsigned SIZE>
+inline unsigned wrapIndex(unsigned index)
+{
+    return (index >= SIZE) ? (index - SIZE) : index;
+}
+
+#endif /* #ifndef __INDEX_WRAP_H__ */
@@ -0,0 +1,160 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "LinkMonitor.h"
+
+/* The S110's TX power settings from -20dBm up, in dBm; the last is DEFAULT_TX_POWER. */
+static const int8_t txPowerTable[LinkMonitor::NUM_TX_POWER_LEVELS] = {-20, -16, -12, -8, -4, 0};
+
+static const unsigned TOP_LEVEL = LinkMonitor::NUM_TX_POWER_LEVELS - 1;
+
+LinkMonitor::LinkMonitor() :
+    rssiAverage(0),
+    rssiSamples(0),
+    awaiting(false),
+    queuedAt(0),
+    lateThresholdUs(0),
+    deliveries(0),
+    late(0),
+    quality(100),
+    windows(0),
+    level(TOP_LEVEL),
+    polledWindows(0),
+    lastChange(0),
+    holdUntil(0),
+    holding(false)
+{
+    setConnectionInterval(100); /* the longest any profile asks for, until told otherwise */
+}
+
+void LinkMonitor::onConnected(uint32_t now)
+{
+    rssiSamples   = 0;
+    awaiting      = false;
+    deliveries    = 0;
+    late          = 0;
+    quality       = 100;
+    polledWindows = windows;
+    level         = TOP_LEVEL; /* a new link starts at the power it was advertised with */
+    lastChange    = now;
+    holding       = false;
+}
+
+void LinkMonitor::onRssi(int8_t rssi)
+{
+    if (rssiSamples == 0) {
+        rssiAverage = (int16_t)(rssi * 8);
+    } else {
+        rssiAverage = (int16_t)(rssiAverage + ((rssi * 8 - rssiAverage) >> 3));
+    }
+    if (rssiSamples < 0xFF) {
+        rssiSamples++;
+    }
+}
+
+void LinkMonitor::onPacketQueued(uint32_t now)
+{
+    if (!awaiting) {
+        queuedAt = now;
+        awaiting = true; /* last, for onPacketsSent() */
+    }
+}
+
+void LinkMonitor::onPacketsSent(uint32_t now)
+{
+    if (!awaiting) {
+        return; /* not ours, or not the first completion after queueing */
+    }
+    awaiting = false;
+
+    deliveries++;
+    if ((now - queuedAt) > lateThresholdUs) {
+        late++;
+    }
+    if (deliveries >= WINDOW_DELIVERIES) {
+        quality    = (uint8_t)(100 - ((late * 100) / WINDOW_DELIVERIES)); /* a shift: WINDOW_DELIVERIES is 16 */
+        deliveries = 0;
+        late       = 0;
+        windows++;
+    }
+}
+
+int8_t LinkMonitor::getTxPower(void) const
+{
+    return txPowerTable[level];
+}
+
+/**
+ * The lowest level that still leaves TARGET_MARGIN_DB at the central,
+ * assuming both ends transmit at the same power and see the same path.
+ */
+unsigned LinkMonitor::targetLevel(void) const
+{
+    if (rssiSamples < MIN_RSSI_SAMPLES) {
+        return TOP_LEVEL;
+    }
+    int wanted = SENSITIVITY_DBM + TARGET_MARGIN_DB - (rssiAverage >> 3);
+    for (unsigned i = 0; i < TOP_LEVEL; i++) {
+        if (txPowerTable[i] >= wanted) {
+            return i;
+        }
+    }
+    return TOP_LEVEL;
+}
+
+bool LinkMonitor::poll(uint32_t now)
+{
+    if (holding && ((int32_t)(now - holdUntil) >= 0)) {
+        holding = false;
+    }
+
+    bool     newWindow = (windows != polledWindows);
+    polledWindows      = windows;
+    unsigned target    = targetLevel();
+    unsigned wanted    = level;
+    if (newWindow && (quality < GOOD_LINK_QUALITY)) {
+        /* Packet loss overrides whatever the RSSI says. */
+        wanted    = ((quality < POOR_LINK_QUALITY) || (level == TOP_LEVEL)) ? TOP_LEVEL : level + 1;
+        holding   = true;
+        holdUntil = now + HOLD_US;
+    } else if (target > level) {
+        wanted = target; /* the central moved away */
+    } else if ((target < level) && !holding && ((now - lastChange) >= STEP_DOWN_US)) {
+        wanted = level - 1;
+    }
+
+    if (wanted == level) {
+        return false;
+    }
+    level      = (uint8_t)wanted;
+    lastChange = now;
+    return true;
+}
+
+bool LinkMonitor::getNextPollTime(uint32_t now, uint32_t &when) const
+{
+    if (targetLevel() >= level) {
+        return false;
+    }
+    when = lastChange + STEP_DOWN_US;
+    if (holding && ((int32_t)(holdUntil - when) > 0)) {
+        when = holdUntil;
+    }
+    if ((int32_t)(when - now) < 0) {
+        when = now;
+    }
+    return true;
+}
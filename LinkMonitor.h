@@ -0,0 +1,133 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LINK_MONITOR_H__
+#define __LINK_MONITOR_H__
+
+#include <stdint.h>
+
+/**
+ * Watches one link and picks the radio TX power for it.
+ *
+ * Two things are tracked. The RSSI of the central's packets, smoothed,
+ * stands in for the path loss: with the central transmitting at about
+ * 0dBm, a strong signal means a short, symmetric path and a lot of margin
+ * that our own transmissions don't need. And the delivery of heart rate
+ * notifications: the S110 doesn't report retransmissions, but a packet
+ * that isn't acknowledged in the first connection event after it was
+ * queued is only completed one interval later, so a completion that comes
+ * late counts as a retransmission. The share of deliveries that were on
+ * time, over a window of them, is the link quality in percent that
+ * ConnectionParameterManager takes.
+ *
+ * TX power comes down one level at a time, slowly, while the RSSI says
+ * there is margin to spare and the link is clean. It goes back up a level
+ * at the end of any window with retransmissions in it, straight to the
+ * default if the link is poor, and then stays up for a while.
+ *
+ * onPacketsSent() is called from the stack's event interrupt;
+ * everything else from the main thread. Times are in microseconds from a
+ * free-running 32-bit clock.
+ */
+class LinkMonitor {
+public:
+    static const int8_t   DEFAULT_TX_POWER    = 0;        /* dBm; also what advertising uses */
+    static const unsigned NUM_TX_POWER_LEVELS = 6;        /* -20dBm to DEFAULT_TX_POWER, in the S110's steps */
+    static const unsigned WINDOW_DELIVERIES   = 16;       /* per link quality estimate */
+    static const uint8_t  GOOD_LINK_QUALITY   = 100;      /* percent; anything less raises the power */
+    static const uint8_t  POOR_LINK_QUALITY   = 50;       /* straight back to the default */
+    static const int8_t   TARGET_MARGIN_DB    = 30;       /* over sensitivity, for body shadowing and fades */
+    static const int8_t   SENSITIVITY_DBM     = -90;      /* worst of the centrals we care about */
+    static const unsigned MIN_RSSI_SAMPLES    = 8;        /* before trusting the average */
+    static const uint32_t STEP_DOWN_US        = 10000000; /* between reductions */
+    static const uint32_t HOLD_US             = 60000000; /* no reductions after retransmissions */
+
+public:
+    LinkMonitor();
+
+    void onConnected(uint32_t now);
+
+    /**
+     * In units of 1.25ms; the longest one the central may have chosen.
+     */
+    void setConnectionInterval(uint16_t interval) {
+        lateThresholdUs = (uint32_t)interval * (1250 + 625) + LATE_MARGIN_US;
+    }
+
+    void onRssi(int8_t rssi);
+
+    /**
+     * A heart rate notification was handed to the stack.
+     */
+    void onPacketQueued(uint32_t now);
+
+    /**
+     * The stack reported transmissions complete.
+     */
+    void onPacketsSent(uint32_t now);
+
+    /**
+     * Percent of recent deliveries without a retransmission.
+     */
+    uint8_t getLinkQuality(void) const {
+        return quality;
+    }
+
+    int8_t getTxPower(void) const;
+
+    /**
+     * A delivery window completed since the last poll().
+     */
+    bool hasNewWindow(void) const {
+        return windows != polledWindows;
+    }
+
+    /**
+     * Returns true if getTxPower() changed.
+     */
+    bool poll(uint32_t now);
+
+    /**
+     * When poll() might next reduce the power. Returns false if it won't
+     * without a new RSSI reading or delivery.
+     */
+    bool getNextPollTime(uint32_t now, uint32_t &when) const;
+
+private:
+    static const uint32_t LATE_MARGIN_US = 2000; /* completion event handling */
+
+    unsigned targetLevel(void) const;
+
+private:
+    volatile int16_t  rssiAverage; /* dBm, Q3 */
+    volatile uint8_t  rssiSamples;
+
+    volatile bool     awaiting;    /* a notification is queued and not completed yet */
+    uint32_t          queuedAt;
+    uint32_t          lateThresholdUs;
+    uint8_t           deliveries;  /* in the current window */
+    uint8_t           late;
+    volatile uint8_t  quality;
+    volatile uint8_t  windows;     /* completed, to spot a new one from the main thread */
+
+    uint8_t           level;       /* index into the TX power table */
+    uint8_t           polledWindows;
+    uint32_t          lastChange;
+    uint32_t          holdUntil;
+    bool              holding;
+};
+
+#endif /* #ifndef __LINK_MONITOR_H__ */
@@ -0,0 +1,106 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MEASUREMENT_FRAME_POOL_H__
+#define __MEASUREMENT_FRAME_POOL_H__
+
+#include <stdint.h>
+#include "IndexWrap.h"
+
+/**
+ * Fixed pool of characteristic value frames, handed from the code that
+ * fills them to the code that transmits them without being copied.
+ *
+ * A frame is owned by exactly one side at a time:
+ *
+ *   acquire()   free -> producer, which writes data[] and length
+ *   submit()    producer -> transmit queue (FIFO); no longer touched by
+ *               the producer
+ *   front()     oldest queued frame, for the transmitter to offer to the
+ *               stack; it stays queued if the stack refuses it
+ *   release()   front of the queue -> free, once the stack has taken it
+ *
+ * The SoftDevice has its own copy of a notification once
+ * updateCharacteristicValue() returns, so a frame may be released right
+ * after a successful update and never changes while the stack reads it.
+ * All calls must come from the main thread.
+ */
+template <unsigned FRAME_SIZE, unsigned FRAME_COUNT>
+class MeasurementFramePool {
+public:
+    struct Frame {
+        uint8_t data[FRAME_SIZE];
+        uint8_t length;
+    };
+
+public:
+    MeasurementFramePool() : freeMask((1 << FRAME_COUNT) - 1), queueHead(0), queued(0) {
+        /* The free list is a bitmask. */
+        typedef char poolTooLarge[(FRAME_COUNT <= 8) ? 1 : -1];
+        (void)sizeof(poolTooLarge);
+    }
+
+    /**
+     * Returns a free frame, or 0 if all of them are queued.
+     */
+    Frame *acquire(void) {
+        for (unsigned i = 0; i < FRAME_COUNT; i++) {
+            if (freeMask & (1 << i)) {
+                freeMask &= ~(1 << i);
+                frames[i].length = 0;
+                return &frames[i];
+            }
+        }
+        return 0;
+    }
+
+    void submit(Frame *frame) {
+        queue[wrapIndex<FRAME_COUNT>(queueHead + queued)] = (uint8_t)(frame - frames);
+        queued++;
+    }
+
+    Frame *front(void) {
+        return (queued > 0) ? &frames[queue[queueHead]] : 0;
+    }
+
+    void release(void) {
+        freeMask |= (1 << queue[queueHead]);
+        queueHead = (uint8_t)wrapIndex<FRAME_COUNT>(queueHead + 1);
+        queued--;
+    }
+
+    /**
+     * Drop everything queued, e.g. once nobody is subscribed any more.
+     */
+    void releaseAll(void) {
+        while (queued > 0) {
+            release();
+        }
+    }
+
+    unsigned getQueuedCount(void) const {
+        return queued;
+    }
+
+private:
+    Frame    frames[FRAME_COUNT];
+    uint8_t  queue[FRAME_COUNT];
+    uint8_t  freeMask;
+    uint8_t  queueHead;
+    uint8_t  queued;
+};
+
+#endif /* #ifndef __MEASUREMENT_FRAME_POOL_H__ */
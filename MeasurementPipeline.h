@@ -0,0 +1,312 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MEASUREMENT_PIPELINE_H__
+#define __MEASUREMENT_PIPELINE_H__
+
+#include <stdint.h>
+#include "SensorSample.h"
+#include "BeatDetector.h"
+#include "ContactDetector.h"
+#include "MotionCanceller.h"
+#include "EnergyExpenditure.h"
+#include "NotificationScheduler.h"
+#include "MeasurementFramePool.h"
+#include "Trace.h"
+
+/**
+ * Where encoded measurements go: the subscribed centrals on the target, a
+ * simulated link on the host.
+ */
+class MeasurementLink {
+public:
+    /**
+     * Somebody wants measurements; nothing is encoded otherwise.
+     */
+    virtual bool isSubscribed(void) = 0;
+
+    /**
+     * Hand a frame to the transport. Returns false if it can't take it now;
+     * the same frame is offered again on a later pass, after a transmission
+     * has completed, until it is accepted or discard() is called.
+     */
+    virtual bool send(const uint8_t *data, unsigned length) = 0;
+
+    /**
+     * The frame last offered has been dropped, e.g. because nobody is
+     * subscribed any more.
+     */
+    virtual void discard(void) = 0;
+};
+
+/**
+ * Everything the measurement path reports to the rest of the application.
+ * Called from the main thread.
+ */
+class MeasurementObserver {
+public:
+    virtual void onBeat(const BeatDetector::Beat &beat) = 0;
+    virtual void onContactChanged(bool worn) = 0;
+    virtual void onMeasurementSent(void) = 0;
+
+    /**
+     * A flush found every frame still queued, so no measurement was made
+     * for it; its RR-intervals wait in the encoder for the next one.
+     */
+    virtual void onMeasurementDropped(void) = 0;
+};
+
+/**
+ * The sample-to-notification path: contact detection, motion cancellation,
+ * beat detection, coalescing into Heart Rate Measurement frames and handing
+ * them to the link when the notification scheduler says so. It has no
+ * hardware dependencies; the clock is passed in as 'now' on every call, so
+ * the same code runs on the target and in the host simulation.
+ *
+ * All calls must come from the main thread.
+ */
+template <typename MEASUREMENT, unsigned FRAME_COUNT>
+class MeasurementPipeline {
+public:
+    typedef MeasurementFramePool<MEASUREMENT::MAX_PAYLOAD, FRAME_COUNT> FramePool;
+    typedef typename FramePool::Frame                                    Frame;
+
+    /* Energy expended rides along in one measurement out of this many, as the Heart Rate Service suggests. */
+    static const unsigned ENERGY_EXPENDED_PERIOD = 10;
+
+public:
+    MeasurementPipeline(MEASUREMENT           &encoderIn,
+                        EnergyExpenditure     &energyIn,
+                        NotificationScheduler &schedulerIn,
+                        MeasurementLink       &linkIn,
+                        MeasurementObserver   &observerIn) :
+        encoder(encoderIn),
+        energy(energyIn),
+        scheduler(schedulerIn),
+        link(linkIn),
+        observer(observerIn),
+        tickValid(false),
+        expectedTick(0),
+        contactReportPending(false),
+        energyReportDue(false),
+        sinceEnergyExpended(0) {
+        /* empty */
+    }
+
+    /**
+     * Full-rate sampling is (re)starting; the filters have stale state and
+     * the next sample has no predecessor.
+     */
+    void restart(void) {
+        beatDetector.reset();
+#if MOTION_SENSOR_ENABLED
+        motionCanceller.reset();
+#endif
+        tickValid = false;
+    }
+
+    /**
+     * Sampling has stopped: whatever happens from now on goes unseen.
+     */
+    void resetContact(void) {
+        contactDetector.reset();
+    }
+
+    ContactDetector::State getContactState(void) const {
+        return contactDetector.getState();
+    }
+
+    /**
+     * Carry energy expended in the next measurement rather than waiting for
+     * its turn.
+     */
+    void requestEnergyReport(void) {
+        energyReportDue = true;
+    }
+
+    unsigned getQueuedCount(void) const {
+        return frames.getQueuedCount();
+    }
+
+    /**
+     * Low-rate samples: only watch for the sensor being put on or taken off.
+     * Stops at a change, since the rest of the batch is stale once the
+     * application switches the sampling mode.
+     */
+    void processContactSamples(const SensorSample *samples, unsigned count, uint32_t periodUs, uint32_t now) {
+        for (unsigned i = 0; i < count; i++) {
+            if (contactDetector.process(samples[i].ppg, periodUs)) {
+                contactChanged(now);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Full-rate samples, through to RR-intervals waiting in the encoder.
+     */
+    void processSamples(const SensorSample *samples, unsigned count, uint32_t now);
+
+    /**
+     * Encode the coalesced measurement straight into a frame and hand it to
+     * the link. Call once the scheduler's flush time has been reached.
+     */
+    void flush(uint32_t now);
+
+    /**
+     * Offer the queued frames to the link, oldest first, until it refuses
+     * one.
+     */
+    void send(void);
+
+private:
+    void contactChanged(uint32_t now);
+
+private:
+    MEASUREMENT           &encoder;
+    EnergyExpenditure     &energy;
+    NotificationScheduler &scheduler;
+    MeasurementLink       &link;
+    MeasurementObserver   &observer;
+
+    ContactDetector        contactDetector;
+#if MOTION_SENSOR_ENABLED
+    MotionCanceller        motionCanceller;
+#endif
+    BeatDetector           beatDetector;
+    FramePool              frames; /* encoded measurements waiting for the link */
+
+    bool                   tickValid; /* expectedTick follows the last sample seen */
+    uint16_t               expectedTick;
+    bool                   contactReportPending; /* the next measurement tells that the sensor came off */
+    bool                   energyReportDue;
+    unsigned               sinceEnergyExpended; /* measurements */
+};
+
+template <typename MEASUREMENT, unsigned FRAME_COUNT>
+void MeasurementPipeline<MEASUREMENT, FRAME_COUNT>::processSamples(const SensorSample *samples,
+                                                                   unsigned            count,
+                                                                   uint32_t            now)
+{
+    TRACE_STAGE_BEGIN(cycles);
+    bool contactWasChanged = false;
+    for (unsigned i = 0; i < count; i++) {
+        contactWasChanged |= contactDetector.process(samples[i].ppg, 1000000 / BeatDetector::SAMPLE_RATE_HZ);
+        if (tickValid && (samples[i].tick != expectedTick)) {
+            /* The ring overflowed; keep the beat timing honest. */
+            beatDetector.skip((uint16_t)(samples[i].tick - expectedTick));
+            TRACE_EVENT(TRACE_EVENT_RING_OVERFLOW, (uint16_t)(samples[i].tick - expectedTick));
+        }
+        tickValid    = true;
+        expectedTick = samples[i].tick + 1;
+
+#if MOTION_SENSOR_ENABLED
+        uint16_t ppg = motionCanceller.process(samples[i].ppg, samples[i].motion);
+#else
+        uint16_t ppg = samples[i].ppg;
+#endif
+        BeatDetector::Beat beat;
+        if (beatDetector.process(ppg, beat)) {
+            encoder.addRRInterval(beat.rrInterval);
+            if (MEASUREMENT::HAS_ENERGY_EXPENDED) {
+                energy.addBeat(beat.rrInterval, beat.heartRate);
+            }
+            observer.onBeat(beat);
+            if (link.isSubscribed()) {
+                bool nearlyFull = encoder.getPendingRRIntervals() >= (MEASUREMENT::RR_QUEUE_CAPACITY - 1);
+                scheduler.dataPending(now, nearlyFull);
+            }
+        }
+    }
+    TRACE_STAGE_END(TRACE_STAGE_BEAT_DETECTION, cycles);
+    if (contactWasChanged) {
+        contactChanged(now);
+    }
+}
+
+template <typename MEASUREMENT, unsigned FRAME_COUNT>
+void MeasurementPipeline<MEASUREMENT, FRAME_COUNT>::flush(uint32_t now)
+{
+    scheduler.flushed(now);
+
+    /* Nobody subscribed, or nobody wearing the sensor: don't even encode. */
+    uint16_t heartRate = beatDetector.getHeartRate();
+    bool     worn      = contactDetector.isInContact();
+    if ((((heartRate != 0) && worn) || contactReportPending) && link.isSubscribed()) {
+        /* With every frame still queued, the RR-intervals wait in the encoder for the next flush. */
+        Frame *frame = frames.acquire();
+        if (frame != 0) {
+            /* Every RR-interval collected since the last flush rides along in the same packet. */
+            TRACE_STAGE_BEGIN(encodeCycles);
+            encoder.setHeartRate(heartRate);
+            encoder.setSensorContact(worn);
+            if (MEASUREMENT::HAS_ENERGY_EXPENDED &&
+                (energyReportDue || (++sinceEnergyExpended >= ENERGY_EXPENDED_PERIOD))) {
+                encoder.setEnergyExpended(energy.getKiloJoules());
+                energyReportDue     = false;
+                sinceEnergyExpended = 0;
+            }
+            frame->length = (uint8_t)encoder.encode(frame->data, sizeof(frame->data));
+            TRACE_STAGE_END(TRACE_STAGE_ENCODER, encodeCycles);
+            frames.submit(frame);
+            contactReportPending = false;
+        } else {
+            observer.onMeasurementDropped();
+        }
+    }
+    send();
+}
+
+template <typename MEASUREMENT, unsigned FRAME_COUNT>
+void MeasurementPipeline<MEASUREMENT, FRAME_COUNT>::send(void)
+{
+    if (!link.isSubscribed()) {
+        if (frames.getQueuedCount() > 0) {
+            frames.releaseAll();
+            link.discard();
+        }
+        return;
+    }
+
+    Frame *frame;
+    while ((frame = frames.front()) != 0) {
+        scheduler.dataQueued();
+        if (!link.send(frame->data, frame->length)) {
+            return;
+        }
+        frames.release(); /* the stack has its own copy now */
+        observer.onMeasurementSent();
+    }
+}
+
+/**
+ * The sensor went on or off the skin.
+ */
+template <typename MEASUREMENT, unsigned FRAME_COUNT>
+void MeasurementPipeline<MEASUREMENT, FRAME_COUNT>::contactChanged(uint32_t now)
+{
+    bool worn = contactDetector.isInContact();
+    if (worn) {
+        contactReportPending = false;
+    } else if (link.isSubscribed()) {
+        /* One last measurement with the contact bit cleared, then silence. */
+        contactReportPending = true;
+        scheduler.dataPending(now, true);
+    }
+    observer.onContactChanged(worn);
+}
+
+#endif /* #ifndef __MEASUREMENT_PIPELINE_H__ */
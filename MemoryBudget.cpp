@@ -0,0 +1,59 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MemoryBudget.h"
+
+#if defined(__CC_ARM)
+/* Region names from the mbed nRF51822 scatter file. */
+extern char Load$$LR$$LR_IROM1$$Limit[];
+extern char Image$$RW_IRAM1$$ZI$$Limit[];
+
+uint32_t getImageFlashEnd(void)
+{
+    return (uint32_t)Load$$LR$$LR_IROM1$$Limit;
+}
+
+uint32_t getStaticRamEnd(void)
+{
+    return (uint32_t)Image$$RW_IRAM1$$ZI$$Limit;
+}
+#elif defined(__GNUC__) && defined(__arm__)
+/* Symbols from the mbed GCC_ARM linker script. */
+extern char __etext[];
+extern char __data_start__[];
+extern char __data_end__[];
+extern char __bss_end__[];
+
+uint32_t getImageFlashEnd(void)
+{
+    return (uint32_t)__etext + (uint32_t)(__data_end__ - __data_start__);
+}
+
+uint32_t getStaticRamEnd(void)
+{
+    return (uint32_t)__bss_end__;
+}
+#else
+uint32_t getImageFlashEnd(void)
+{
+    return 0;
+}
+
+uint32_t getStaticRamEnd(void)
+{
+    return 0;
+}
+#endif
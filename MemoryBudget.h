@@ -0,0 +1,50 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MEMORY_BUDGET_H__
+#define __MEMORY_BUDGET_H__
+
+#include <stdint.h>
+
+/*
+ * RAM on the 16KB nRF51822 parts. The S110 SoftDevice keeps the bottom 8KB;
+ * the application's statics, the mbed library's statics and heap, and the
+ * stack share the rest.
+ */
+#define RAM_START              0x20000000
+#define RAM_SIZE               (16 * 1024)
+#define RAM_SOFTDEVICE_SIZE    (8 * 1024)
+#define RAM_STACK_RESERVE      2048 /* main loop plus nested interrupt handlers */
+#define RAM_MBED_RESERVE       1536 /* Serial, the Ticker/Timeout event queue, heap allocations */
+#define RAM_STATIC_BUDGET      (RAM_SIZE - RAM_SOFTDEVICE_SIZE - RAM_STACK_RESERVE - RAM_MBED_RESERVE)
+
+/* Fails the build, naming 'name', if 'condition' doesn't hold. */
+#define MEMORY_BUDGET_ASSERT(condition, name) typedef char name[(condition) ? 1 : -1]
+
+struct MemoryBudgetEntry {
+    const char *name;
+    unsigned    bytes;
+};
+
+/**
+ * End of the firmware image in flash (code plus initialised data) and of
+ * the statics in RAM, as placed by the linker; 0 with a toolchain whose
+ * linker symbols aren't known here.
+ */
+uint32_t getImageFlashEnd(void);
+uint32_t getStaticRamEnd(void);
+
+#endif /* #ifndef __MEMORY_BUDGET_H__ */
@@ -0,0 +1,92 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MotionCanceller.h"
+
+/* ADC readings are left-justified; the ADC resolves 10 bits. */
+static const unsigned ADC_SHIFT = 6;
+
+/**
+ * floor(log2(x)) for x > 0, in five steps.
+ */
+static inline unsigned log2Floor(uint32_t x)
+{
+    unsigned n = 0;
+    if (x >= (1UL << 16)) { x >>= 16; n += 16; }
+    if (x >= (1UL << 8))  { x >>= 8;  n += 8; }
+    if (x >= (1UL << 4))  { x >>= 4;  n += 4; }
+    if (x >= (1UL << 2))  { x >>= 2;  n += 2; }
+    if (x >= (1UL << 1))  { n += 1; }
+    return n;
+}
+
+MotionCanceller::MotionCanceller()
+{
+    reset();
+}
+
+void MotionCanceller::reset(void)
+{
+    ppgLevel    = -1; /* primed from the first sample */
+    motionLevel = -1;
+    for (unsigned i = 0; i < TAPS; i++) {
+        weights[i]        = 0;
+        history[i]        = 0;
+        history[i + TAPS] = 0;
+    }
+    historyIndex = 0;
+    power        = 0;
+}
+
+uint16_t MotionCanceller::process(uint16_t ppg, uint16_t motion)
+{
+    /* DC removal, with the same slow time constant as the beat detector's high-pass. */
+    int32_t d = (int32_t)(ppg >> ADC_SHIFT) << 4;
+    int32_t m = (int32_t)(motion >> ADC_SHIFT) << 4;
+    if (ppgLevel < 0) {
+        ppgLevel    = d;
+        motionLevel = m;
+    }
+    ppgLevel    += (d - ppgLevel) >> 6;
+    motionLevel += (m - motionLevel) >> 6;
+    d = (d - ppgLevel) >> 4;
+    int16_t x = (int16_t)((m - motionLevel) >> 4);
+
+    /* Slide the reference window; history[historyIndex .. historyIndex + TAPS - 1] is newest first. */
+    historyIndex = (historyIndex - 1) & (TAPS - 1);
+    int16_t oldest = history[historyIndex];
+    power += ((int32_t)x * x) - ((int32_t)oldest * oldest);
+    history[historyIndex]        = x;
+    history[historyIndex + TAPS] = x;
+    const int16_t *window = &history[historyIndex];
+
+    /* Predict the artefact and take it out. */
+    int32_t y = 0;
+    for (unsigned i = 0; i < TAPS; i++) {
+        y += weights[i] * window[i];
+    }
+    int32_t e = d - (y >> 12);
+
+    /* w += mu * e * x / ||x||^2, the divisor rounded to a power of two; MIN_POWER keeps shift >= MU_SHIFT. */
+    unsigned shift = log2Floor((uint32_t)(power + MIN_POWER)) + MU_SHIFT - 12;
+    for (unsigned i = 0; i < TAPS; i++) {
+        int32_t w = weights[i] + ((e * window[i]) >> shift);
+        weights[i] = (w > MAX_WEIGHT) ? MAX_WEIGHT : ((w < -MAX_WEIGHT) ? -MAX_WEIGHT : w);
+    }
+
+    int32_t out = ((ppgLevel >> 4) + e) << ADC_SHIFT;
+    return (uint16_t)((out < 0) ? 0 : ((out > 0xFFFF) ? 0xFFFF : out));
+}
@@ -0,0 +1,67 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MOTION_CANCELLER_H__
+#define __MOTION_CANCELLER_H__
+
+#include <stdint.h>
+
+/**
+ * Adaptive noise canceller that removes motion artefacts from the PPG
+ * signal, using an accelerometer axis as the noise reference.
+ *
+ * Movement shakes the sensor against the skin and shows up in the optical
+ * signal as the arm swings, often close to the heart rate while running.
+ * The canceller predicts that part of the PPG from the last TAPS
+ * accelerometer samples with a normalised LMS filter and subtracts it; the
+ * pulse, which the accelerometer doesn't see, is what remains.
+ *
+ * Both inputs are 16-bit ADC readings with 10 significant bits and are
+ * worked on with their DC removed, in ADC counts. The weights are Q12. The
+ * NLMS step mu / ||x||^2 is rounded to a power of two, found by a short
+ * binary search, so that process() needs no division (the Cortex-M0 has no
+ * divider): 2 * TAPS multiply-accumulates and a handful of shifts per
+ * sample. The output is the cleaned PPG with its DC level restored, ready
+ * for the beat detector.
+ */
+class MotionCanceller {
+public:
+    static const unsigned TAPS       = 8;       /* 62.5ms of reference at 128Hz; must be a power of two */
+    static const unsigned MU_SHIFT   = 5;       /* step size mu = 1/32 */
+    static const int32_t  MIN_POWER  = 1 << 12; /* regularisation: no adaptation while the wrist is still */
+    static const int32_t  MAX_WEIGHT = 8 << 12; /* clamp, so that a transient can't make the filter blow up */
+
+public:
+    MotionCanceller();
+
+    void reset(void);
+
+    /**
+     * Feed one PPG sample and the accelerometer sample taken with it.
+     * Returns the PPG sample with the predicted motion artefact removed.
+     */
+    uint16_t process(uint16_t ppg, uint16_t motion);
+
+private:
+    int32_t  ppgLevel;     /* DC estimates, Q4 of ADC counts */
+    int32_t  motionLevel;
+    int32_t  weights[TAPS];
+    int16_t  history[2 * TAPS]; /* reference samples, stored twice so that the newest TAPS are contiguous */
+    unsigned historyIndex;
+    int32_t  power;        /* sum of the squares of the newest TAPS reference samples */
+};
+
+#endif /* #ifndef __MOTION_CANCELLER_H__ */
@@ -0,0 +1,119 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "NotificationScheduler.h"
+
+static const uint32_t CONNECTION_INTERVAL_UNIT_US = 1250;
+static const uint32_t MIN_INTERVAL_US             = 7500;    /* limits set by the core spec */
+static const uint32_t MAX_INTERVAL_US             = 4000000;
+
+NotificationScheduler::NotificationScheduler() :
+    intervalUs(MIN_INTERVAL_US),
+    holdTime(DEFAULT_HOLD_TIME_US),
+    anchor(0),
+    anchorValid(false),
+    lastFlush(0),
+    queued(false),
+    pending(false),
+    flushTime(0),
+    idleFlushTime(0)
+{
+    /* empty */
+}
+
+void NotificationScheduler::setConnectionInterval(uint16_t interval)
+{
+    uint32_t us = (uint32_t)interval * CONNECTION_INTERVAL_UNIT_US;
+    if ((us >= MIN_INTERVAL_US) && (us <= MAX_INTERVAL_US)) {
+        intervalUs = us;
+    }
+}
+
+void NotificationScheduler::onConnected(uint32_t now)
+{
+    /* The connection callback follows the first connection event closely enough to seed the anchor. */
+    anchor      = now;
+    anchorValid = true;
+    lastFlush   = now;
+    queued      = false;
+    pending     = false;
+}
+
+void NotificationScheduler::onDisconnected(void)
+{
+    anchorValid = false;
+    queued      = false;
+    pending     = false;
+}
+
+void NotificationScheduler::onTransmissionComplete(uint32_t now)
+{
+    if (anchorValid) {
+        /* Successive anchors are a whole number of intervals apart; use that to correct the estimate. */
+        uint32_t delta     = now - anchor;
+        uint32_t intervals = (delta + (intervalUs / 2)) / intervalUs;
+        if (intervals > 0) {
+            uint32_t measured = delta / intervals;
+            if ((measured >= MIN_INTERVAL_US) && (measured <= MAX_INTERVAL_US)) {
+                intervalUs = intervalUs - (intervalUs >> 2) + (measured >> 2);
+            }
+        }
+    }
+    anchor      = now;
+    anchorValid = true;
+    queued      = false;
+}
+
+void NotificationScheduler::dataPending(uint32_t now, bool urgent)
+{
+    uint32_t idle = alignToConnectionEvent(now);
+
+    /* Behind a queued measurement, hold to coalesce with what comes next. */
+    uint32_t earliest = urgent ? now : (lastFlush + holdTime);
+    if ((int32_t)(earliest - now) < 0) {
+        earliest = now;
+    }
+    uint32_t held = alignToConnectionEvent(earliest);
+
+    if (!pending || ((int32_t)(held - flushTime) < 0)) {
+        flushTime = held;
+    }
+    if (!pending || ((int32_t)(idle - idleFlushTime) < 0)) {
+        idleFlushTime = idle;
+    }
+    pending = true;
+}
+
+void NotificationScheduler::flushed(uint32_t now)
+{
+    lastFlush = now;
+    pending   = false;
+}
+
+uint32_t NotificationScheduler::alignToConnectionEvent(uint32_t earliest) const
+{
+    if (!anchorValid) {
+        return earliest; /* no timing information; flush as soon as allowed */
+    }
+
+    /* First predicted event that leaves GUARD_TIME_US to queue the data. */
+    uint32_t elapsed = (earliest + GUARD_TIME_US) - anchor;
+    if ((int32_t)elapsed < 0) {
+        elapsed = 0;
+    }
+    uint32_t nextEvent = anchor + ((elapsed / intervalUs) + 1) * intervalUs;
+    return nextEvent - GUARD_TIME_US;
+}
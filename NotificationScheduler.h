@@ -0,0 +1,119 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __NOTIFICATION_SCHEDULER_H__
+#define __NOTIFICATION_SCHEDULER_H__
+
+#include <stdint.h>
+
+/**
+ * Decides when pending measurements are handed to the stack.
+ *
+ * While the link is idle, new data is flushed just ahead of the next
+ * connection event, so that it goes out in that radio event instead of
+ * sitting in the SoftDevice queue for most of an interval. Only while an
+ * earlier measurement is still queued in the stack is new data held, for up
+ * to 'holdTime' after that flush, so that whatever arrives meanwhile is
+ * coalesced into one measurement rather than queued as several; once the
+ * earlier one has gone out the hold ends. The connection event timing is
+ * not exposed by BLE_API, so it
+ * is estimated: every TX-complete (onDataSent) re-anchors the estimate, and
+ * the spacing between successive anchors refines the connection interval,
+ * which is seeded from the requested connection parameters.
+ *
+ * All times are in microseconds from a free-running 32-bit clock; the
+ * arithmetic is wrap-safe.
+ */
+class NotificationScheduler {
+public:
+    static const uint32_t GUARD_TIME_US        = 2000;    /* queue this far ahead of the predicted event */
+    static const uint32_t DEFAULT_HOLD_TIME_US = 1000000; /* at most one measurement a second behind a queued one;
+                                                           * the profile expects roughly 1Hz updates */
+
+public:
+    NotificationScheduler();
+
+    /**
+     * Seed the connection interval estimate, in units of 1.25ms as used by
+     * Gap::ConnectionParams_t.
+     */
+    void setConnectionInterval(uint16_t interval);
+
+    void setHoldTime(uint32_t holdTimeUs) {
+        holdTime = holdTimeUs;
+    }
+
+    void onConnected(uint32_t now);
+    void onDisconnected(void);
+
+    /**
+     * Call from the onDataSent() callback: the stack has just completed a
+     * connection event in which our data went out. Ends any hold.
+     */
+    void onTransmissionComplete(uint32_t now);
+
+    /**
+     * New data is available. 'urgent' skips the coalescing hold (e.g. when
+     * the encoder's queue is about to overflow) but still aligns the flush
+     * to the next connection event.
+     */
+    void dataPending(uint32_t now, bool urgent = false);
+
+    /**
+     * Call just before handing a measurement to the stack; new data is held
+     * until the stack reports it sent.
+     */
+    void dataQueued(void) {
+        queued = true;
+    }
+
+    bool isPending(void) const {
+        return pending;
+    }
+
+    /**
+     * Absolute time at which the pending data should be flushed; only
+     * meaningful while isPending().
+     */
+    uint32_t getFlushTime(void) const {
+        return queued ? flushTime : idleFlushTime;
+    }
+
+    bool shouldFlush(uint32_t now) const {
+        return pending && ((int32_t)(now - getFlushTime()) >= 0);
+    }
+
+    /**
+     * Call once the pending data has been handed to the stack.
+     */
+    void flushed(uint32_t now);
+
+private:
+    uint32_t alignToConnectionEvent(uint32_t earliest) const;
+
+private:
+    uint32_t      intervalUs;
+    uint32_t      holdTime;
+    uint32_t      anchor;
+    bool          anchorValid;
+    uint32_t      lastFlush;
+    volatile bool queued;        /* a measurement is waiting in the stack; cleared from the stack's callback */
+    bool          pending;
+    uint32_t      flushTime;     /* while 'queued' */
+    uint32_t      idleFlushTime; /* once the link is idle; never after flushTime */
+};
+
+#endif /* #ifndef __NOTIFICATION_SCHEDULER_H__ */
@@ -0,0 +1,165 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "PeerCache.h"
+#include "Crc16.h"
+
+static const uint32_t ERASED_WORD = 0xFFFFFFFF;
+
+static inline const uint32_t *recordWords(unsigned index)
+{
+    return reinterpret_cast<const uint32_t *>(PEER_CACHE_START) + (index * PeerCache::RECORD_WORDS);
+}
+
+static bool samePeer(const ble_gap_addr_t &a, const ble_gap_addr_t &b)
+{
+    return (a.addr_type == b.addr_type) && (memcmp(a.addr, b.addr, BLE_GAP_ADDR_LEN) == 0);
+}
+
+PeerCache::PeerCache() :
+    count(0),
+    nextRecord(0),
+    dirty(false),
+    operationPending(false),
+    erasing(false),
+    rewriteIndex(0)
+{
+    /* empty */
+}
+
+void PeerCache::init(void)
+{
+    count      = 0;
+    nextRecord = 0;
+    while (nextRecord < RECORDS_PER_PAGE) {
+        const uint32_t *words = recordWords(nextRecord);
+        if (words[0] == ERASED_WORD) {
+            break;
+        }
+        nextRecord++;
+
+        /* A record cut short by a reset fails the CRC and is skipped. */
+        uint16_t crc = crc16(reinterpret_cast<const uint8_t *>(&words[1]), 2 * sizeof(uint32_t));
+        if ((words[0] != RECORD_MAGIC) || (words[3] != (0xFFFF0000 | crc))) {
+            continue;
+        }
+        ble_gap_addr_t peer;
+        memcpy(peer.addr, &words[1], BLE_GAP_ADDR_LEN);
+        peer.addr_type = (uint8_t)(words[2] >> 16);
+        moveToFront(peer);
+    }
+}
+
+void PeerCache::moveToFront(const ble_gap_addr_t &peer)
+{
+    unsigned i = 0;
+    while ((i < count) && !samePeer(peers[i], peer)) {
+        i++;
+    }
+    if (i == count) {
+        if (count < CAPACITY) {
+            count++;
+        } else {
+            i = CAPACITY - 1; /* the oldest one drops out */
+        }
+    }
+    for (; i > 0; i--) {
+        peers[i] = peers[i - 1];
+    }
+    peers[0] = peer;
+}
+
+void PeerCache::remember(const ble_gap_addr_t &peer)
+{
+    if ((count > 0) && samePeer(peers[0], peer)) {
+        return;
+    }
+    moveToFront(peer);
+    dirty = true;
+}
+
+bool PeerCache::getLastPeer(ble_gap_addr_t &peer) const
+{
+    if (count == 0) {
+        return false;
+    }
+    peer = peers[0];
+    return true;
+}
+
+void PeerCache::encode(const ble_gap_addr_t &peer)
+{
+    uint8_t bytes[2 * sizeof(uint32_t)];
+    memcpy(bytes, peer.addr, BLE_GAP_ADDR_LEN);
+    bytes[6] = peer.addr_type;
+    bytes[7] = 0xFF;
+
+    record[0] = RECORD_MAGIC;
+    memcpy(&record[1], bytes, sizeof(bytes));
+    record[3] = 0xFFFF0000 | crc16(bytes, sizeof(bytes));
+}
+
+void PeerCache::poll(uint32_t now)
+{
+    if (operationPending || flashStore.isBusy()) {
+        return;
+    }
+
+    if (rewriteIndex > 0) {
+        encode(peers[rewriteIndex - 1]);
+    } else if (dirty) {
+        if (nextRecord + count > RECORDS_PER_PAGE) {
+            /* No room for a record per peer afterwards; start the page over. */
+            if (flashStore.erasePage(PEER_CACHE_START, this, now)) {
+                operationPending = true;
+                erasing          = true;
+            }
+            return;
+        }
+        dirty = false; /* before encoding, so that a peer remembered meanwhile gets its own write */
+        encode(peers[0]);
+    } else {
+        return;
+    }
+
+    if (flashStore.write(PEER_CACHE_START + (nextRecord * RECORD_WORDS * sizeof(uint32_t)), record, RECORD_WORDS,
+                         this, now)) {
+        operationPending = true;
+    }
+}
+
+void PeerCache::flashOperationComplete(bool success)
+{
+    operationPending = false;
+    if (erasing) {
+        erasing = false;
+        if (success) {
+            nextRecord   = 0;
+            rewriteIndex = count; /* the whole list, oldest first, so that replaying it keeps the order */
+            dirty        = false;
+        }
+        return;
+    }
+
+    /* A failed write still used up its slot; the next one goes after it. */
+    nextRecord++;
+    if (rewriteIndex > 0) {
+        rewriteIndex--;
+    } else if (!success) {
+        dirty = true;
+    }
+}
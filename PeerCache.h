@@ -0,0 +1,96 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __PEER_CACHE_H__
+#define __PEER_CACHE_H__
+
+#include <stdint.h>
+#include "ble_gap.h"
+#include "FlashLayout.h"
+#include "FlashStore.h"
+
+/**
+ * The last few centrals that connected, most recent first, kept in the peer
+ * cache page of internal flash so that they survive a reset. The first one
+ * is the target of directed advertising after a disconnection.
+ *
+ * The page is an append-only list of RECORD_WORDS-word records
+ *
+ *   word 0   RECORD_MAGIC
+ *   word 1   address bytes 0 .. 3
+ *   word 2   address bytes 4 .. 5, address type, 0xFF
+ *   word 3   0xFFFF0000 | CRC-16 of words 1 .. 2
+ *
+ * each naming the peer that became the most recent one; replaying them in
+ * order at boot rebuilds the list. A full page is erased and rewritten with
+ * just the current list. Reconnecting to the peer that is already first
+ * writes nothing.
+ *
+ * remember() may be called from the BLE event handler; poll() writes the
+ * list out from the main loop.
+ */
+class PeerCache : public FlashClient {
+public:
+    static const unsigned CAPACITY     = 4;
+    static const uint32_t RECORD_MAGIC = 0x52454550; /* "PEER" */
+
+    enum {
+        RECORD_WORDS      = 4,
+        RECORDS_PER_PAGE  = FLASH_PAGE_SIZE / (RECORD_WORDS * sizeof(uint32_t))
+    };
+
+public:
+    PeerCache();
+
+    /**
+     * Replay the records in flash. Call once at startup.
+     */
+    void init(void);
+
+    /**
+     * Make 'peer' the most recent central.
+     */
+    void remember(const ble_gap_addr_t &peer);
+
+    /**
+     * The most recent central, if there is one.
+     */
+    bool getLastPeer(ble_gap_addr_t &peer) const;
+
+    unsigned getCount(void) const {
+        return count;
+    }
+
+    void poll(uint32_t now);
+
+    virtual void flashOperationComplete(bool success);
+
+private:
+    void moveToFront(const ble_gap_addr_t &peer);
+    void encode(const ble_gap_addr_t &peer);
+
+private:
+    ble_gap_addr_t peers[CAPACITY];
+    unsigned       count;
+    unsigned       nextRecord;     /* index of the first erased record slot */
+    volatile bool  dirty;          /* peers[0] hasn't reached the flash yet */
+    bool           operationPending;
+    bool           erasing;
+    unsigned       rewriteIndex;   /* peers still to write back after an erase, oldest first */
+    uint32_t       record[RECORD_WORDS];
+};
+
+#endif /* #ifndef __PEER_CACHE_H__ */
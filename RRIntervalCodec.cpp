@@ -0,0 +1,201 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "RRIntervalCodec.h"
+
+static inline uint32_t zigZag(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unZigZag(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static unsigned writeVarint(uint32_t value, uint8_t *out)
+{
+    unsigned length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+RRIntervalEncoder::RRIntervalEncoder() : haveReference(false), lastRR(0), lastRate(0), runLength(0)
+{
+    /* empty */
+}
+
+unsigned RRIntervalEncoder::flush(uint8_t *out)
+{
+    if (runLength == 0) {
+        return 0;
+    }
+
+    /* A lone unchanged beat is a PAIR of zero deltas. */
+    out[0]    = (runLength < MIN_RUN) ? (uint8_t)TOKEN_PAIR : (uint8_t)(TOKEN_RUN | (runLength - MIN_RUN));
+    runLength = 0;
+    return 1;
+}
+
+unsigned RRIntervalEncoder::encodeSession(uint8_t *out)
+{
+    unsigned length = flush(out);
+    out[length++]   = TOKEN_SESSION;
+    haveReference   = false;
+    return length;
+}
+
+unsigned RRIntervalEncoder::encode(uint16_t rrInterval, uint16_t heartRate, uint8_t *out)
+{
+    int32_t rrDelta   = (int32_t)rrInterval - (int32_t)lastRR;
+    int32_t rateDelta = (int32_t)heartRate - (int32_t)lastRate;
+
+    if (haveReference && (rrDelta == 0) && (rateDelta == 0)) {
+        if (++runLength == MAX_RUN) {
+            return flush(out);
+        }
+        return 0;
+    }
+
+    unsigned length = flush(out);
+    if (!haveReference) {
+        out[length++] = TOKEN_ABSOLUTE;
+        length += writeVarint(rrInterval, &out[length]);
+        length += writeVarint(heartRate, &out[length]);
+    } else {
+        uint32_t steps = zigZag(rrDelta >> RR_QUANTUM_SHIFT);
+        uint32_t rate  = zigZag(rateDelta);
+        bool     exact = (rrDelta & (RR_QUANTUM - 1)) == 0;
+        if (exact && (steps < 8) && (rate < 8)) {
+            out[length++] = (uint8_t)(TOKEN_PAIR | (steps << 3) | rate);
+        } else if (exact && (steps < 64) && (rateDelta == 0)) {
+            out[length++] = (uint8_t)(TOKEN_RR | steps);
+        } else {
+            out[length++] = TOKEN_DELTA;
+            length += writeVarint(zigZag(rrDelta), &out[length]);
+            length += writeVarint(rate, &out[length]);
+        }
+    }
+
+    haveReference = true;
+    lastRR        = rrInterval;
+    lastRate      = heartRate;
+    return length;
+}
+
+RRIntervalDecoder::RRIntervalDecoder()
+{
+    reset();
+}
+
+void RRIntervalDecoder::reset(void)
+{
+    token         = 0;
+    field         = 0;
+    shift         = 0;
+    value         = 0;
+    fields[0]     = 0;
+    fields[1]     = 0;
+    haveReference = false;
+    sessionStart  = false;
+    error         = false;
+    rr            = 0;
+    rate          = 0;
+}
+
+/**
+ * Collect one varint byte of the current DELTA or ABSOLUTE token; returns
+ * true once both of its fields are in.
+ */
+bool RRIntervalDecoder::readVarint(uint8_t byte)
+{
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    shift += 7;
+    if ((byte & 0x80) && (shift < 32)) {
+        return false;
+    }
+
+    fields[field++] = value;
+    value = 0;
+    shift = 0;
+    return field == 2;
+}
+
+unsigned RRIntervalDecoder::decode(uint8_t byte)
+{
+    sessionStart = false;
+
+    if (token != 0) {
+        if (!readVarint(byte)) {
+            return 0;
+        }
+        if (token == RRIntervalEncoder::TOKEN_ABSOLUTE) {
+            rr   = (uint16_t)fields[0];
+            rate = (uint16_t)fields[1];
+        } else {
+            rr   = (uint16_t)(rr + unZigZag(fields[0]));
+            rate = (uint16_t)(rate + unZigZag(fields[1]));
+        }
+        token         = 0;
+        haveReference = true;
+        return 1;
+    }
+
+    switch (byte) {
+        case RRIntervalEncoder::TOKEN_ABSOLUTE:
+        case RRIntervalEncoder::TOKEN_DELTA:
+            if ((byte == RRIntervalEncoder::TOKEN_DELTA) && !haveReference) {
+                error = true;
+            }
+            token = byte;
+            field = 0;
+            return 0;
+
+        case RRIntervalEncoder::TOKEN_SESSION:
+            sessionStart  = true;
+            haveReference = false;
+            return 0;
+
+        case RRIntervalEncoder::TOKEN_PADDING:
+            return 0;
+
+        default:
+            break;
+    }
+
+    if ((byte >= 0xC0) || !haveReference) {
+        error = true;
+        return 0;
+    }
+
+    switch (byte & 0xC0) {
+        case RRIntervalEncoder::TOKEN_PAIR:
+            rr   = (uint16_t)(rr + (unZigZag((byte >> 3) & 0x07) * (int32_t)RRIntervalEncoder::RR_QUANTUM));
+            rate = (uint16_t)(rate + unZigZag(byte & 0x07));
+            return 1;
+
+        case RRIntervalEncoder::TOKEN_RUN:
+            return (byte & 0x3F) + RRIntervalEncoder::MIN_RUN;
+
+        default: /* TOKEN_RR */
+            rr = (uint16_t)(rr + (unZigZag(byte & 0x3F) * (int32_t)RRIntervalEncoder::RR_QUANTUM));
+            return 1;
+    }
+}
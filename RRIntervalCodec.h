@@ -0,0 +1,161 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RR_INTERVAL_CODEC_H__
+#define __RR_INTERVAL_CODEC_H__
+
+#include <stdint.h>
+
+/**
+ * Compact byte stream for a sequence of beats, each an RR-interval (1/1024
+ * second) and a heart rate (BPM). Every beat is coded relative to the one
+ * before it, picking the shortest of these tokens:
+ *
+ *   00rrrbbb   PAIR:    rr and bpm deltas of -4..3 each; rr in steps of
+ *                       RR_QUANTUM
+ *   01nnnnnn   RUN:     n + 2 beats identical to the previous one
+ *   10rrrrrr   RR:      rr delta of -32..31 steps, bpm unchanged
+ *   11110000   DELTA:   followed by the rr and bpm deltas as varints
+ *   11110001   ABSOLUTE: followed by rr and bpm as varints; resets the
+ *                       reference, and always codes the first beat
+ *   11110010   SESSION: start of a new session; the next beat is absolute
+ *   11110011   PADDING: ignored
+ *
+ * Deltas are zig-zag mapped (0, -1, 1, -2, ...) to small unsigned numbers
+ * and the small fields hold them directly. Varints are little-endian base
+ * 128, the top bit of each byte marking that another follows. Tokens
+ * 0xC0 - 0xEF and 0xF4 - 0xFF are reserved.
+ *
+ * The short forms count RR deltas in RR_QUANTUM: the beat detector measures
+ * whole samples at 128Hz, so its RR-intervals are all multiples of 8/1024
+ * seconds. Any other input still codes losslessly, through DELTA. A
+ * resting heart rhythm typically averages about a byte per beat, against
+ * four for the raw uint16 pair.
+ *
+ * Neither side allocates; both work a beat (or a byte) at a time.
+ */
+class RRIntervalEncoder {
+public:
+    enum {
+        TOKEN_PAIR     = 0x00,
+        TOKEN_RUN      = 0x40,
+        TOKEN_RR       = 0x80,
+        TOKEN_DELTA    = 0xF0,
+        TOKEN_ABSOLUTE = 0xF1,
+        TOKEN_SESSION  = 0xF2,
+        TOKEN_PADDING  = 0xF3
+    };
+
+    static const unsigned RR_QUANTUM_SHIFT = 3;
+    static const unsigned RR_QUANTUM       = 1 << RR_QUANTUM_SHIFT;
+    static const unsigned MIN_RUN          = 2;
+    static const unsigned MAX_RUN          = MIN_RUN + 0x3F;
+
+    static const unsigned MAX_ENCODED_SIZE = 8; /* a pending RUN followed by the longest ABSOLUTE */
+
+public:
+    RRIntervalEncoder();
+
+    /**
+     * Forget the previous beat, so that the next one is coded as ABSOLUTE.
+     * Any pending run must have been flushed first.
+     */
+    void reset(void) {
+        haveReference = false;
+    }
+
+    /**
+     * Code one beat into 'out' (at least MAX_ENCODED_SIZE bytes) and return
+     * the number of bytes written. A beat identical to the previous one
+     * only extends the pending run and may produce nothing until the run
+     * ends or flush() is called.
+     */
+    unsigned encode(uint16_t rrInterval, uint16_t heartRate, uint8_t *out);
+
+    unsigned encodeSession(uint8_t *out);
+
+    /**
+     * Write out the pending run, if any. Returns the bytes written.
+     */
+    unsigned flush(uint8_t *out);
+
+    /**
+     * How many bytes flush() would write now.
+     */
+    unsigned getPendingSize(void) const {
+        return (runLength > 0) ? 1 : 0;
+    }
+
+private:
+    bool     haveReference;
+    uint16_t lastRR;
+    uint16_t lastRate;
+    unsigned runLength;
+};
+
+class RRIntervalDecoder {
+public:
+    RRIntervalDecoder();
+
+    void reset(void);
+
+    /**
+     * Feed the next byte of the stream. Returns the number of beats it
+     * completes; they all carry getRRInterval() and getHeartRate(), since
+     * only a run of unchanged beats completes more than one.
+     */
+    unsigned decode(uint8_t byte);
+
+    uint16_t getRRInterval(void) const {
+        return rr;
+    }
+
+    uint16_t getHeartRate(void) const {
+        return rate;
+    }
+
+    /**
+     * The last byte fed was a SESSION token.
+     */
+    bool isSessionStart(void) const {
+        return sessionStart;
+    }
+
+    /**
+     * A reserved token, or a delta before any ABSOLUTE, was seen. Cleared
+     * by reset().
+     */
+    bool hasError(void) const {
+        return error;
+    }
+
+private:
+    bool readVarint(uint8_t byte);
+
+private:
+    uint8_t  token;        /* DELTA or ABSOLUTE still collecting its varints, else 0 */
+    uint8_t  field;        /* which of the two varints is being collected */
+    uint8_t  shift;
+    uint32_t value;
+    uint32_t fields[2];
+    bool     haveReference;
+    bool     sessionStart;
+    bool     error;
+    uint16_t rr;
+    uint16_t rate;
+};
+
+#endif /* #ifndef __RR_INTERVAL_CODEC_H__ */
@@ -0,0 +1,347 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host-native round-trip test of RRIntervalCodec: synthetic RR series are
+ * encoded a beat at a time, as SessionLog does, decoded again, and the
+ * result compared beat for beat with the input. Encoded sizes are checked
+ * where the token choice is fixed, and no single encode() may write more
+ * than MAX_ENCODED_SIZE bytes.
+ *
+ * The firmware build compiles this file to nothing. To build and run it on
+ * a PC:
+ *
+ *   g++ -O2 -DHOST_SIMULATION -o rrcodectest RRIntervalCodecTest.cpp RRIntervalCodec.cpp
+ *   ./rrcodectest
+ *
+ * It prints one line per case and exits non-zero if any check failed.
+ */
+#if HOST_SIMULATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "RRIntervalCodec.h"
+
+struct Beat {
+    uint16_t rrInterval;
+    uint16_t heartRate;
+};
+
+typedef std::vector<Beat> Series;
+
+static unsigned failures = 0;
+
+#define CHECK(condition)                                                       \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            printf("  FAILED %s:%d: %s\n", __FILE__, __LINE__, #condition);    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+static const uint8_t GUARD_BYTE = 0xA5;
+
+/*
+ * Encode 'series' into 'stream', with SESSION tokens before the beats
+ * whose index is in 'sessions' (sorted), and a final flush. Every call's
+ * output goes to a MAX_ENCODED_SIZE buffer followed by guard bytes.
+ */
+static void encodeSeries(const Series &series, const std::vector<size_t> &sessions,
+                         std::vector<uint8_t> &stream)
+{
+    RRIntervalEncoder encoder;
+    uint8_t           out[RRIntervalEncoder::MAX_ENCODED_SIZE + 4];
+    size_t            nextSession = 0;
+    unsigned          longest     = 0;
+
+    stream.clear();
+    for (size_t i = 0; i <= series.size(); i++) {
+        memset(out, GUARD_BYTE, sizeof(out));
+        unsigned length;
+        while ((nextSession < sessions.size()) && (sessions[nextSession] == i)) {
+            nextSession++;
+            length = encoder.encodeSession(out);
+            CHECK(length <= RRIntervalEncoder::MAX_ENCODED_SIZE);
+            stream.insert(stream.end(), out, out + length);
+            memset(out, GUARD_BYTE, sizeof(out));
+        }
+        if (i < series.size()) {
+            length = encoder.encode(series[i].rrInterval, series[i].heartRate, out);
+        } else {
+            length = encoder.flush(out);
+        }
+        CHECK(length <= RRIntervalEncoder::MAX_ENCODED_SIZE);
+        for (unsigned k = RRIntervalEncoder::MAX_ENCODED_SIZE; k < sizeof(out); k++) {
+            CHECK(out[k] == GUARD_BYTE);
+        }
+        if (length > longest) {
+            longest = length;
+        }
+        stream.insert(stream.end(), out, out + length);
+    }
+    CHECK(encoder.getPendingSize() == 0);
+}
+
+/*
+ * Decode 'stream' into 'decoded'. Returns the number of SESSION tokens
+ * seen; 'sessionStarts' gets the index of the beat that followed each.
+ */
+static unsigned decodeStream(const std::vector<uint8_t> &stream, Series &decoded, std::vector<size_t> &sessionStarts,
+                             bool &error)
+{
+    RRIntervalDecoder decoder;
+    unsigned          markers = 0;
+
+    decoded.clear();
+    sessionStarts.clear();
+    for (size_t i = 0; i < stream.size(); i++) {
+        unsigned beats = decoder.decode(stream[i]);
+        if (decoder.isSessionStart()) {
+            markers++;
+            sessionStarts.push_back(decoded.size());
+        }
+        for (unsigned k = 0; k < beats; k++) {
+            Beat beat = {decoder.getRRInterval(), decoder.getHeartRate()};
+            decoded.push_back(beat);
+        }
+    }
+    error = decoder.hasError();
+    return markers;
+}
+
+static bool sameSeries(const Series &a, const Series &b, size_t count)
+{
+    if ((a.size() < count) || (b.size() < count)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((a[i].rrInterval != b[i].rrInterval) || (a[i].heartRate != b[i].heartRate)) {
+            printf("  beat %lu: %u/%u decoded as %u/%u\n", (unsigned long)i, a[i].rrInterval, a[i].heartRate,
+                   b[i].rrInterval, b[i].heartRate);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Round-trip 'series'; 'expectedSize' is the exact encoded size, or 0 if
+ * it isn't fixed. Returns the encoded stream.
+ */
+static std::vector<uint8_t> roundTrip(const char *name, const Series &series, size_t expectedSize,
+                                      const std::vector<size_t> &sessions = std::vector<size_t>())
+{
+    std::vector<uint8_t> stream;
+    encodeSeries(series, sessions, stream);
+
+    Series              decoded;
+    std::vector<size_t> sessionStarts;
+    bool                error;
+    unsigned            markers = decodeStream(stream, decoded, sessionStarts, error);
+
+    printf("%-24s %6lu beats, %6lu bytes (%.2f per beat)\n", name, (unsigned long)series.size(),
+           (unsigned long)stream.size(), series.empty() ? 0.0 : (double)stream.size() / series.size());
+    CHECK(!error);
+    CHECK(decoded.size() == series.size());
+    CHECK(sameSeries(series, decoded, series.size()));
+    CHECK(markers == sessions.size());
+    CHECK(sessionStarts == sessions);
+    if (expectedSize != 0) {
+        CHECK(stream.size() == expectedSize);
+    }
+    return stream;
+}
+
+static void add(Series &series, uint16_t rrInterval, uint16_t heartRate, unsigned count = 1)
+{
+    Beat beat = {rrInterval, heartRate};
+    series.insert(series.end(), count, beat);
+}
+
+/* A resting rhythm as the beat detector reports it: whole samples at 128Hz. */
+static void restingRhythm(Series &series, unsigned count)
+{
+    unsigned samples = 110;
+    for (unsigned i = 0; i < count; i++) {
+        int step = (rand() % 5) - 2;
+        samples  = (unsigned)((int)samples + step);
+        if (samples < 60) {
+            samples = 60;
+        } else if (samples > 150) {
+            samples = 150;
+        }
+        uint16_t heartRate = (uint16_t)((60 * 128 + samples / 2) / samples);
+        add(series, (uint16_t)(samples * RRIntervalEncoder::RR_QUANTUM), heartRate);
+    }
+}
+
+static void testRestingRhythm(void)
+{
+    Series series;
+    restingRhythm(series, 20000);
+    std::vector<uint8_t> stream = roundTrip("resting rhythm", series, 0);
+    CHECK(stream.size() < (2 * series.size())); /* against four bytes raw */
+}
+
+/*
+ * Runs broken after each length around the RUN token's limits. The first
+ * beat is ABSOLUTE (1 + 2 + 1 bytes for 880ms at 70 BPM); a run of n
+ * unchanged beats after it is a PAIR when n is 1, else ceil(n / MAX_RUN)
+ * RUN tokens with a PAIR for a lone leftover beat; the breaking beat is a
+ * PAIR.
+ */
+static void testRunBreaks(void)
+{
+    static const unsigned lengths[] = {
+        1, 2, 3, RRIntervalEncoder::MAX_RUN - 1, RRIntervalEncoder::MAX_RUN, RRIntervalEncoder::MAX_RUN + 1,
+        RRIntervalEncoder::MAX_RUN + 2, 2 * RRIntervalEncoder::MAX_RUN, 500
+    };
+
+    for (unsigned i = 0; i < (sizeof(lengths) / sizeof(lengths[0])); i++) {
+        unsigned n = lengths[i];
+        Series   series;
+        add(series, 901, 70);
+        add(series, 901, 70, n);
+        add(series, 909, 70);
+
+        unsigned tokens = 0;
+        unsigned left   = n;
+        while (left >= RRIntervalEncoder::MAX_RUN) {
+            tokens++;
+            left -= RRIntervalEncoder::MAX_RUN;
+        }
+        tokens += (left > 0) ? 1 : 0;
+
+        char name[32];
+        snprintf(name, sizeof(name), "run of %u", n);
+        roundTrip(name, series, 4 + tokens + 1);
+    }
+}
+
+/*
+ * Jumps past every short form: off the RR_QUANTUM grid, past the RR
+ * token's range, and to the ends of both fields.
+ */
+static void testLargeJumps(void)
+{
+    Series series;
+    add(series, 800, 75);
+    add(series, 803, 75);   /* off the grid: DELTA */
+    add(series, 803 + 31 * RRIntervalEncoder::RR_QUANTUM, 75);
+    add(series, 803 + 31 * RRIntervalEncoder::RR_QUANTUM - 32 * RRIntervalEncoder::RR_QUANTUM, 75);
+    add(series, 2000, 75);  /* past RR */
+    add(series, 200, 75);
+    add(series, 65535, 0);
+    add(series, 0, 65535);
+    add(series, 65535, 65535, 3);
+    add(series, 0, 0);
+    add(series, 1024, 60);
+    add(series, 1024, 61);
+    add(series, 1024, 57);  /* a rate step past PAIR: DELTA */
+    roundTrip("large jumps", series, 0);
+
+    for (unsigned i = 0; i < 2000; i++) {
+        Series random;
+        for (unsigned k = 0; k < 8; k++) {
+            add(random, (uint16_t)rand(), (uint16_t)rand());
+        }
+        std::vector<uint8_t> stream;
+        encodeSeries(random, std::vector<size_t>(), stream);
+        Series              decoded;
+        std::vector<size_t> sessionStarts;
+        bool                error;
+        decodeStream(stream, decoded, sessionStarts, error);
+        if (error || !sameSeries(random, decoded, random.size()) || (decoded.size() != random.size())) {
+            CHECK(!"random series round trip");
+            break;
+        }
+    }
+}
+
+/*
+ * Sessions start with a SESSION token and an ABSOLUTE beat, including one
+ * in the middle of a pending run, and an empty one.
+ */
+static void testSessionMarkers(void)
+{
+    Series              series;
+    std::vector<size_t> sessions;
+
+    sessions.push_back(0);
+    restingRhythm(series, 100);
+    add(series, 900, 68, 10);
+    sessions.push_back(series.size()); /* flushes the run */
+    add(series, 900, 68, 10);
+    sessions.push_back(series.size());
+    sessions.push_back(series.size()); /* empty */
+    restingRhythm(series, 100);
+    roundTrip("session markers", series, 0, sessions);
+
+    /* SESSION, ABSOLUTE, the RUN of 9 that the next SESSION flushes, SESSION, ABSOLUTE, a lone PAIR. */
+    Series twoSessions;
+    add(twoSessions, 900, 68, 12);
+    std::vector<size_t> marks;
+    marks.push_back(0);
+    marks.push_back(10);
+    roundTrip("session sizes", twoSessions, 1 + 4 + 1 + 1 + 4 + 1, marks);
+}
+
+/*
+ * A stream cut off anywhere, as a page is when its writes stop, decodes to
+ * a prefix of the series and nothing else.
+ */
+static void testTruncation(void)
+{
+    Series series;
+    restingRhythm(series, 200);
+    add(series, 60000, 1);
+    add(series, 300, 200, 70);
+    add(series, 301, 200);
+    std::vector<uint8_t> stream;
+    encodeSeries(series, std::vector<size_t>(), stream);
+
+    bool ok = true;
+    for (size_t cut = 0; ok && (cut <= stream.size()); cut++) {
+        std::vector<uint8_t> prefix(stream.begin(), stream.begin() + cut);
+        Series               decoded;
+        std::vector<size_t>  sessionStarts;
+        bool                 error;
+        decodeStream(prefix, decoded, sessionStarts, error);
+        ok = !error && (decoded.size() <= series.size()) && sameSeries(series, decoded, decoded.size());
+    }
+    printf("%-24s %6lu cuts\n", "truncation", (unsigned long)stream.size() + 1);
+    CHECK(ok);
+}
+
+int main(void)
+{
+    srand(1);
+    testRestingRhythm();
+    testRunBreaks();
+    testLargeJumps();
+    testSessionMarkers();
+    testTruncation();
+    if (failures != 0) {
+        printf("%u checks failed\n", failures);
+        return 1;
+    }
+    printf("all passed\n");
+    return 0;
+}
+
+#endif /* #if HOST_SIMULATION */
@@ -0,0 +1,121 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "RawWaveformStream.h"
+#include "VendorUUID.h"
+
+static inline void put16(uint8_t *out, uint16_t value)
+{
+    out[0] = (uint8_t)(value);
+    out[1] = (uint8_t)(value >> 8);
+}
+
+static inline void put32(uint8_t *out, uint32_t value)
+{
+    put16(out, (uint16_t)value);
+    put16(out + 2, (uint16_t)(value >> 16));
+}
+
+RawWaveformStream::RawWaveformStream(BLEDevice &bleDevice) :
+    ble(bleDevice),
+    dataChar(0),
+    statusChar(0),
+    dataValue(0),
+    statusValue(0),
+    streaming(false),
+    credits(1),
+    maxCredits(1),
+    packetNumber(0),
+    buffer()
+{
+    memset(&counters, 0, sizeof(counters));
+}
+
+void RawWaveformStream::addService(GattArena &arena)
+{
+    dataValue   = arena.allocateValue(PACKET_SIZE);
+    dataChar    = arena.addCharacteristic(RAW_WAVEFORM_DATA_CHAR_UUID, dataValue, PACKET_SIZE, PACKET_SIZE,
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    statusValue = arena.allocateValue(STATUS_SIZE);
+    statusChar  = arena.addCharacteristic(RAW_WAVEFORM_STATUS_CHAR_UUID, statusValue, STATUS_SIZE, STATUS_SIZE,
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
+
+    GattCharacteristic **chars = arena.allocateList(2);
+    chars[0] = dataChar;
+    chars[1] = statusChar;
+    ble.addService(*arena.addService(RAW_WAVEFORM_SERVICE_UUID, chars, 2));
+}
+
+void RawWaveformStream::onDataSent(unsigned count)
+{
+    unsigned c = credits + count;
+    credits = (c > maxCredits) ? maxCredits : c;
+}
+
+void RawWaveformStream::push(const SensorSample *samples, unsigned count)
+{
+    if (!streaming) {
+        buffer.flush();
+        return;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        buffer.push(samples[i]);
+    }
+}
+
+void RawWaveformStream::pump(void)
+{
+    SensorSample samples[SAMPLES_PER_PACKET];
+    while (streaming && (credits > 0)) {
+        unsigned available = buffer.peek(samples, SAMPLES_PER_PACKET);
+        if (available < SAMPLES_PER_PACKET) {
+            return; /* only full packets; the next batch is a few milliseconds away */
+        }
+
+        unsigned count = 1;
+        while ((count < available) && (samples[count].tick == (uint16_t)(samples[0].tick + count))) {
+            count++;
+        }
+
+        put16(&dataValue[0], packetNumber);
+        put16(&dataValue[2], samples[0].tick);
+        for (unsigned i = 0; i < count; i++) {
+            put16(&dataValue[PACKET_HEADER + (i * sizeof(uint16_t))], samples[i].ppg);
+        }
+        unsigned length = PACKET_HEADER + (count * sizeof(uint16_t));
+        if (ble.updateCharacteristicValue(dataChar->getHandle(), dataValue, length) != BLE_ERROR_NONE) {
+            credits = 0; /* out of sync with the stack; wait for the next completion */
+            return;
+        }
+
+        credits--;
+        buffer.consume(count);
+        packetNumber++;
+        counters.packetsSent++;
+        counters.samplesSent += count;
+    }
+}
+
+void RawWaveformStream::updateStatus(uint32_t acquisitionDropped)
+{
+    const Counters &c = getCounters();
+    put32(&statusValue[0], c.samplesSent);
+    put32(&statusValue[4], c.samplesDropped);
+    put32(&statusValue[8], acquisitionDropped);
+    put32(&statusValue[12], c.packetsSent);
+    ble.updateCharacteristicValue(statusChar->getHandle(), statusValue, STATUS_SIZE, true);
+}
@@ -0,0 +1,144 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RAW_WAVEFORM_STREAM_H__
+#define __RAW_WAVEFORM_STREAM_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "RingBuffer.h"
+#include "SensorAcquisition.h"
+
+/**
+ * Vendor service that exports the raw sensor waveform, for validation
+ * against reference equipment.
+ *
+ * Streaming runs while a central is subscribed to the data characteristic.
+ * Every notification carries
+ *
+ *   [u16 packet number][u16 tick of the first sample][up to 8 x u16 sample]
+ *
+ * little-endian, with consecutive ticks; a gap in the ticks starts a new
+ * packet, so a central can see exactly which samples were lost. Samples
+ * wait in a RAM ring between the acquisition ring and the radio; when the
+ * link can't keep up the newest are dropped and counted.
+ *
+ * Notifications are sent against TX credits: one per SoftDevice transmit
+ * buffer, spent on every notification and returned by onDataSent(). As
+ * many packets as there are credits are queued at once, so a connection
+ * event carries several of them. onDataSent() reports completions of all
+ * characteristics, so credits are capped at the buffer count and reset
+ * whenever the stack refuses a packet.
+ *
+ * The status characteristic (read) holds
+ *
+ *   [u32 samples sent][u32 samples dropped here][u32 samples dropped by
+ *    the acquisition ring][u32 packets sent]
+ *
+ * and is refreshed by updateStatus().
+ */
+class RawWaveformStream {
+public:
+    static const unsigned PACKET_SIZE        = 20;
+    static const unsigned PACKET_HEADER      = 4;
+    static const unsigned SAMPLES_PER_PACKET = (PACKET_SIZE - PACKET_HEADER) / sizeof(uint16_t);
+    static const unsigned STATUS_SIZE        = 16;
+    static const unsigned BUFFER_SAMPLES     = 128; /* one second at the full acquisition rate */
+    static const unsigned GATT_FOOTPRINT     = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(PACKET_SIZE) +
+                                               GATT_CHARACTERISTIC_FOOTPRINT(STATUS_SIZE);
+
+    struct Counters {
+        uint32_t samplesSent;
+        uint32_t samplesDropped;
+        uint32_t packetsSent;
+    };
+
+public:
+    RawWaveformStream(BLEDevice &ble);
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * GATT table.
+     */
+    void addService(GattArena &arena);
+
+    /**
+     * Number of transmit buffers the SoftDevice has for notifications.
+     */
+    void setTxBufferCount(unsigned count) {
+        maxCredits = count;
+        credits    = count;
+    }
+
+    bool isStreaming(void) const {
+        return streaming;
+    }
+
+    void onUpdatesEnabled(uint16_t charHandle) {
+        if ((dataChar != 0) && (charHandle == dataChar->getHandle())) {
+            streaming = true;
+        }
+    }
+
+    void onUpdatesDisabled(uint16_t charHandle) {
+        if ((dataChar != 0) && (charHandle == dataChar->getHandle())) {
+            streaming = false;
+        }
+    }
+
+    void onDisconnected(void) {
+        streaming = false;
+    }
+
+    void onDataSent(unsigned count);
+
+    /**
+     * Queue samples for the radio; call from the main loop with every batch
+     * drained from the acquisition ring.
+     */
+    void push(const SensorSample *samples, unsigned count);
+
+    /**
+     * Send as many packets as there are credits for.
+     */
+    void pump(void);
+
+    void updateStatus(uint32_t acquisitionDropped);
+
+    const Counters &getCounters(void) {
+        counters.samplesDropped = buffer.getOverflowCount();
+        return counters;
+    }
+
+private:
+    BLEDevice          &ble;
+
+    GattCharacteristic *dataChar;
+    GattCharacteristic *statusChar;
+    uint8_t            *dataValue;   /* packets and the status are assembled in the characteristics' own buffers */
+    uint8_t            *statusValue;
+
+    volatile bool       streaming;
+    volatile unsigned   credits;
+    unsigned            maxCredits;
+    uint16_t            packetNumber;
+    Counters            counters;
+
+    RingBuffer<SensorSample, BUFFER_SAMPLES> buffer;
+};
+
+#endif /* #ifndef __RAW_WAVEFORM_STREAM_H__ */
@@ -0,0 +1,136 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __RING_BUFFER_H__
+#define __RING_BUFFER_H__
+
+#include <stdint.h>
+
+/*
+ * Keeps the compiler from moving slot accesses past the index store that
+ * hands the slots over. The Cortex-M0 itself completes memory accesses in
+ * order; with ARMCC the intrinsic DMB is the only portable barrier.
+ */
+#if defined(__CC_ARM)
+#define RING_BUFFER_BARRIER() __dmb(0xF)
+#else
+#define RING_BUFFER_BARRIER() __asm volatile("" ::: "memory")
+#endif
+
+/**
+ * Lock-free single-producer/single-consumer ring buffer.
+ *
+ * The producer (typically an interrupt handler) only ever writes 'head' and
+ * the consumer (the main thread) only ever writes 'tail'. Both indices are
+ * free-running and wrap naturally; CAPACITY must be a power of two so that
+ * the masking below stays correct across the wrap. Aligned 32-bit loads and
+ * stores are atomic on the Cortex-M0, so no critical sections are needed.
+ */
+template <typename T, unsigned CAPACITY>
+class RingBuffer {
+public:
+    RingBuffer() : head(0), tail(0), overflows(0) {
+        /* Fails to compile if CAPACITY is not a power of two. */
+        typedef char capacityMustBePowerOfTwo[((CAPACITY & (CAPACITY - 1)) == 0) ? 1 : -1];
+        (void)sizeof(capacityMustBePowerOfTwo);
+    }
+
+    /**
+     * Producer side. Returns false (and counts an overflow) if the buffer is
+     * full; the newest element is the one dropped so that the consumer never
+     * sees a torn slot.
+     */
+    bool push(const T &element) {
+        uint32_t h = head;
+        if ((h - tail) >= CAPACITY) {
+            overflows++;
+            return false;
+        }
+        storage[h & (CAPACITY - 1)] = element;
+        RING_BUFFER_BARRIER();
+        head = h + 1; /* publish only after the slot has been written */
+        return true;
+    }
+
+    /**
+     * Consumer side. Copies up to 'maxElements' into 'dest' and returns the
+     * number copied.
+     */
+    unsigned pop(T *dest, unsigned maxElements) {
+        uint32_t t = tail;
+        unsigned available = head - t;
+        if (available > maxElements) {
+            available = maxElements;
+        }
+        for (unsigned i = 0; i < available; i++) {
+            dest[i] = storage[(t + i) & (CAPACITY - 1)];
+        }
+        RING_BUFFER_BARRIER();
+        tail = t + available; /* release the slots only after they have been read */
+        return available;
+    }
+
+    /**
+     * Consumer side. Like pop(), but leaves the elements queued until
+     * consume() is called; useful when the destination may refuse them.
+     */
+    unsigned peek(T *dest, unsigned maxElements) const {
+        uint32_t t = tail;
+        unsigned available = head - t;
+        if (available > maxElements) {
+            available = maxElements;
+        }
+        for (unsigned i = 0; i < available; i++) {
+            dest[i] = storage[(t + i) & (CAPACITY - 1)];
+        }
+        return available;
+    }
+
+    /**
+     * Consumer side; releases 'elements' previously returned by peek().
+     */
+    void consume(unsigned elements) {
+        RING_BUFFER_BARRIER();
+        tail = tail + elements;
+    }
+
+    unsigned count(void) const {
+        return head - tail;
+    }
+
+    bool isEmpty(void) const {
+        return head == tail;
+    }
+
+    /**
+     * Consumer side; discards everything currently queued.
+     */
+    void flush(void) {
+        tail = head;
+    }
+
+    uint32_t getOverflowCount(void) const {
+        return overflows;
+    }
+
+private:
+    T                 storage[CAPACITY];
+    volatile uint32_t head;      /* written by the producer only */
+    volatile uint32_t tail;      /* written by the consumer only */
+    volatile uint32_t overflows; /* written by the producer only */
+};
+
+#endif /* #ifndef __RING_BUFFER_H__ */
@@ -0,0 +1,83 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SensorAcquisition.h"
+#include "Trace.h"
+
+SensorAcquisition::SensorAcquisition(PinName ppgPin, PinName motionPin) : ppgInput(ppgPin),
+#if MOTION_SENSOR_ENABLED
+    motionInput(motionPin),
+#endif
+    sampleTicker(), ring(), tick(0), sampleSource(NULL), batchCallback(NULL), mode(MODE_OFF), batchSize(BATCH_SIZE)
+{
+    (void)motionPin;
+}
+
+void SensorAcquisition::warmUp(void)
+{
+    for (unsigned i = 0; i < WARM_UP_SAMPLES; i++) {
+        (void)ppgInput.read_u16();
+#if MOTION_SENSOR_ENABLED
+        (void)motionInput.read_u16();
+#endif
+    }
+}
+
+void SensorAcquisition::setMode(Mode newMode)
+{
+    if (newMode == mode) {
+        return;
+    }
+
+    sampleTicker.detach();
+    ring.flush(); /* safe: the producer is stopped */
+    mode = newMode;
+
+    switch (mode) {
+        case MODE_CONTACT_DETECT:
+            batchSize = CONTACT_BATCH_SIZE;
+            sampleTicker.attach_us(this, &SensorAcquisition::sampleISR, 1000000 / CONTACT_RATE_HZ);
+            break;
+        case MODE_FULL:
+            batchSize = BATCH_SIZE;
+            sampleTicker.attach_us(this, &SensorAcquisition::sampleISR, 1000000 / SAMPLE_RATE_HZ);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Executes in interrupt context; keep this to the conversions and a push.
+ */
+void SensorAcquisition::sampleISR(void)
+{
+    TRACE_STAGE_BEGIN(cycles);
+
+    SensorSample sample;
+    sample.ppg    = (sampleSource != NULL) ? sampleSource() : ppgInput.read_u16();
+#if MOTION_SENSOR_ENABLED
+    sample.motion = ((mode == MODE_FULL) && (sampleSource == NULL)) ? motionInput.read_u16() : SENSOR_MOTION_REST;
+#else
+    sample.motion = SENSOR_MOTION_REST;
+#endif
+    sample.tick   = tick++;
+    if (ring.push(sample) && (ring.count() == batchSize) && (batchCallback != NULL)) {
+        batchCallback();
+    }
+
+    TRACE_STAGE_END(TRACE_STAGE_SENSOR_ISR, cycles);
+}
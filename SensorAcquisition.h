@@ -0,0 +1,128 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SENSOR_ACQUISITION_H__
+#define __SENSOR_ACQUISITION_H__
+
+#include "mbed.h"
+#include "RingBuffer.h"
+#include "SensorSample.h"
+
+/**
+ * Samples the PPG front-end from a Ticker interrupt into a lock-free ring.
+ * The interrupt handler does the ADC conversions and nothing else; all signal
+ * processing happens in the main thread, which drains the ring in batches.
+ * The accelerometer is only converted at full rate; contact detection has no
+ * use for it.
+ */
+class SensorAcquisition {
+public:
+    /**
+     * Replaces the ADC as the sample source, e.g. with a synthetic waveform
+     * for benchmarking. Called from interrupt context.
+     */
+    typedef uint16_t (*SampleSource)(void);
+
+    /**
+     * Told that a full batch is waiting. Called from interrupt context.
+     */
+    typedef void (*BatchCallback)(void);
+
+    enum Mode {
+        MODE_OFF,
+        MODE_CONTACT_DETECT, /* CONTACT_RATE_HZ; just enough to tell whether the sensor is worn */
+        MODE_FULL            /* SAMPLE_RATE_HZ, for beat detection */
+    };
+
+    static const unsigned SAMPLE_RATE_HZ     = 128;
+    static const unsigned CONTACT_RATE_HZ    = 4;
+    static const unsigned RING_CAPACITY      = 64;  /* 500ms of headroom at SAMPLE_RATE_HZ. */
+    static const unsigned BATCH_SIZE         = 32;  /* a batch for the main loop every 250ms */
+    static const unsigned CONTACT_BATCH_SIZE = 1;   /* ... and every sample in contact detection, so that
+                                                     * contact is seen within one sampling period */
+    static const unsigned WARM_UP_SAMPLES    = 4;
+
+public:
+    SensorAcquisition(PinName ppgPin, PinName motionPin);
+
+    /**
+     * Run a few throwaway conversions so that the first real sample isn't
+     * skewed by the analog input still settling. Call once at startup.
+     */
+    void warmUp(void);
+
+    /**
+     * Switch sampling rate. Any samples still queued from the previous mode
+     * are discarded, so everything drained afterwards is at the new rate.
+     * Main thread only.
+     */
+    void setMode(Mode mode);
+
+    Mode getMode(void) const {
+        return mode;
+    }
+
+    void setSampleSource(SampleSource source) {
+        sampleSource = source;
+    }
+
+    /**
+     * 'callback' runs once each time the ring fills up to a batch, so that
+     * the main thread needn't poll batchReady().
+     */
+    void onBatchReady(BatchCallback callback) {
+        batchCallback = callback;
+    }
+
+    /**
+     * True once a full batch is waiting; the main thread should only drain
+     * the ring when this is set so that it wakes up once per batch rather
+     * than once per sample.
+     */
+    bool batchReady(void) const {
+        return ring.count() >= batchSize;
+    }
+
+    /**
+     * Copy up to 'maxSamples' queued samples into 'dest'. Must only be called
+     * from the main thread.
+     */
+    unsigned drain(SensorSample *dest, unsigned maxSamples) {
+        return ring.pop(dest, maxSamples);
+    }
+
+    uint32_t getDroppedSampleCount(void) const {
+        return ring.getOverflowCount();
+    }
+
+private:
+    void sampleISR(void);
+
+private:
+    AnalogIn                                   ppgInput;
+#if MOTION_SENSOR_ENABLED
+    AnalogIn                                   motionInput;
+#endif
+    Ticker                                     sampleTicker;
+    RingBuffer<SensorSample, RING_CAPACITY>    ring;
+    uint16_t                                   tick;
+    SampleSource                               sampleSource;
+    BatchCallback                              batchCallback;
+    Mode                                       mode;
+    unsigned                                   batchSize;
+};
+
+#endif /* #ifndef __SENSOR_ACQUISITION_H__ */
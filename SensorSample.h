@@ -0,0 +1,38 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SENSOR_SAMPLE_H__
+#define __SENSOR_SAMPLE_H__
+
+#include <stdint.h>
+
+#define MOTION_SENSOR_ENABLED 1 /* Set this if an analog accelerometer is fitted; one axis is sampled next to
+                                 * every PPG sample as the reference for motion artefact cancellation. */
+
+static const uint16_t SENSOR_MOTION_REST = 0x8000; /* mid-scale: the accelerometer's zero-g output */
+
+/**
+ * One raw reading from the optical (PPG) front-end, and from the
+ * accelerometer with it. 'tick' is a free-running sample counter maintained
+ * by the ISR; the consumer uses it to detect gaps caused by ring overflows.
+ */
+struct SensorSample {
+    uint16_t ppg;
+    uint16_t motion; /* SENSOR_MOTION_REST without an accelerometer */
+    uint16_t tick;
+};
+
+#endif /* #ifndef __SENSOR_SAMPLE_H__ */
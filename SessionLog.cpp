@@ -0,0 +1,361 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "SessionLog.h"
+#include "Crc16.h"
+
+static const unsigned PAGE_WORDS   = FLASH_PAGE_SIZE / sizeof(uint32_t);
+static const unsigned FOOTER_WORD  = PAGE_WORDS - 1;
+static const uint32_t ERASED_WORD  = 0xFFFFFFFF;
+static const unsigned CHUNK_WORDS  = SessionLog::CHUNK_SIZE / sizeof(uint32_t);
+
+static inline const uint32_t *pageWords(uint32_t address)
+{
+    return (const uint32_t *)address;
+}
+
+SessionLog::SessionLog() :
+    entries(),
+    writeFailures(0),
+    newestIndex(SESSION_LOG_PAGES - 1),
+    nextSequence(1),
+    pageState(PAGE_CLOSED),
+    sealRequested(false),
+    recoveryPending(false),
+    eraseIndex(SESSION_LOG_PAGES),
+    operationPending(false),
+    operation(OPERATION_CHUNK),
+    operationIndex(0),
+    operationLength(0),
+    pageOffset(0),
+    chunkFill(0),
+    footer(ERASED_WORD),
+    encoder()
+{
+    /* empty */
+}
+
+void SessionLog::init(void)
+{
+    bool found = false;
+    for (unsigned i = 0; i < SESSION_LOG_PAGES; i++) {
+        const uint32_t *page = pageWords(pageAddress(i));
+        if ((page[0] != PAGE_MAGIC) || (page[1] == ERASED_WORD)) {
+            continue;
+        }
+        if (!found || (page[1] >= nextSequence)) {
+            newestIndex  = i;
+            nextSequence = page[1] + 1;
+            found        = true;
+        }
+        if (page[FOOTER_WORD] == ERASED_WORD) {
+            recoveryPending = true; /* interrupted by a reset */
+        }
+    }
+}
+
+void SessionLog::beginSession(void)
+{
+    Entry entry;
+    entry.type       = ENTRY_SESSION;
+    entry.rrInterval = 0;
+    entry.heartRate  = 0;
+    entries.push(entry);
+}
+
+void SessionLog::logBeat(uint16_t rrInterval, uint16_t heartRate)
+{
+    Entry entry;
+    entry.type       = ENTRY_BEAT;
+    entry.rrInterval = rrInterval;
+    entry.heartRate  = heartRate;
+    entries.push(entry);
+}
+
+void SessionLog::eraseAll(void)
+{
+    eraseIndex      = 0;
+    pageState       = PAGE_CLOSED;
+    sealRequested   = false;
+    recoveryPending = false;
+    chunkFill       = 0;
+}
+
+bool SessionLog::isSealed(unsigned index, uint16_t &length)
+{
+    const uint32_t *page = pageWords(pageAddress(index));
+    if ((page[0] != PAGE_MAGIC) || (page[FOOTER_WORD] == ERASED_WORD)) {
+        return false;
+    }
+    length = (uint16_t)(page[FOOTER_WORD] & 0xFFFF);
+    return length <= PAGE_PAYLOAD_SIZE;
+}
+
+uint32_t SessionLog::footerFor(unsigned index, unsigned length)
+{
+    uint16_t crc = crc16((const uint8_t *)pageAddress(index), PAGE_HEADER_SIZE + length);
+    return ((uint32_t)crc << 16) | length;
+}
+
+bool SessionLog::findPage(uint32_t afterSequence, PageInfo &info) const
+{
+    while (true) {
+        bool     found = false;
+        unsigned index = 0;
+        uint16_t length;
+        for (unsigned i = 0; i < SESSION_LOG_PAGES; i++) {
+            uint32_t sequence = pageWords(pageAddress(i))[1];
+            if ((sequence > afterSequence) && (!found || (sequence < info.sequence)) && isSealed(i, length)) {
+                found         = true;
+                index         = i;
+                info.sequence = sequence;
+                info.length   = length;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+
+        /* Only the candidate is checksummed; that takes a few milliseconds a page. */
+        if (footerFor(index, info.length) == pageWords(pageAddress(index))[FOOTER_WORD]) {
+            info.records = (const uint8_t *)pageAddress(index) + PAGE_HEADER_SIZE;
+            return true;
+        }
+        afterSequence = info.sequence; /* corrupt; skip it */
+    }
+}
+
+unsigned SessionLog::getSealedPageCount(uint32_t &bytes) const
+{
+    unsigned pages = 0;
+    bytes = 0;
+    for (unsigned i = 0; i < SESSION_LOG_PAGES; i++) {
+        uint16_t length;
+        if (isSealed(i, length)) {
+            pages++;
+            bytes += length;
+        }
+    }
+    return pages;
+}
+
+unsigned SessionLog::encode(const Entry &entry, uint8_t *record)
+{
+    if (entry.type == ENTRY_SESSION) {
+        return encoder.encodeSession(record);
+    }
+    return encoder.encode(entry.rrInterval, entry.heartRate, record);
+}
+
+/**
+ * Move queued entries into the chunk until it is full. An entry whose
+ * tokens would cross the end of the page stays queued for the next one.
+ * Room is always left for the encoder's pending run, so that the page can
+ * be closed at any point.
+ */
+void SessionLog::encodeEntries(void)
+{
+    uint8_t *bytes = (uint8_t *)chunk;
+    Entry    entry;
+    while ((chunkFill < CHUNK_SIZE) && (entries.peek(&entry, 1) == 1)) {
+        uint8_t           record[RRIntervalEncoder::MAX_ENCODED_SIZE];
+        RRIntervalEncoder saved  = encoder;
+        unsigned          length = encode(entry, record);
+        if ((pageOffset + chunkFill + length + encoder.getPendingSize()) > PAGE_PAYLOAD_SIZE) {
+            encoder        = saved;
+            chunkFill     += encoder.flush(bytes + chunkFill);
+            sealRequested  = true;
+            return;
+        }
+        memcpy(bytes + chunkFill, record, length);
+        chunkFill += length;
+        entries.consume(1);
+    }
+}
+
+bool SessionLog::startWrite(Operation op, unsigned index, unsigned offset, const uint32_t *words, unsigned count,
+                            uint32_t now)
+{
+    if (!flashStore.write(pageAddress(index) + offset, words, count, this, now)) {
+        return false;
+    }
+    operationPending = true;
+    operation        = op;
+    operationIndex   = index;
+    operationLength  = count * sizeof(uint32_t);
+    return true;
+}
+
+/**
+ * Seal one page that has a header but no footer, other than the open one.
+ * Its length is taken from the last programmed word. Returns false once
+ * there are none left.
+ */
+bool SessionLog::sealUnsealedPage(uint32_t now)
+{
+    for (unsigned i = 0; i < SESSION_LOG_PAGES; i++) {
+        const uint32_t *page = pageWords(pageAddress(i));
+        if (((i == newestIndex) && (pageState == PAGE_OPEN)) ||
+            (page[0] != PAGE_MAGIC) || (page[1] == ERASED_WORD) || (page[FOOTER_WORD] != ERASED_WORD)) {
+            continue;
+        }
+
+        unsigned words = FOOTER_WORD;
+        while ((words > (PAGE_HEADER_SIZE / sizeof(uint32_t))) && (page[words - 1] == ERASED_WORD)) {
+            words--;
+        }
+        footer = footerFor(i, (words * sizeof(uint32_t)) - PAGE_HEADER_SIZE);
+        startWrite(OPERATION_RECOVERY, i, FOOTER_WORD * sizeof(uint32_t), &footer, 1, now);
+        return true;
+    }
+    return false;
+}
+
+void SessionLog::poll(uint32_t now)
+{
+    if (operationPending || flashStore.isBusy()) {
+        return;
+    }
+
+    if (eraseIndex < SESSION_LOG_PAGES) {
+        if (flashStore.erasePage(pageAddress(eraseIndex), this, now)) {
+            operationPending = true;
+            operation        = OPERATION_ERASE_ALL;
+        }
+        return;
+    }
+
+    if (recoveryPending) {
+        recoveryPending = sealUnsealedPage(now);
+        return;
+    }
+
+    unsigned next = (newestIndex + 1) % SESSION_LOG_PAGES;
+    switch (pageState) {
+        case PAGE_CLOSED:
+            if (!entries.isEmpty() && flashStore.erasePage(pageAddress(next), this, now)) {
+                operationPending = true;
+                operation        = OPERATION_ERASE;
+                operationIndex   = next;
+            }
+            break;
+
+        case PAGE_ERASED:
+            header[0] = PAGE_MAGIC;
+            header[1] = nextSequence;
+            startWrite(OPERATION_HEADER, next, 0, header, PAGE_HEADER_SIZE / sizeof(uint32_t), now);
+            break;
+
+        case PAGE_OPEN:
+            if (!sealRequested || ((pageOffset == 0) && (chunkFill == 0))) {
+                /* A seal that came while the page was opening takes the beats that opened it. */
+                encodeEntries();
+            }
+            if (sealRequested) {
+                chunkFill += encoder.flush((uint8_t *)chunk + chunkFill);
+            }
+            if (chunkFill >= CHUNK_SIZE) {
+                startWrite(OPERATION_CHUNK, newestIndex, PAGE_HEADER_SIZE + pageOffset, chunk, CHUNK_WORDS, now);
+            } else if (sealRequested && (chunkFill > 0)) {
+                /* The last few bytes go out padded to a whole word. */
+                unsigned words = (chunkFill + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+                memset((uint8_t *)chunk + chunkFill, RRIntervalEncoder::TOKEN_PADDING,
+                       (words * sizeof(uint32_t)) - chunkFill);
+                startWrite(OPERATION_CHUNK, newestIndex, PAGE_HEADER_SIZE + pageOffset, chunk, words, now);
+            } else if (sealRequested) {
+                footer = footerFor(newestIndex, pageOffset);
+                startWrite(OPERATION_FOOTER, newestIndex, FOOTER_WORD * sizeof(uint32_t), &footer, 1, now);
+            }
+            break;
+    }
+}
+
+void SessionLog::flashOperationComplete(bool success)
+{
+    operationPending = false;
+    if (!success) {
+        writeFailures++;
+    }
+
+    switch (operation) {
+        case OPERATION_ERASE_ALL:
+            if (success) {
+                eraseIndex++; /* otherwise try the same page again */
+            }
+            return;
+
+        case OPERATION_RECOVERY:
+            if (!success) {
+                recoveryPending = false; /* don't retry a failing page forever */
+            }
+            return;
+
+        default:
+            break;
+    }
+    if (eraseIndex < SESSION_LOG_PAGES) {
+        return; /* eraseAll() was called while this was in flight */
+    }
+
+    switch (operation) {
+        case OPERATION_ERASE:
+            pageState = success ? PAGE_ERASED : PAGE_CLOSED;
+            break;
+
+        case OPERATION_HEADER:
+            if (!success) {
+                pageState = PAGE_CLOSED; /* erase the slot again */
+                break;
+            }
+            pageState     = PAGE_OPEN;
+            newestIndex   = operationIndex;
+            nextSequence++;
+            pageOffset    = 0;
+            chunkFill     = 0;
+            encoder       = RRIntervalEncoder(); /* pages decode on their own */
+            break;
+
+        case OPERATION_CHUNK:
+            if (!success) {
+                /* Give up on this page; it gets sealed with what made it. */
+                pageState       = PAGE_CLOSED;
+                sealRequested   = false;
+                recoveryPending = true;
+                chunkFill       = 0;
+                break;
+            }
+            pageOffset += operationLength;
+            if (chunkFill > operationLength) {
+                chunkFill -= operationLength;
+                memmove(chunk, (const uint8_t *)chunk + operationLength, chunkFill);
+            } else {
+                chunkFill = 0;
+            }
+            break;
+
+        case OPERATION_FOOTER:
+            pageState     = PAGE_CLOSED;
+            sealRequested = false;
+            if (!success) {
+                recoveryPending = true;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,191 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SESSION_LOG_H__
+#define __SESSION_LOG_H__
+
+#include <stdint.h>
+#include "FlashLayout.h"
+#include "FlashStore.h"
+#include "RingBuffer.h"
+#include "RRIntervalCodec.h"
+
+/**
+ * Append-only log of beats in the session log pages of internal flash, kept
+ * while no central is listening so that a session can be synchronised later.
+ *
+ * The pages form a ring: each new page takes the slot after the newest one,
+ * overwriting the oldest data and spreading erases evenly across the pages.
+ * A page is laid out as
+ *
+ *   word 0                 PAGE_MAGIC
+ *   word 1                 sequence number, increasing from page to page
+ *   bytes 8 .. 1019        records
+ *   word 255 (footer)      (CRC-16 of bytes 0 .. 8+length-1 << 16) | length
+ *
+ * The footer stays erased until the page is sealed. A page left unsealed by
+ * a reset is sealed at the next boot with whatever had reached the flash.
+ *
+ * The records are an RRIntervalEncoder stream. Tokens never straddle pages
+ * and every page restarts the encoder, so that pages decode on their own;
+ * PADDING fills out the last word of a sealed page.
+ *
+ * Beats are queued in RAM by logBeat() and written out 16 bytes at a time
+ * from poll(), which must run in the main loop.
+ */
+class SessionLog : public FlashClient {
+public:
+    static const uint32_t PAGE_MAGIC = 0x474C5248; /* "HRLG" */
+
+    enum {
+        PAGE_HEADER_SIZE  = 8,
+        PAGE_FOOTER_SIZE  = 4,
+        PAGE_PAYLOAD_SIZE = FLASH_PAGE_SIZE - PAGE_HEADER_SIZE - PAGE_FOOTER_SIZE,
+        CHUNK_SIZE        = 16
+    };
+
+    struct PageInfo {
+        uint32_t       sequence;
+        const uint8_t *records;
+        uint16_t       length;
+    };
+
+public:
+    SessionLog();
+
+    /**
+     * Scan the flash for the newest page. Call once at startup.
+     */
+    void init(void);
+
+    void beginSession(void);
+    void logBeat(uint16_t rrInterval, uint16_t heartRate);
+
+    /**
+     * Close the current page so that everything logged so far becomes
+     * readable through findPage(). A page still being opened is sealed
+     * once it is, with the beats queued for it.
+     */
+    void seal(void) {
+        if ((pageState != PAGE_CLOSED) || !entries.isEmpty()) {
+            sealRequested = true;
+        }
+    }
+
+    /**
+     * Erase every page of the log. Beats logged meanwhile start a fresh page.
+     */
+    void eraseAll(void);
+
+    /**
+     * True from seal() until the page's footer is in flash.
+     */
+    bool isSealPending(void) const {
+        return sealRequested;
+    }
+
+    bool isErasing(void) const {
+        return eraseIndex < SESSION_LOG_PAGES;
+    }
+
+    /**
+     * Find the oldest sealed, intact page with a sequence number above
+     * 'afterSequence'. Pass 0 to start from the oldest page.
+     */
+    bool findPage(uint32_t afterSequence, PageInfo &info) const;
+
+    unsigned getSealedPageCount(uint32_t &bytes) const;
+
+    /**
+     * Beats dropped because the RAM queue was full.
+     */
+    uint32_t getDroppedCount(void) const {
+        return entries.getOverflowCount();
+    }
+
+    uint32_t getWriteFailureCount(void) const {
+        return writeFailures;
+    }
+
+    void poll(uint32_t now);
+
+    virtual void flashOperationComplete(bool success);
+
+private:
+    enum EntryType {
+        ENTRY_BEAT,
+        ENTRY_SESSION
+    };
+
+    struct Entry {
+        uint8_t  type;
+        uint16_t rrInterval;
+        uint16_t heartRate;
+    };
+
+    enum PageState {
+        PAGE_CLOSED,
+        PAGE_ERASED,
+        PAGE_OPEN
+    };
+
+    enum Operation {
+        OPERATION_ERASE_ALL,
+        OPERATION_ERASE,
+        OPERATION_HEADER,
+        OPERATION_CHUNK,
+        OPERATION_FOOTER,
+        OPERATION_RECOVERY
+    };
+
+    static uint32_t pageAddress(unsigned index) {
+        return SESSION_LOG_START + (index * FLASH_PAGE_SIZE);
+    }
+    static bool isSealed(unsigned index, uint16_t &length);
+    static uint32_t footerFor(unsigned index, unsigned length);
+
+    unsigned encode(const Entry &entry, uint8_t *record);
+    bool     sealUnsealedPage(uint32_t now);
+    void     encodeEntries(void);
+    bool     startWrite(Operation op, unsigned index, unsigned offset, const uint32_t *words, unsigned count,
+                        uint32_t now);
+
+private:
+    RingBuffer<Entry, 16> entries;
+    uint32_t              writeFailures;
+
+    unsigned  newestIndex;   /* slot of the newest page; the next page goes after it */
+    uint32_t  nextSequence;
+    PageState pageState;
+    bool      sealRequested;
+    bool      recoveryPending;
+    unsigned  eraseIndex;    /* next page for eraseAll(); SESSION_LOG_PAGES when not erasing */
+
+    bool      operationPending;
+    Operation operation;
+    unsigned  operationIndex;
+    unsigned  operationLength;
+
+    unsigned  pageOffset;    /* record bytes of the open page already in flash */
+    unsigned  chunkFill;
+    uint32_t  chunk[(CHUNK_SIZE + RRIntervalEncoder::MAX_ENCODED_SIZE) / sizeof(uint32_t)]; /* tokens spill past CHUNK_SIZE */
+    uint32_t  header[PAGE_HEADER_SIZE / sizeof(uint32_t)];
+    uint32_t  footer;
+
+    RRIntervalEncoder encoder;
+};
+
+#endif /* #ifndef __SESSION_LOG_H__ */
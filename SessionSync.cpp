@@ -0,0 +1,211 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "SessionSync.h"
+#include "VendorUUID.h"
+
+SessionSync::SessionSync(BLEDevice &bleDevice, SessionLog &sessionLog) :
+    ble(bleDevice),
+    log(sessionLog),
+    controlChar(0),
+    dataChar(0),
+    dataValue(0),
+    commandPending(false),
+    buffersFreed(false),
+    disconnected(false),
+    responsePending(false),
+    state(STATE_IDLE),
+    pageValid(false),
+    pageOffset(0),
+    packetNumber(0),
+    pagesSent(0),
+    bytesSent(0)
+{
+    /* empty */
+}
+
+void SessionSync::addService(GattArena &arena)
+{
+    controlChar = arena.addCharacteristic(SESSION_SYNC_CONTROL_CHAR_UUID, arena.allocateValue(RESPONSE_SIZE), 1,
+                                          RESPONSE_SIZE,
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_WRITE |
+                                          GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    dataValue = arena.allocateValue(PACKET_SIZE);
+    dataChar  = arena.addCharacteristic(SESSION_SYNC_DATA_CHAR_UUID, dataValue, PACKET_SIZE, PACKET_SIZE,
+                                        GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+
+    GattCharacteristic **chars = arena.allocateList(2);
+    chars[0] = controlChar;
+    chars[1] = dataChar;
+    ble.addService(*arena.addService(SESSION_SYNC_SERVICE_UUID, chars, 2));
+}
+
+bool SessionSync::sendResponse(void)
+{
+    responsePending = (ble.updateCharacteristicValue(controlChar->getHandle(), response, sizeof(response)) !=
+                       BLE_ERROR_NONE);
+    return !responsePending;
+}
+
+void SessionSync::respond(uint8_t code, unsigned pages, uint32_t bytes)
+{
+    response[0] = code;
+    response[1] = (uint8_t)pages;
+    response[2] = (uint8_t)(bytes);
+    response[3] = (uint8_t)(bytes >> 8);
+    response[4] = (uint8_t)(bytes >> 16);
+    response[5] = (uint8_t)(bytes >> 24);
+    sendResponse();
+}
+
+void SessionSync::handleCommand(void)
+{
+    uint8_t  command[RESPONSE_SIZE];
+    uint16_t length = sizeof(command);
+    if ((ble.readCharacteristicValue(controlChar->getHandle(), command, &length) != BLE_ERROR_NONE) || (length < 1)) {
+        return;
+    }
+
+    switch (command[0]) {
+        case COMMAND_START:
+            if (state != STATE_IDLE) {
+                respond(RESPONSE_BUSY, 0, 0);
+                break;
+            }
+            log.seal();
+            state = STATE_SEALING;
+            break;
+
+        case COMMAND_ERASE:
+            if (state == STATE_ERASING) {
+                respond(RESPONSE_BUSY, 0, 0);
+                break;
+            }
+            log.eraseAll();
+            state = STATE_ERASING;
+            break;
+
+        case COMMAND_ABORT:
+            if (state == STATE_STREAMING) {
+                state = STATE_IDLE;
+                respond(RESPONSE_ABORTED, pagesSent, bytesSent);
+            }
+            break;
+
+        default:
+            respond(RESPONSE_UNKNOWN_COMMAND, 0, 0);
+            break;
+    }
+}
+
+/**
+ * Queue packets until the stack refuses one; it is offered again once
+ * buffers have been freed.
+ */
+void SessionSync::pump(void)
+{
+    while (state == STATE_STREAMING) {
+        if (!pageValid || (pageOffset >= page.length)) {
+            uint32_t after = pageValid ? page.sequence : 0;
+            if (pageValid) {
+                pagesSent++;
+            }
+            pageValid = log.findPage(after, page);
+            if (!pageValid) {
+                state = STATE_IDLE;
+                respond(RESPONSE_DONE, pagesSent, bytesSent);
+                return;
+            }
+            pageOffset = 0;
+            continue;
+        }
+
+        unsigned chunk = page.length - pageOffset;
+        if (chunk > (PACKET_SIZE - PACKET_HEADER)) {
+            chunk = PACKET_SIZE - PACKET_HEADER;
+        }
+        dataValue[0] = (uint8_t)(packetNumber);
+        dataValue[1] = (uint8_t)(packetNumber >> 8);
+        memcpy(&dataValue[PACKET_HEADER], page.records + pageOffset, chunk);
+        if (ble.updateCharacteristicValue(dataChar->getHandle(), dataValue, PACKET_HEADER + chunk) != BLE_ERROR_NONE) {
+            return; /* out of buffers */
+        }
+        packetNumber++;
+        pageOffset += chunk;
+        bytesSent  += chunk;
+    }
+}
+
+void SessionSync::poll(void)
+{
+    if (disconnected) {
+        disconnected    = false;
+        commandPending  = false;
+        responsePending = false;
+        if (state != STATE_ERASING) {
+            state = STATE_IDLE; /* an erase runs to completion regardless */
+        }
+    }
+    if (commandPending) {
+        commandPending = false;
+        handleCommand();
+    }
+    if (responsePending) {
+        /* Nothing goes out ahead of it; a transmission has to free a buffer first. */
+        if (!buffersFreed) {
+            return;
+        }
+        buffersFreed = false;
+        if (!sendResponse()) {
+            return;
+        }
+        buffersFreed = true; /* there may be room for packets behind it */
+    }
+
+    switch (state) {
+        case STATE_SEALING:
+            if (!log.isSealPending()) {
+                uint32_t bytes;
+                unsigned pages = log.getSealedPageCount(bytes);
+                respond(RESPONSE_STARTED, pages, bytes);
+                state        = STATE_STREAMING;
+                pageValid    = false;
+                packetNumber = 0;
+                pagesSent    = 0;
+                bytesSent    = 0;
+                buffersFreed = true;
+            }
+            break;
+
+        case STATE_STREAMING:
+            if (buffersFreed) {
+                buffersFreed = false;
+                pump();
+            }
+            break;
+
+        case STATE_ERASING:
+            if (!log.isErasing()) {
+                state = STATE_IDLE;
+                respond(RESPONSE_ERASED, 0, 0);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
@@ -0,0 +1,141 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SESSION_SYNC_H__
+#define __SESSION_SYNC_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "GattArena.h"
+#include "SessionLog.h"
+
+/**
+ * Vendor service through which a central pulls the session log.
+ *
+ * The central subscribes to both characteristics and writes a command to
+ * the control point:
+ *
+ *   COMMAND_START  seal the page being written, then stream every sealed
+ *                  page, oldest first; answered with RESPONSE_STARTED and,
+ *                  once the last packet is queued, RESPONSE_DONE
+ *   COMMAND_ERASE  erase the log; answered with RESPONSE_ERASED
+ *   COMMAND_ABORT  stop streaming; answered with RESPONSE_ABORTED
+ *
+ * Responses are [code][u8 pages][u32 bytes], little-endian. The data
+ * characteristic carries [u16 packet number][up to 18 record bytes]; the
+ * records of consecutive pages simply follow one another (see SessionLog
+ * for their format). Packets go straight from memory-mapped flash and are
+ * queued until the stack runs out of buffers, so several leave per
+ * connection event; the pump resumes from onDataSent(). A response the
+ * stack refuses is held, ahead of any further packets, and retried from
+ * onDataSent() too; a newer response replaces one still held.
+ *
+ * onDataWritten(), onDataSent() and onDisconnected() may be called from the
+ * stack's callbacks; everything else happens in poll(), from the main loop.
+ */
+class SessionSync {
+public:
+    enum {
+        COMMAND_START = 0x01,
+        COMMAND_ERASE = 0x02,
+        COMMAND_ABORT = 0x03
+    };
+
+    enum {
+        RESPONSE_STARTED         = 0x01,
+        RESPONSE_ERASED          = 0x02,
+        RESPONSE_ABORTED         = 0x03,
+        RESPONSE_DONE            = 0x10,
+        RESPONSE_BUSY            = 0xE0,
+        RESPONSE_UNKNOWN_COMMAND = 0xE1
+    };
+
+    static const unsigned PACKET_SIZE   = 20; /* default ATT_MTU (23) minus the notification header */
+    static const unsigned PACKET_HEADER = 2;
+    static const unsigned RESPONSE_SIZE = 6;
+
+    static const unsigned GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(RESPONSE_SIZE) +
+                                           GATT_CHARACTERISTIC_FOOTPRINT(PACKET_SIZE);
+
+public:
+    SessionSync(BLEDevice &ble, SessionLog &log);
+
+    /**
+     * Build the service in 'arena' (GATT_FOOTPRINT bytes) and add it to the
+     * GATT table.
+     */
+    void addService(GattArena &arena);
+
+    /**
+     * True while a transfer or an erase is under way.
+     */
+    bool isActive(void) const {
+        return state != STATE_IDLE;
+    }
+
+    void onDataWritten(uint16_t charHandle) {
+        if ((controlChar != 0) && (charHandle == controlChar->getHandle())) {
+            commandPending = true;
+        }
+    }
+
+    void onDataSent(void) {
+        buffersFreed = true;
+    }
+
+    void onDisconnected(void) {
+        disconnected = true;
+    }
+
+    void poll(void);
+
+private:
+    enum State {
+        STATE_IDLE,
+        STATE_SEALING,
+        STATE_STREAMING,
+        STATE_ERASING
+    };
+
+    void handleCommand(void);
+    void pump(void);
+    void respond(uint8_t code, unsigned pages, uint32_t bytes);
+    bool sendResponse(void);
+
+private:
+    BLEDevice          &ble;
+    SessionLog         &log;
+
+    GattCharacteristic *controlChar;
+    GattCharacteristic *dataChar;
+    uint8_t            *dataValue; /* packets are assembled in the characteristic's own buffer */
+
+    volatile bool       commandPending;
+    volatile bool       buffersFreed;
+    volatile bool       disconnected;
+    uint8_t             response[RESPONSE_SIZE];
+    bool                responsePending;
+
+    State               state;
+    bool                pageValid;
+    SessionLog::PageInfo page;
+    unsigned            pageOffset;
+    uint16_t            packetNumber;
+    unsigned            pagesSent;
+    uint32_t            bytesSent;
+};
+
+#endif /* #ifndef __SESSION_SYNC_H__ */
@@ -0,0 +1,174 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "Sha256.h"
+
+static const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t rotateRight(uint32_t x, unsigned n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void Sha256::reset(void)
+{
+    state[0] = 0x6a09e667;
+    state[1] = 0xbb67ae85;
+    state[2] = 0x3c6ef372;
+    state[3] = 0xa54ff53a;
+    state[4] = 0x510e527f;
+    state[5] = 0x9b05688c;
+    state[6] = 0x1f83d9ab;
+    state[7] = 0x5be0cd19;
+    length   = 0;
+}
+
+void Sha256::compress(const uint8_t *block)
+{
+    uint32_t w[16];
+    for (unsigned i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | (uint32_t)block[4 * i + 3];
+    }
+
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+    for (unsigned i = 0; i < 64; i++) {
+        if (i >= 16) {
+            uint32_t w15 = w[(i + 1) & 15];
+            uint32_t w2  = w[(i + 14) & 15];
+            w[i & 15] += (rotateRight(w15, 7) ^ rotateRight(w15, 18) ^ (w15 >> 3)) + w[(i + 9) & 15] +
+                         (rotateRight(w2, 17) ^ rotateRight(w2, 19) ^ (w2 >> 10));
+        }
+        uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + ((e & f) ^ (~e & g)) +
+                      ROUND_CONSTANTS[i] + w[i & 15];
+        uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(const uint8_t *data, unsigned count)
+{
+    unsigned used = length & (BLOCK_SIZE - 1);
+    length += count;
+    if (used > 0) {
+        unsigned n = BLOCK_SIZE - used;
+        if (n > count) {
+            n = count;
+        }
+        memcpy(&buffer[used], data, n);
+        data  += n;
+        count -= n;
+        if ((used + n) < BLOCK_SIZE) {
+            return;
+        }
+        compress(buffer);
+    }
+    while (count >= BLOCK_SIZE) {
+        compress(data);
+        data  += BLOCK_SIZE;
+        count -= BLOCK_SIZE;
+    }
+    memcpy(buffer, data, count);
+}
+
+void Sha256::finish(uint8_t *digest)
+{
+    uint32_t bits = length << 3;
+    unsigned used = length & (BLOCK_SIZE - 1);
+    buffer[used++] = 0x80;
+    if (used > (BLOCK_SIZE - 8)) {
+        memset(&buffer[used], 0, BLOCK_SIZE - used);
+        compress(buffer);
+        used = 0;
+    }
+    memset(&buffer[used], 0, BLOCK_SIZE - used);
+    buffer[BLOCK_SIZE - 5] = (uint8_t)(length >> 29);
+    buffer[BLOCK_SIZE - 4] = (uint8_t)(bits >> 24);
+    buffer[BLOCK_SIZE - 3] = (uint8_t)(bits >> 16);
+    buffer[BLOCK_SIZE - 2] = (uint8_t)(bits >> 8);
+    buffer[BLOCK_SIZE - 1] = (uint8_t)(bits);
+    compress(buffer);
+
+    for (unsigned i = 0; i < 8; i++) {
+        digest[4 * i]     = (uint8_t)(state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)(state[i]);
+    }
+}
+
+/**
+ * Hash one block of the key XORed with 'pad'.
+ */
+void HmacSha256::padKey(Sha256 &hash, uint8_t pad)
+{
+    uint8_t block[Sha256::BLOCK_SIZE];
+    for (unsigned i = 0; i < Sha256::BLOCK_SIZE; i++) {
+        block[i] = (uint8_t)(((i < keyLength) ? key[i] : 0) ^ pad);
+    }
+    hash.update(block, sizeof(block));
+}
+
+void HmacSha256::start(const uint8_t *hmacKey, unsigned hmacKeyLength)
+{
+    key       = hmacKey;
+    keyLength = hmacKeyLength;
+    inner.reset();
+    padKey(inner, 0x36);
+}
+
+void HmacSha256::finish(uint8_t *tag)
+{
+    uint8_t innerDigest[Sha256::DIGEST_SIZE];
+    inner.finish(innerDigest);
+
+    inner.reset(); /* reused for the outer hash */
+    padKey(inner, 0x5C);
+    inner.update(innerDigest, sizeof(innerDigest));
+    inner.finish(tag);
+}
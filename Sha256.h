@@ -0,0 +1,79 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SHA256_H__
+#define __SHA256_H__
+
+#include <stdint.h>
+
+/**
+ * SHA-256 (FIPS 180-4), fed in pieces. The message schedule is kept to a
+ * rolling 16 words, so a block takes 64 bytes of stack rather than 256.
+ */
+class Sha256 {
+public:
+    static const unsigned BLOCK_SIZE  = 64;
+    static const unsigned DIGEST_SIZE = 32;
+
+public:
+    Sha256() {
+        reset();
+    }
+
+    void reset(void);
+    void update(const uint8_t *data, unsigned length);
+
+    /**
+     * Writes DIGEST_SIZE bytes; reset() before hashing anything else.
+     */
+    void finish(uint8_t *digest);
+
+private:
+    void compress(const uint8_t *block);
+
+private:
+    uint32_t state[8];
+    uint8_t  buffer[BLOCK_SIZE];
+    uint32_t length; /* bytes hashed so far; messages stay well below 4GB */
+};
+
+/**
+ * HMAC-SHA256 (RFC 2104) with a key of at most Sha256::BLOCK_SIZE bytes,
+ * which must outlive the computation.
+ */
+class HmacSha256 {
+public:
+    static const unsigned TAG_SIZE = Sha256::DIGEST_SIZE;
+
+public:
+    void start(const uint8_t *key, unsigned keyLength);
+
+    void update(const uint8_t *data, unsigned length) {
+        inner.update(data, length);
+    }
+
+    void finish(uint8_t *tag);
+
+private:
+    void padKey(Sha256 &hash, uint8_t pad);
+
+private:
+    Sha256         inner;
+    const uint8_t *key;
+    unsigned       keyLength;
+};
+
+#endif /* #ifndef __SHA256_H__ */
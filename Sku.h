@@ -0,0 +1,93 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SKU_H__
+#define __SKU_H__
+
+#include <stdint.h>
+#include "BLEDevice.h"
+#include "ble_hrs.h"
+#include "HeartRateProfile.h"
+
+/*
+ * The products built from this code base. Each one gets its own Heart Rate
+ * Service layout, notification policy, name, appearance, advertising
+ * intervals and debug features; everything a product doesn't use is left
+ * out of its image.
+ */
+#define SKU_FINGER_CLIP 1 /* optical sensor on a finger, with an accelerometer; the reference design */
+#define SKU_CHEST_STRAP 2 /* chest strap with energy expended for gym equipment */
+#define SKU_WRIST_BASIC 3 /* heart rate only, for the smallest image */
+#define SKU_DEVELOPMENT 4 /* the reference design with console output and tracing; never shipped */
+
+#define SKU SKU_FINGER_CLIP /* Set this to the product being built. */
+
+/*
+ * Debug features, a mask per product in SKU_FEATURES. They are preprocessor
+ * switches rather than template arguments because what they leave out
+ * includes globals, callbacks and the UART.
+ */
+#define SKU_FEATURE_CONSOLE_OUTPUT 0x01 /* debug messages on the console; costs code size and power */
+#define SKU_FEATURE_TRACE          0x02 /* binary trace events and per-stage cycle counters (see Trace.h) */
+
+#if (SKU == SKU_FINGER_CLIP) || (SKU == SKU_DEVELOPMENT)
+#define SKU_DEVICE_NAME "Nordic_HRM"
+#if SKU == SKU_DEVELOPMENT
+#define SKU_FEATURES (SKU_FEATURE_CONSOLE_OUTPUT | SKU_FEATURE_TRACE)
+#else
+#define SKU_FEATURES 0
+#endif
+struct Sku {
+    typedef HeartRateProfile<BLE_HRS_BODY_SENSOR_LOCATION_FINGER, 9,
+                             HRM_FEATURE_SENSOR_CONTACT | HRM_FEATURE_ENERGY_EXPENDED, 1000> Profile;
+
+    static const uint16_t APPEARANCE                = GapAdvertisingData::HEART_RATE_SENSOR_HEART_RATE_BELT;
+    static const uint16_t FAST_ADVERTISING_INTERVAL = 48;   /* 30ms, in units of 0.625ms */
+    static const uint16_t SLOW_ADVERTISING_INTERVAL = 1636; /* 1022.5ms, one of the intervals iOS recommends */
+};
+
+#elif SKU == SKU_CHEST_STRAP
+#define SKU_DEVICE_NAME "Nordic_HRM_Strap"
+#define SKU_FEATURES 0
+struct Sku {
+    typedef HeartRateProfile<BLE_HRS_BODY_SENSOR_LOCATION_CHEST, 8,
+                             HRM_FEATURE_SENSOR_CONTACT | HRM_FEATURE_ENERGY_EXPENDED, 1000> Profile;
+
+    static const uint16_t APPEARANCE                = GapAdvertisingData::HEART_RATE_SENSOR_HEART_RATE_BELT;
+    static const uint16_t FAST_ADVERTISING_INTERVAL = 48;
+    static const uint16_t SLOW_ADVERTISING_INTERVAL = 1636;
+};
+
+#elif SKU == SKU_WRIST_BASIC
+#define SKU_DEVICE_NAME "Nordic_HR"
+#define SKU_FEATURES 0
+struct Sku {
+    /* Without RR-intervals a measurement carries only the latest beat, so there is nothing to coalesce. */
+    typedef HeartRateProfile<BLE_HRS_BODY_SENSOR_LOCATION_WRIST, 0, 0, 0> Profile;
+
+    static const uint16_t APPEARANCE                = GapAdvertisingData::GENERIC_HEART_RATE_SENSOR;
+    static const uint16_t FAST_ADVERTISING_INTERVAL = 160;  /* 100ms; nobody is waiting on a reconnection */
+    static const uint16_t SLOW_ADVERTISING_INTERVAL = 2056; /* 1285ms, also on the iOS list */
+};
+
+#else
+#error "unknown SKU"
+#endif
+
+#define NEED_CONSOLE_OUTPUT ((SKU_FEATURES & SKU_FEATURE_CONSOLE_OUTPUT) != 0)
+#define TRACE_ENABLED       ((SKU_FEATURES & SKU_FEATURE_TRACE) != 0)
+
+#endif /* #ifndef __SKU_H__ */
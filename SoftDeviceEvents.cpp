@@ -0,0 +1,102 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "softdevice_handler.h"
+#include "SoftDeviceEvents.h"
+
+static SoftDeviceBleHandler    applicationBleHandler    = 0;
+static SoftDeviceSystemHandler applicationSystemHandler = 0;
+static ble_evt_handler_t       libraryBleHandler        = 0;
+static sys_evt_handler_t       librarySystemHandler     = 0;
+
+static void dispatchBleEvent(ble_evt_t *event)
+{
+    if (applicationBleHandler != 0) {
+        applicationBleHandler(event);
+    }
+    if (libraryBleHandler != 0) {
+        libraryBleHandler(event);
+    }
+}
+
+static void dispatchSystemEvent(uint32_t event)
+{
+    if (applicationSystemHandler != 0) {
+        applicationSystemHandler(event);
+    }
+    if (librarySystemHandler != 0) {
+        librarySystemHandler(event);
+    }
+}
+
+#if defined(__CC_ARM)
+/* armlink sends every call to a function to its $Sub$$ version; $Super$$ is the original. */
+extern "C" uint32_t $Super$$softdevice_ble_evt_handler_set(ble_evt_handler_t handler);
+extern "C" uint32_t $Super$$softdevice_sys_evt_handler_set(sys_evt_handler_t handler);
+
+extern "C" uint32_t $Sub$$softdevice_ble_evt_handler_set(ble_evt_handler_t handler)
+{
+    libraryBleHandler = handler;
+    return $Super$$softdevice_ble_evt_handler_set(dispatchBleEvent);
+}
+
+extern "C" uint32_t $Sub$$softdevice_sys_evt_handler_set(sys_evt_handler_t handler)
+{
+    librarySystemHandler = handler;
+    return $Super$$softdevice_sys_evt_handler_set(dispatchSystemEvent);
+}
+
+static void registerSystemDispatch(void)
+{
+    $Super$$softdevice_sys_evt_handler_set(dispatchSystemEvent);
+}
+#elif defined(__GNUC__) && defined(__arm__)
+/* The same with the GNU linker's --wrap; see SoftDeviceEvents.h. */
+extern "C" uint32_t __real_softdevice_ble_evt_handler_set(ble_evt_handler_t handler);
+extern "C" uint32_t __real_softdevice_sys_evt_handler_set(sys_evt_handler_t handler);
+
+extern "C" uint32_t __wrap_softdevice_ble_evt_handler_set(ble_evt_handler_t handler)
+{
+    libraryBleHandler = handler;
+    return __real_softdevice_ble_evt_handler_set(dispatchBleEvent);
+}
+
+extern "C" uint32_t __wrap_softdevice_sys_evt_handler_set(sys_evt_handler_t handler)
+{
+    librarySystemHandler = handler;
+    return __real_softdevice_sys_evt_handler_set(dispatchSystemEvent);
+}
+
+static void registerSystemDispatch(void)
+{
+    __real_softdevice_sys_evt_handler_set(dispatchSystemEvent);
+}
+#else
+static void registerSystemDispatch(void)
+{
+    /* no SoftDevice */
+}
+#endif
+
+bool tapSoftDeviceEvents(SoftDeviceBleHandler bleHandler, SoftDeviceSystemHandler systemHandler)
+{
+    applicationBleHandler    = bleHandler;
+    applicationSystemHandler = systemHandler;
+    if ((systemHandler != 0) && (librarySystemHandler == 0)) {
+        registerSystemDispatch();
+    }
+    return libraryBleHandler != 0;
+}
@@ -0,0 +1,49 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SOFTDEVICE_EVENTS_H__
+#define __SOFTDEVICE_EVENTS_H__
+
+#include <stdint.h>
+#include "ble.h"
+
+/*
+ * BLE_API's callbacks leave out parts of the SoftDevice events behind them
+ * that the application needs, such as the peer address of a new connection.
+ * The nRF51822 library registers its event handlers with the SDK's
+ * softdevice_handler module from BLEDevice::init(); those registrations are
+ * patched at link time so that the handlers given here see every event
+ * first, and the library's own handling then carries on as before. Under
+ * ARMCC this uses armlink's $Sub$$/$Super$$ patching; a GCC build has to
+ * link with -Wl,--wrap=softdevice_ble_evt_handler_set,--wrap=softdevice_sys_evt_handler_set
+ * and fails to link without it.
+ *
+ * The handlers run in the SoftDevice event interrupt, the same context as
+ * BLE_API's callbacks.
+ */
+typedef void (*SoftDeviceBleHandler)(const ble_evt_t *event);
+typedef void (*SoftDeviceSystemHandler)(uint32_t event);
+
+/**
+ * Call once, after BLEDevice::init(); either handler may be 0. If the
+ * library takes no system events itself, 'systemHandler' is registered on
+ * its own, since the SDK only reads system events while a handler is.
+ * Returns false if the library's registration wasn't seen, i.e. the patch
+ * isn't in this build and 'bleHandler' will never run.
+ */
+bool tapSoftDeviceEvents(SoftDeviceBleHandler bleHandler, SoftDeviceSystemHandler systemHandler);
+
+#endif /* #ifndef __SOFTDEVICE_EVENTS_H__ */
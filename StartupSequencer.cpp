@@ -0,0 +1,54 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StartupSequencer.h"
+
+StartupSequencer::StartupSequencer(Clock clockIn) :
+    clock(clockIn),
+    bootTime(0),
+    stageCount(0),
+    timeToFirstAdvertisement(0),
+    timeToFirstNotification(0)
+{
+    /* empty */
+}
+
+void StartupSequencer::run(const StageDescriptor *stages, unsigned count)
+{
+    bootTime = clock();
+
+    for (unsigned i = 0; (i < count) && (stageCount < MAX_STAGES); i++) {
+        uint32_t start = clock();
+        stages[i].run();
+        stageNames[stageCount]     = stages[i].name;
+        stageDurations[stageCount] = clock() - start;
+        stageCount++;
+    }
+}
+
+void StartupSequencer::markFirstAdvertisement(void)
+{
+    if (timeToFirstAdvertisement == 0) {
+        timeToFirstAdvertisement = (clock() - bootTime) | 1; /* never 0 once reached */
+    }
+}
+
+void StartupSequencer::markFirstNotification(void)
+{
+    if (timeToFirstNotification == 0) {
+        timeToFirstNotification = (clock() - bootTime) | 1;
+    }
+}
@@ -0,0 +1,81 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __STARTUP_SEQUENCER_H__
+#define __STARTUP_SEQUENCER_H__
+
+#include <stdint.h>
+
+/**
+ * Runs the power-on initialisation as an ordered list of stages and records
+ * how long each one took, along with the two milestones that matter to the
+ * user: time to the first advertisement and time to the first valid
+ * notification. All times are in microseconds on the clock passed to the
+ * constructor, which must already be running.
+ */
+class StartupSequencer {
+public:
+    typedef void     (*Stage)(void);
+    typedef uint32_t (*Clock)(void);
+
+    struct StageDescriptor {
+        const char *name;
+        Stage       run;
+    };
+
+    static const unsigned MAX_STAGES = 8;
+
+public:
+    StartupSequencer(Clock clock);
+
+    /**
+     * Run 'count' stages in table order; the table is usually a static const
+     * array so that the startup order is fixed and documented in one place.
+     */
+    void run(const StageDescriptor *stages, unsigned count);
+
+    void markFirstAdvertisement(void);
+    void markFirstNotification(void);
+
+    unsigned getStageCount(void) const {
+        return stageCount;
+    }
+    const char *getStageName(unsigned index) const {
+        return stageNames[index];
+    }
+    uint32_t getStageDuration(unsigned index) const {
+        return stageDurations[index];
+    }
+
+    /* Both milestones are 0 until they have been reached. */
+    uint32_t getTimeToFirstAdvertisement(void) const {
+        return timeToFirstAdvertisement;
+    }
+    uint32_t getTimeToFirstNotification(void) const {
+        return timeToFirstNotification;
+    }
+
+private:
+    Clock       clock;
+    uint32_t    bootTime;
+    unsigned    stageCount;
+    const char *stageNames[MAX_STAGES];
+    uint32_t    stageDurations[MAX_STAGES];
+    uint32_t    timeToFirstAdvertisement;
+    uint32_t    timeToFirstNotification;
+};
+
+#endif /* #ifndef __STARTUP_SEQUENCER_H__ */
@@ -0,0 +1,170 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "TelemetryLog.h"
+#include "Crc16.h"
+
+static const uint32_t ERASED_WORD    = 0xFFFFFFFF;
+static const uint32_t RETAINED_MAGIC = 0x4E544552; /* "RETN" */
+static const unsigned COUNTERS_WORDS = TelemetryLog::RECORD_WORDS - 2;
+
+typedef char countersMustFillTheRecord[(sizeof(TelemetryLog::Counters) == (COUNTERS_WORDS * sizeof(uint32_t))) ?
+                                       1 : -1];
+
+/*
+ * The retained block must not be zeroed by the C library's startup code
+ * along with the other statics, which takes an uninitialised region for
+ * .noinit in the mbed scatter file (UNINIT) or linker script (NOLOAD).
+ * Without one the block fails its check after every reset, and the previous
+ * run comes from the last checkpoint instead.
+ */
+#if defined(__CC_ARM)
+#define RETAINED_RAM __attribute__((section(".noinit"), zero_init))
+#elif defined(__GNUC__)
+#define RETAINED_RAM __attribute__((section(".noinit")))
+#else
+#define RETAINED_RAM
+#endif
+
+TelemetryLog::Retained TelemetryLog::retained RETAINED_RAM;
+
+static inline const uint32_t *recordWords(unsigned index)
+{
+    return reinterpret_cast<const uint32_t *>(TELEMETRY_START) + (index * TelemetryLog::RECORD_WORDS);
+}
+
+TelemetryLog::TelemetryLog() :
+    previousSource(SOURCE_NONE),
+    nextRecord(0),
+    lastPoll(0),
+    pendingUs(0),
+    nextCheckpoint(0),
+    checkpointedSupply(0xFFFF),
+    checkpointDue(false),
+    operationPending(false),
+    erasing(false)
+{
+    /* 'retained' is left as the last run left it, for init(). */
+    memset(&previous, 0, sizeof(previous));
+}
+
+void TelemetryLog::init(uint32_t resetReason, uint32_t now)
+{
+    /* The last checkpoint; a record cut short by a reset fails the CRC and is skipped. */
+    const uint32_t *checkpoint = 0;
+    nextRecord = 0;
+    while (nextRecord < RECORDS_PER_PAGE) {
+        const uint32_t *words = recordWords(nextRecord);
+        if (words[0] == ERASED_WORD) {
+            break;
+        }
+        nextRecord++;
+        uint16_t crc = crc16(reinterpret_cast<const uint8_t *>(&words[1]), COUNTERS_WORDS * sizeof(uint32_t));
+        if ((words[0] == RECORD_MAGIC) && (words[RECORD_WORDS - 1] == (0xFFFF0000 | crc))) {
+            checkpoint = words;
+        }
+    }
+
+    if ((retained.magic == RETAINED_MAGIC) && (retained.magicComplement == ~RETAINED_MAGIC)) {
+        previous       = retained.counters;
+        previousSource = SOURCE_RETAINED;
+    } else if (checkpoint != 0) {
+        memcpy(&previous, &checkpoint[1], sizeof(previous));
+        previousSource = SOURCE_FLASH;
+    } else {
+        previousSource = SOURCE_NONE;
+    }
+
+    Counters &c = retained.counters;
+    memset(&c, 0, sizeof(c));
+    c.bootCount           = ((previousSource != SOURCE_NONE) ? previous.bootCount : 0) + 1;
+    c.resetReason         = resetReason;
+    c.minSupplyMillivolts = 0xFFFF;
+    retained.magic           = RETAINED_MAGIC;
+    retained.magicComplement = ~RETAINED_MAGIC;
+
+    lastPoll           = now;
+    pendingUs          = 0;
+    nextCheckpoint     = now + FIRST_CHECKPOINT_US;
+    checkpointedSupply = 0xFFFF;
+    checkpointDue      = false;
+}
+
+void TelemetryLog::encode(void)
+{
+    record[0] = RECORD_MAGIC;
+    memcpy(&record[1], &retained.counters, sizeof(Counters));
+    record[RECORD_WORDS - 1] = 0xFFFF0000 | crc16(reinterpret_cast<const uint8_t *>(&record[1]),
+                                                  COUNTERS_WORDS * sizeof(uint32_t));
+}
+
+void TelemetryLog::poll(uint32_t now)
+{
+    /* A division at most once a second; the M0 has no divider. */
+    pendingUs += now - lastPoll;
+    lastPoll   = now;
+    if (pendingUs >= 1000000) {
+        uint32_t seconds = pendingUs / 1000000;
+        retained.counters.uptimeSeconds += seconds;
+        pendingUs                       -= seconds * 1000000;
+    }
+
+    if ((int32_t)(now - nextCheckpoint) >= 0) {
+        checkpointDue  = true;
+        nextCheckpoint = now + CHECKPOINT_INTERVAL_US;
+    }
+    uint16_t supply = retained.counters.minSupplyMillivolts;
+    if ((checkpointedSupply >= SUPPLY_STEP_MV) && (supply <= (checkpointedSupply - SUPPLY_STEP_MV))) {
+        checkpointDue = true;
+    }
+    if (!checkpointDue || operationPending || flashStore.isBusy()) {
+        return;
+    }
+
+    if (nextRecord >= RECORDS_PER_PAGE) {
+        if (flashStore.erasePage(TELEMETRY_START, this, now)) {
+            operationPending = true;
+            erasing          = true;
+        }
+        return;
+    }
+    encode();
+    if (flashStore.write(TELEMETRY_START + (nextRecord * RECORD_WORDS * sizeof(uint32_t)), record, RECORD_WORDS,
+                         this, now)) {
+        operationPending   = true;
+        checkpointDue      = false; /* back on if the write fails */
+        checkpointedSupply = supply;
+    }
+}
+
+void TelemetryLog::flashOperationComplete(bool success)
+{
+    operationPending = false;
+    if (erasing) {
+        erasing = false;
+        if (success) {
+            nextRecord = 0;
+        }
+        return;
+    }
+
+    /* A failed write still used up its slot; the next one goes after it. */
+    nextRecord++;
+    if (!success) {
+        checkpointDue = true;
+    }
+}
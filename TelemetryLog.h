@@ -0,0 +1,163 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TELEMETRY_LOG_H__
+#define __TELEMETRY_LOG_H__
+
+#include <stdint.h>
+#include "FlashLayout.h"
+#include "FlashStore.h"
+
+/**
+ * Health counters of the current run, from one reset to the next, and of
+ * the run before it, so that a reset in the field can be explained after
+ * the fact: what caused it (the POWER RESETREAS bits), how long the device
+ * had been up, how busy the main loop was, how many measurements were
+ * dropped and how low the supply went.
+ *
+ * The counters are updated in place in a block of RAM that the startup code
+ * leaves alone, so they survive every reset that keeps RAM powered: soft
+ * resets (including the DFU one), lockups, the reset pin. A brown-out or a
+ * new battery loses RAM, so the block is also checkpointed to the telemetry
+ * page every CHECKPOINT_INTERVAL_US, and at once whenever the supply falls
+ * SUPPLY_STEP_MV below the last checkpointed minimum. At boot, the previous
+ * run is the retained block if it is still intact, or else the last
+ * checkpoint, which is at most one interval old.
+ *
+ * The page is an append-only list of RECORD_WORDS-word records
+ *
+ *   word 0         RECORD_MAGIC
+ *   word 1 .. 8    Counters
+ *   word 9         0xFFFF0000 | CRC-16 of words 1 .. 8
+ *
+ * and is erased when full, to start over with the next checkpoint.
+ *
+ * Everything is called from the main thread.
+ */
+class TelemetryLog : public FlashClient {
+public:
+    struct Counters {
+        uint32_t bootCount;
+        uint32_t resetReason;         /* RESETREAS at the start of the run */
+        uint32_t uptimeSeconds;
+        uint32_t loopBusyUs;          /* main loop, from wakeup to waiting again, over loopPasses */
+        uint32_t loopPasses;
+        uint32_t peakLoopUs;
+        uint32_t measurementsDropped;
+        uint16_t minSupplyMillivolts; /* 0xFFFF until the first reading */
+        uint16_t reserved;
+    };
+
+    enum Source {
+        SOURCE_NONE,
+        SOURCE_RETAINED, /* the previous run, to its last moment */
+        SOURCE_FLASH,    /* the previous run, as of its last checkpoint */
+        SOURCE_LIVE      /* the current run */
+    };
+
+    static const uint32_t RECORD_MAGIC           = 0x594D4C54; /* "TLMY" */
+    static const uint32_t CHECKPOINT_INTERVAL_US = 900000000;  /* 15 minutes: a page lasts over 5 hours */
+    static const uint32_t FIRST_CHECKPOINT_US    = 60000000;   /* keeps the boot count through an early brown-out */
+    static const uint16_t SUPPLY_STEP_MV         = 50;
+
+    enum {
+        RECORD_WORDS      = 10,
+        RECORDS_PER_PAGE  = FLASH_PAGE_SIZE / (RECORD_WORDS * sizeof(uint32_t))
+    };
+
+private:
+    struct Retained {
+        uint32_t magic;
+        Counters counters;
+        uint32_t magicComplement;
+    };
+
+public:
+    static const unsigned RETAINED_SIZE = sizeof(Retained);
+
+public:
+    TelemetryLog();
+
+    /**
+     * Take over the previous run, from the retained block or the last
+     * checkpoint, and start a new one. Call once at startup.
+     */
+    void init(uint32_t resetReason, uint32_t now);
+
+    void onLoopPass(uint32_t busyUs) {
+        Counters &c = retained.counters;
+        if (c.loopBusyUs >= 0x80000000) {
+            /* Keep the mean rather than overflow; older passes count for less from here on. */
+            c.loopBusyUs >>= 1;
+            c.loopPasses >>= 1;
+        }
+        c.loopBusyUs += busyUs;
+        c.loopPasses++;
+        if (busyUs > c.peakLoopUs) {
+            c.peakLoopUs = busyUs;
+        }
+    }
+
+    void onMeasurementDropped(void) {
+        retained.counters.measurementsDropped++;
+    }
+
+    void onSupplyReading(uint16_t millivolts) {
+        if (millivolts < retained.counters.minSupplyMillivolts) {
+            retained.counters.minSupplyMillivolts = millivolts;
+        }
+    }
+
+    const Counters &getCurrent(void) const {
+        return retained.counters;
+    }
+
+    Source getPrevious(Counters &counters) const {
+        counters = previous;
+        return previousSource;
+    }
+
+    /**
+     * Account for the time since the last call and checkpoint when due.
+     */
+    void poll(uint32_t now);
+
+    uint32_t getNextDeadline(void) const {
+        return nextCheckpoint;
+    }
+
+    virtual void flashOperationComplete(bool success);
+
+private:
+    void encode(void);
+
+private:
+    static Retained retained;
+
+    Counters previous;
+    Source   previousSource;
+    unsigned nextRecord;          /* index of the first erased record slot */
+    uint32_t lastPoll;
+    uint32_t pendingUs;           /* not yet counted into uptimeSeconds */
+    uint32_t nextCheckpoint;
+    uint16_t checkpointedSupply;  /* minSupplyMillivolts as of the last checkpoint */
+    bool     checkpointDue;
+    bool     operationPending;
+    bool     erasing;
+    uint32_t record[RECORD_WORDS];
+};
+
+#endif /* #ifndef __TELEMETRY_LOG_H__ */
@@ -0,0 +1,112 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "nrf_soc.h"
+#include "Trace.h"
+
+Trace trace;
+
+static const uint32_t SYSTICK_MAX = 0x00FFFFFF;
+static const unsigned RECORD_SIZE = 8;
+static const unsigned MAX_CHUNK   = 4; /* records serialised per call into the sink */
+
+Trace::Trace() : clock(NULL), ring()
+{
+    for (unsigned i = 0; i < TRACE_NUM_STAGES; i++) {
+        stages[i].count       = 0;
+        stages[i].totalCycles = 0;
+        stages[i].maxCycles   = 0;
+    }
+}
+
+void Trace::init(Clock clockIn)
+{
+    clock = clockIn;
+
+    /* Free-running, no interrupt. */
+    SysTick->LOAD = SYSTICK_MAX;
+    SysTick->VAL  = 0;
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+uint32_t Trace::cycles(void)
+{
+    return SysTick->VAL;
+}
+
+void Trace::record(uint8_t event, uint16_t arg, uint8_t arg8)
+{
+    TraceRecord r;
+    r.timestamp = (clock != NULL) ? clock() : 0;
+    r.event     = event;
+    r.arg8      = arg8;
+    r.arg       = arg;
+
+    /* Several contexts produce records; the SoftDevice's own interrupts stay enabled. */
+    uint8_t nested;
+    sd_nvic_critical_region_enter(&nested);
+    ring.push(r);
+    sd_nvic_critical_region_exit(nested);
+}
+
+void Trace::stageCompleted(TraceStage stage, uint32_t cycleCount)
+{
+    TraceStageCounter &counter = stages[stage];
+    counter.count++;
+    counter.totalCycles += cycleCount;
+    if (cycleCount > counter.maxCycles) {
+        counter.maxCycles = cycleCount;
+    }
+}
+
+static void serialise(const TraceRecord &r, uint8_t *p)
+{
+    p[0] = (uint8_t)(r.timestamp);
+    p[1] = (uint8_t)(r.timestamp >> 8);
+    p[2] = (uint8_t)(r.timestamp >> 16);
+    p[3] = (uint8_t)(r.timestamp >> 24);
+    p[4] = r.event;
+    p[5] = r.arg8;
+    p[6] = (uint8_t)(r.arg);
+    p[7] = (uint8_t)(r.arg >> 8);
+}
+
+void Trace::drain(Sink sink, unsigned recordsPerChunk, unsigned maxRecords)
+{
+    if (recordsPerChunk > MAX_CHUNK) {
+        recordsPerChunk = MAX_CHUNK;
+    }
+
+    TraceRecord records[MAX_CHUNK];
+    uint8_t     buffer[MAX_CHUNK * RECORD_SIZE];
+    while (maxRecords > 0) {
+        unsigned n = ring.peek(records, (recordsPerChunk < maxRecords) ? recordsPerChunk : maxRecords);
+        if (n == 0) {
+            break;
+        }
+        for (unsigned i = 0; i < n; i++) {
+            serialise(records[i], &buffer[i * RECORD_SIZE]);
+        }
+
+        unsigned accepted = sink(buffer, n * RECORD_SIZE) / RECORD_SIZE;
+        ring.consume(accepted);
+        if (accepted < n) {
+            break; /* the transport is full; try again on the next idle pass */
+        }
+        maxRecords -= n;
+    }
+}
@@ -0,0 +1,159 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <stdint.h>
+#include "RingBuffer.h"
+
+/* TRACE_ENABLED follows the product's SKU_FEATURE_TRACE. Unlike DEBUG() tracing doesn't block, so it barely
+ * perturbs timing; without it every TRACE_* macro compiles to nothing. The host simulation has no SKU and
+ * never traces. */
+#if HOST_SIMULATION
+#define TRACE_ENABLED 0
+#else
+#include "Sku.h"
+#endif
+
+/**
+ * Event identifiers carried in TraceRecord::event.
+ */
+enum TraceEvent {
+    TRACE_EVENT_BOOT = 1,
+    TRACE_EVENT_SAMPLE_BATCH,     /* arg: samples drained */
+    TRACE_EVENT_BEAT,             /* arg: RR-interval, 1/1024s */
+    TRACE_EVENT_NOTIFICATION,     /* arg: payload length, arg8: ble_error_t */
+    TRACE_EVENT_CONNECTED,        /* arg: connection handle */
+    TRACE_EVENT_DISCONNECTED,     /* arg: connection handle */
+    TRACE_EVENT_CONN_PARAMS,      /* arg: profile, arg8: 1 if the request was sent */
+    TRACE_EVENT_ADVERTISING,      /* arg: advertising phase */
+    TRACE_EVENT_RING_OVERFLOW,    /* arg: samples lost */
+    TRACE_EVENT_RECONNECTED,      /* arg: time without a link, ms */
+    TRACE_EVENT_CONTACT,          /* arg: 1 if the sensor is worn */
+    TRACE_EVENT_COALESCED,        /* arg: posts folded into one handler call, arg8: event */
+    TRACE_EVENT_TX_POWER          /* arg: link quality, percent, arg8: TX power, dBm */
+};
+
+/**
+ * Hot-path stages with cycle counters.
+ */
+enum TraceStage {
+    TRACE_STAGE_SENSOR_ISR,
+    TRACE_STAGE_BEAT_DETECTION,   /* includes the motion canceller */
+    TRACE_STAGE_ENCODER,
+    TRACE_STAGE_GATT_UPDATE,
+    TRACE_NUM_STAGES
+};
+
+/**
+ * One 8-byte binary trace record, little-endian on the wire.
+ */
+struct TraceRecord {
+    uint32_t timestamp; /* microseconds */
+    uint8_t  event;
+    uint8_t  arg8;
+    uint16_t arg;
+};
+
+struct TraceStageCounter {
+    uint32_t count;
+    uint32_t totalCycles;
+    uint32_t maxCycles;
+};
+
+/**
+ * Low-overhead trace subsystem. Records go into a RAM ring from any context
+ * and are drained from the main thread when it is otherwise idle, through a
+ * sink of the caller's choosing (UART, a debug characteristic, ...).
+ *
+ * Stage durations are measured in core clock cycles with SysTick, which the
+ * SoftDevice and mbed leave unused on this target; the Cortex-M0 has no DWT
+ * cycle counter. SysTick is a 24-bit down-counter, so a single measurement
+ * is limited to about one second at 16MHz.
+ */
+class Trace {
+public:
+    static const unsigned RING_CAPACITY = 64;
+
+    typedef uint32_t (*Clock)(void);
+
+    /**
+     * Hands serialised records to the transport. Returns the number of bytes
+     * accepted; only whole records are ever offered.
+     */
+    typedef unsigned (*Sink)(const uint8_t *data, unsigned length);
+
+public:
+    Trace();
+
+    void init(Clock clock);
+
+    /**
+     * Safe to call from interrupt context.
+     */
+    void record(uint8_t event, uint16_t arg, uint8_t arg8 = 0);
+
+    static uint32_t cycles(void);
+
+    static uint32_t elapsedCycles(uint32_t since) {
+        return (since - cycles()) & 0x00FFFFFF; /* SysTick counts down */
+    }
+
+    /**
+     * Fold one measurement into a stage's counters. Each stage must only be
+     * updated from one execution context.
+     */
+    void stageCompleted(TraceStage stage, uint32_t cycleCount);
+
+    const TraceStageCounter &getStageCounter(TraceStage stage) const {
+        return stages[stage];
+    }
+
+    uint32_t getDroppedRecords(void) const {
+        return ring.getOverflowCount();
+    }
+
+    bool isEmpty(void) const {
+        return ring.isEmpty();
+    }
+
+    /**
+     * Offer up to 'maxRecords' queued records to 'sink', 'recordsPerChunk'
+     * at a time, until the ring is empty or the sink stops accepting. Main
+     * thread only.
+     */
+    void drain(Sink sink, unsigned recordsPerChunk, unsigned maxRecords);
+
+private:
+    Clock                                   clock;
+    RingBuffer<TraceRecord, RING_CAPACITY>  ring;
+    TraceStageCounter                       stages[TRACE_NUM_STAGES];
+};
+
+extern Trace trace;
+
+#if TRACE_ENABLED
+#define TRACE_EVENT(...)                  trace.record(__VA_ARGS__)
+#define TRACE_STAGE_BEGIN(token)          uint32_t token = Trace::cycles()
+#define TRACE_STAGE_END(stage, token)     trace.stageCompleted((stage), Trace::elapsedCycles(token))
+#else
+#define TRACE_EVENT(...)                  /* nothing */
+#define TRACE_STAGE_BEGIN(token)          /* nothing */
+#define TRACE_STAGE_END(stage, token)     /* nothing */
+#endif /* #if TRACE_ENABLED */
+
+#endif /* #ifndef __TRACE_H__ */
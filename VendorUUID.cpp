@@ -0,0 +1,41 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "VendorUUID.h"
+
+#define VENDOR_UUID(alias) {0x00, 0x00, (uint8_t)((alias) >> 8), (uint8_t)((alias) & 0xFF), \
+                            0x6A, 0x3C, 0x4F, 0x1E, 0x9B, 0x52, 0x48, 0xE3, 0xC1, 0xD0, 0xA7, 0xF5}
+
+const uint8_t TRACE_SERVICE_UUID[VENDOR_UUID_LENGTH]   = VENDOR_UUID(0xD000);
+const uint8_t TRACE_DATA_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD001);
+
+const uint8_t SESSION_SYNC_SERVICE_UUID[VENDOR_UUID_LENGTH]      = VENDOR_UUID(0xD100);
+const uint8_t SESSION_SYNC_CONTROL_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD101);
+const uint8_t SESSION_SYNC_DATA_CHAR_UUID[VENDOR_UUID_LENGTH]    = VENDOR_UUID(0xD102);
+
+const uint8_t RAW_WAVEFORM_SERVICE_UUID[VENDOR_UUID_LENGTH]     = VENDOR_UUID(0xD200);
+const uint8_t RAW_WAVEFORM_DATA_CHAR_UUID[VENDOR_UUID_LENGTH]   = VENDOR_UUID(0xD201);
+const uint8_t RAW_WAVEFORM_STATUS_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD202);
+
+const uint8_t DFU_SERVICE_UUID[VENDOR_UUID_LENGTH]      = VENDOR_UUID(0xD300);
+const uint8_t DFU_CONTROL_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD301);
+const uint8_t DFU_PACKET_CHAR_UUID[VENDOR_UUID_LENGTH]  = VENDOR_UUID(0xD302);
+
+const uint8_t HRV_SERVICE_UUID[VENDOR_UUID_LENGTH]     = VENDOR_UUID(0xD400);
+const uint8_t HRV_RESULT_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD401);
+
+const uint8_t DIAGNOSTICS_SERVICE_UUID[VENDOR_UUID_LENGTH]        = VENDOR_UUID(0xD500);
+const uint8_t DIAGNOSTICS_TELEMETRY_CHAR_UUID[VENDOR_UUID_LENGTH] = VENDOR_UUID(0xD501);
@@ -0,0 +1,50 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VENDOR_UUID_H__
+#define __VENDOR_UUID_H__
+
+#include <stdint.h>
+
+/*
+ * 128-bit UUIDs of the vendor-specific services and characteristics. They
+ * all share one base, 0000xxxx-6a3c-4f1e-9b52-48e3c1d0a7f5, and differ in
+ * the 16-bit alias in bytes 2-3.
+ */
+#define VENDOR_UUID_LENGTH 16
+
+extern const uint8_t TRACE_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t TRACE_DATA_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+extern const uint8_t SESSION_SYNC_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t SESSION_SYNC_CONTROL_CHAR_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t SESSION_SYNC_DATA_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+extern const uint8_t RAW_WAVEFORM_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t RAW_WAVEFORM_DATA_CHAR_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t RAW_WAVEFORM_STATUS_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+extern const uint8_t DFU_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t DFU_CONTROL_CHAR_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t DFU_PACKET_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+extern const uint8_t HRV_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t HRV_RESULT_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+extern const uint8_t DIAGNOSTICS_SERVICE_UUID[VENDOR_UUID_LENGTH];
+extern const uint8_t DIAGNOSTICS_TELEMETRY_CHAR_UUID[VENDOR_UUID_LENGTH];
+
+#endif /* #ifndef __VENDOR_UUID_H__ */
@@ -1,131 +1,1416 @@
-/* mbed Microcontroller Library
- * Copyright (c) 2006-2013 ARM Limited
- *
- * Licensed under the Apache License, Version 2.0 (the "License");
- * you may not use this file except in compliance with the License.
- * You may obtain a copy of the License at
- *
- *     http://www.apache.org/licenses/LICENSE-2.0
- *
- * Unless required by applicable law or agreed to in writing, software
- * distributed under the License is distributed on an "AS IS" BASIS,
- * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
- * See the License for the specific language governing permissions and
- * limitations under the License.
- */
-
-#include "mbed.h"
-#include "BLEDevice.h"
-#include "ble_hrs.h"
-
-BLEDevice  ble;
-DigitalOut led1(LED1);
-
-#define NEED_CONSOLE_OUTPUT 0 /* Set this if you need debug messages on the console;
-                               * it will have an impact on code-size and power consumption. */
-
-#if NEED_CONSOLE_OUTPUT
-Serial  pc(USBTX, USBRX);
-#define DEBUG(...) { pc.printf(__VA_ARGS__); }
-#else
-#define DEBUG(...) /* nothing */
-#endif /* #if NEED_CONSOLE_OUTPUT */
-
-const static char  DEVICE_NAME[] = "Nordic_HRM";
-
-/* Heart Rate Service */
-/* Service:  https://developer.bluetooth.org/gatt/services/Pages/ServiceViewer.aspx?u=org.bluetooth.service.heart_rate.xml */
-/* HRM Char: https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.heart_rate_measurement.xml */
-/* Location: https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.body_sensor_location.xml */
-static uint8_t hrmCounter = 100;
-static uint8_t bpm[2] = {0x00, hrmCounter};
-GattCharacteristic hrmRate(GattCharacteristic::UUID_HEART_RATE_MEASUREMENT_CHAR, bpm, sizeof(bpm), sizeof(bpm),
-                           GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
-static uint8_t location = BLE_HRS_BODY_SENSOR_LOCATION_FINGER;
-GattCharacteristic hrmLocation(GattCharacteristic::UUID_BODY_SENSOR_LOCATION_CHAR,
-                               (uint8_t *)&location, sizeof(location), sizeof(location),
-                               GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ);
-GattCharacteristic *hrmChars[] = {&hrmRate, &hrmLocation, };
-GattService        hrmService(GattService::UUID_HEART_RATE_SERVICE, hrmChars, sizeof(hrmChars) / sizeof(GattCharacteristic *));
-
-static const uint16_t uuid16_list[] = {GattService::UUID_HEART_RATE_SERVICE};
-
-static volatile bool triggerSensorPolling = false; /* set to high periodically to indicate to the main thread that
-                                                    * polling is necessary. */
-static Gap::ConnectionParams_t connectionParams;
-
-void disconnectionCallback(Gap::Handle_t handle)
-{
-    DEBUG("Disconnected handle %u!\n\r", handle);
-    DEBUG("Restarting the advertising process\n\r");
-    ble.startAdvertising();
-}
-
-void onConnectionCallback(Gap::Handle_t handle)
-{
-    DEBUG("connected. Got handle %u\r\n", handle);
-
-    connectionParams.slaveLatency = 1;
-    if (ble.updateConnectionParams(handle, &connectionParams) != BLE_ERROR_NONE) {
-        DEBUG("failed to update connection paramter\r\n");
-    }
-}
-
-/**
- * Triggered periodically by the 'ticker' interrupt.
- */
-void periodicCallback(void)
-{
-    led1 = !led1; /* Do blinky on LED1 while we're waiting for BLE events */
-    triggerSensorPolling = true; /* Note that the periodicCallback() executes in
-                                  * interrupt context, so it is safer to do
-                                  * heavy-weight sensor polling from the main
-                                  * thread.*/
-}
-
-int main(void)
-{
-    led1 = 1;
-    Ticker ticker;
-    ticker.attach(periodicCallback, 1);
-
-    DEBUG("Initialising the nRF51822\n\r");
-    ble.init();
-    ble.onDisconnection(disconnectionCallback);
-    ble.onConnection(onConnectionCallback);
-
-    ble.getPreferredConnectionParams(&connectionParams);
-
-    /* setup advertising */
-    ble.accumulateAdvertisingPayload(GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE);
-    ble.accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, (uint8_t*)uuid16_list, sizeof(uuid16_list));
-    ble.accumulateAdvertisingPayload(GapAdvertisingData::HEART_RATE_SENSOR_HEART_RATE_BELT);
-    ble.accumulateAdvertisingPayload(GapAdvertisingData::COMPLETE_LOCAL_NAME, (uint8_t *)DEVICE_NAME, sizeof(DEVICE_NAME));
-    ble.setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
-    ble.setAdvertisingInterval(160); /* 100ms; in multiples of 0.625ms. */
-    ble.startAdvertising();
-
-    ble.addService(hrmService);
-
-    while (true) {
-        if (triggerSensorPolling) {
-            triggerSensorPolling = false;
-
-            /* Do blocking calls or whatever is necessary for sensor polling. */
-            /* In our case, we simply update the dummy HRM measurement. */
-            hrmCounter++;
-            if (hrmCounter == 175) {
-                hrmCounter = 100;
-            }
-
-            if (ble.getGapState().connected) {
-                /* First byte = 8-bit values, no extra info, Second byte = uint8_t HRM value */
-                /* See --> https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.heart_rate_measurement.xml */
-                bpm[1] = hrmCounter;
-                ble.updateCharacteristicValue(hrmRate.getHandle(), bpm, sizeof(bpm));
-            }
-        } else {
-            ble.waitForEvent();
-        }
-    }
-}
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mbed.h"
+#include "BLEDevice.h"
+#include "SensorAcquisition.h"
+#include "Sku.h"
+#include "NotificationScheduler.h"
+#include "ConnectionParameterManager.h"
+#include "ConnectionTable.h"
+#include "AdvertisingManager.h"
+#include "AdvertisingPayload.h"
+#include "PeerCache.h"
+#include "MeasurementPipeline.h"
+#include "GattArena.h"
+#include "MemoryBudget.h"
+#include "FlashLayout.h"
+#include "StartupSequencer.h"
+#include "Trace.h"
+#include "VendorUUID.h"
+#include "Benchmark.h"
+#include "FlashStore.h"
+#include "SessionLog.h"
+#include "SessionSync.h"
+#include "DfuService.h"
+#include "HrvService.h"
+#include "TelemetryLog.h"
+#include "DiagnosticsService.h"
+#include "RawWaveformStream.h"
+#include "BatteryMonitor.h"
+#include "EnergyExpenditure.h"
+#include "EventDispatcher.h"
+#include "SoftDeviceEvents.h"
+#include "ble.h"
+#include "ble_gap.h"
+#include "nrf_soc.h"
+#include "nrf_gpio.h"
+
+BLEDevice  ble;
+DigitalOut led1(LED1);
+
+/* Console output and tracing are debug features of the SKU (see Sku.h). */
+
+#define TRACE_DRAIN_OVER_GATT 0 /* With TRACE_ENABLED, set this to drain trace records through
+                                 * the debug characteristic instead of the UART. */
+
+#define RAW_WAVEFORM_EXPORT 0 /* Set this to add the raw waveform service, for validating the sensor against
+                               * reference equipment. It keeps the sensor and radio busy while subscribed. */
+
+/* DFU_SERVICE is set in FlashLayout.h, since it decides the layout. The service needs an encrypted link, and
+ * only installs images tagged with DFU_IMAGE_KEY, which must be defined to the product's own key, as a list of
+ * up to 64 byte values. */
+#if DFU_SERVICE && !defined(DFU_IMAGE_KEY)
+#error "DFU_SERVICE needs DFU_IMAGE_KEY"
+#endif
+
+#if NEED_CONSOLE_OUTPUT || BENCHMARK_SCENARIO || (TRACE_ENABLED && !TRACE_DRAIN_OVER_GATT)
+Serial  pc(USBTX, USBRX);
+#endif
+#if NEED_CONSOLE_OUTPUT
+#define DEBUG(...) { pc.printf(__VA_ARGS__); }
+#else
+#define DEBUG(...) /* nothing */
+#endif /* #if NEED_CONSOLE_OUTPUT */
+
+#define LED_HEARTBEAT 1 /* Set this to flash LED1 briefly on every detected beat. A lit LED draws more
+                         * than the radio, so it is otherwise left dark. */
+static const uint32_t LED_PULSE_US = 5000;
+
+#define ADVERTISING_TIMEOUT_S 300     /* Slow advertising lasts this long before the device goes idle; 0 to
+                                       * advertise forever. BUTTON1 restarts advertising from idle. */
+#define ADVERTISING_IDLE_SYSTEM_OFF 0 /* Set this to enter System OFF instead of just stopping advertising
+                                       * when idle; BUTTON1 then wakes the device through a reset. */
+
+/* A session starts once a central subscribes to the heart rate measurement. If the central goes away,
+ * beats keep being logged to flash until none has been seen for this long (the strap has been taken off). */
+static const uint32_t SESSION_IDLE_US = 60000000;
+
+/* The wearer, for the energy expended model; there is no way to enter this yet. */
+static const uint8_t WEARER_WEIGHT_KG = 75;
+static const uint8_t WEARER_AGE_YEARS = 35;
+static const bool    WEARER_FEMALE    = false;
+
+/* Heart rate variability windows, in beats: about half a minute, two minutes and five minutes at rest. */
+static const uint16_t HRV_WINDOWS[] = {30, 120, 256};
+
+SensorAcquisition          sensor(p1, p2); /* PPG front-end output on AIN2, accelerometer axis on AIN3 */
+NotificationScheduler      notificationScheduler;
+ConnectionTable            connections;
+AdvertisingManager         advertisingManager((uint32_t)ADVERTISING_TIMEOUT_S * 1000000);
+PeerCache                  peerCache;
+BatteryMonitor             batteryMonitor;
+EnergyExpenditure          energyExpenditure(WEARER_WEIGHT_KG, WEARER_AGE_YEARS, WEARER_FEMALE);
+SessionLog                 sessionLog;
+SessionSync                sessionSync(ble, sessionLog);
+#if DFU_SERVICE
+static const uint8_t       dfuImageKey[] = {DFU_IMAGE_KEY};
+DfuService                 dfuService(ble, dfuImageKey, sizeof(dfuImageKey));
+#endif
+HrvAnalyzer                hrvAnalyzer(HRV_WINDOWS, sizeof(HRV_WINDOWS) / sizeof(HRV_WINDOWS[0]));
+HrvService                 hrvService(ble, hrvAnalyzer);
+TelemetryLog               telemetryLog;
+DiagnosticsService         diagnosticsService(ble, telemetryLog);
+#if RAW_WAVEFORM_EXPORT
+RawWaveformStream          rawStream(ble);
+#endif
+InterruptIn                wakeButton(BUTTON1);
+Timer                      systemClock; /* free-running microsecond time base */
+Timeout                    wakeupTimeout;
+Timeout                    ledTimeout;
+/* The detector's time constants assume the acquisition rate; fail the build if they drift apart. */
+typedef char sampleRatesMustMatch[(SensorAcquisition::SAMPLE_RATE_HZ == BeatDetector::SAMPLE_RATE_HZ) ? 1 : -1];
+
+/* Heart Rate Service, laid out for the product being built (see Sku.h) */
+/* HRM Char: https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.heart_rate_measurement.xml */
+/* Location: https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.body_sensor_location.xml */
+typedef Sku::Profile              HrmProfile;
+typedef HrmProfile::Measurement   HrmMeasurement;
+static HrmProfile                 hrmProfile(ble);
+static HrmMeasurement            &hrmEncoder = hrmProfile.getMeasurement();
+
+/* The measurement path's view of the rest of the application. */
+class HrmLink : public MeasurementLink {
+public:
+    HrmLink() : sentTo(0) {
+        /* empty */
+    }
+
+    virtual bool isSubscribed(void);
+    virtual bool send(const uint8_t *data, unsigned length);
+    virtual void discard(void);
+
+private:
+    uint8_t sentTo; /* slots the frame being offered has already gone out on */
+};
+
+class HrmObserver : public MeasurementObserver {
+public:
+    virtual void onBeat(const BeatDetector::Beat &beat);
+    virtual void onContactChanged(bool worn);
+    virtual void onMeasurementSent(void);
+    virtual void onMeasurementDropped(void);
+};
+
+static HrmLink     hrmLink;
+static HrmObserver hrmObserver;
+/* Three frames queued for a transmit buffer are enough to ride out a few refused connection events. */
+typedef MeasurementPipeline<HrmMeasurement, 3> HrmPipeline;
+static HrmPipeline hrmPipeline(hrmEncoder, energyExpenditure, notificationScheduler, hrmLink, hrmObserver);
+
+/* Battery Service */
+/* Service:  https://developer.bluetooth.org/gatt/services/Pages/ServiceViewer.aspx?u=org.bluetooth.service.battery_service.xml */
+/* Level:    https://developer.bluetooth.org/gatt/characteristics/Pages/CharacteristicViewer.aspx?u=org.bluetooth.characteristic.battery_level.xml */
+static const unsigned      BATTERY_GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(1);
+static GattCharacteristic *batteryLevel; /* reads are served from the stack's copy without waking us */
+
+#if TRACE_ENABLED && TRACE_DRAIN_OVER_GATT
+/* Debug service: trace records, two per notification. */
+static const unsigned      TRACE_CHUNK_SIZE     = 2 * sizeof(TraceRecord);
+static const unsigned      TRACE_GATT_FOOTPRINT = GATT_SERVICE_FOOTPRINT + GATT_CHARACTERISTIC_FOOTPRINT(TRACE_CHUNK_SIZE);
+static GattCharacteristic *traceDataChar;
+#else
+static const unsigned      TRACE_GATT_FOOTPRINT = 0;
+#endif /* #if TRACE_ENABLED && TRACE_DRAIN_OVER_GATT */
+
+#if RAW_WAVEFORM_EXPORT
+static const unsigned RAW_WAVEFORM_GATT_FOOTPRINT = RawWaveformStream::GATT_FOOTPRINT;
+#else
+static const unsigned RAW_WAVEFORM_GATT_FOOTPRINT = 0;
+#endif
+
+#if DFU_SERVICE
+static const unsigned DFU_GATT_FOOTPRINT = DfuService::GATT_FOOTPRINT;
+#else
+static const unsigned DFU_GATT_FOOTPRINT = 0;
+#endif
+
+/* Every service and characteristic, with its value buffer, is built in this one arena at startup. */
+static StaticGattArena<HrmProfile::GATT_FOOTPRINT + BATTERY_GATT_FOOTPRINT + SessionSync::GATT_FOOTPRINT +
+                       DFU_GATT_FOOTPRINT + HrvService::GATT_FOOTPRINT + DiagnosticsService::GATT_FOOTPRINT +
+                       RAW_WAVEFORM_GATT_FOOTPRINT + TRACE_GATT_FOOTPRINT> gattArena;
+
+/* Advertising payload, laid out at compile time and kept in flash. */
+typedef AdSequence<AdSequence<AdStructure<1>, AdStructure<2> >, AdStructure<2> > AdvertisingBase;
+typedef AdStringStructure<sizeof(SKU_DEVICE_NAME)>                               LocalNameField;
+static const AdvertisingBase advertisingBase = {
+    {
+        {2, GapAdvertisingData::FLAGS, {GapAdvertisingData::BREDR_NOT_SUPPORTED | GapAdvertisingData::LE_GENERAL_DISCOVERABLE}},
+        {3, GapAdvertisingData::COMPLETE_LIST_16BIT_SERVICE_IDS, {ADV_UINT16(GattService::UUID_HEART_RATE_SERVICE)}},
+    },
+    {3, GapAdvertisingData::APPEARANCE, {ADV_UINT16(Sku::APPEARANCE)}},
+};
+static const LocalNameField localNameField = {sizeof(SKU_DEVICE_NAME), GapAdvertisingData::COMPLETE_LOCAL_NAME,
+                                              SKU_DEVICE_NAME};
+
+/* The local name moves to the scan response if it doesn't fit next to the rest. */
+static const bool NAME_IN_ADVERTISEMENT = (AdvertisingBase::SIZE + LocalNameField::SIZE) <= ADV_PAYLOAD_MAX_SIZE;
+ADV_PAYLOAD_ASSERT(AdvertisingBase::SIZE <= ADV_PAYLOAD_MAX_SIZE, advertisingPayloadTooLarge);
+ADV_PAYLOAD_ASSERT(LocalNameField::SIZE <= ADV_PAYLOAD_MAX_SIZE, deviceNameTooLong);
+
+static Gap::ConnectionParams_t preferredParams; /* what we ask for before the policy has a say */
+static Gap::ConnectionParams_t connectedParams; /* what the link being opened starts with, from its connected event */
+static volatile bool           wakeRequested = false; /* set from the BUTTON1 interrupt */
+static bool                    sessionActive = false; /* a workout is under way; see SESSION_IDLE_US */
+static bool                    sessionLogging = false; /* ... and nobody is listening, so it goes to flash */
+static uint32_t                lastBeatTime;
+static bool                    linkLost = false; /* a central dropped and we're waiting for one to come back */
+static uint32_t                linkLostTime;
+static bool                    directedAdvertising = false; /* started through the SoftDevice, behind BLE_API's back */
+
+static uint32_t now(void)
+{
+    return (uint32_t)systemClock.read_us();
+}
+
+StartupSequencer startup(now);
+
+/*
+ * Main loop events. Interrupts and stack callbacks post the first five; the
+ * polls behind the last three are posted by the handlers whose events can
+ * give them work (see postPolls()), and the flash poll by the end of each
+ * flash operation, never just because the core woke up: the sampling Ticker
+ * alone wakes it SAMPLE_RATE_HZ times a second.
+ */
+enum MainEvent {
+    EVENT_TX_COMPLETE,  /* the stack has freed transmit buffers */
+    EVENT_DEADLINE,     /* the wakeup timer fired */
+    EVENT_SAMPLES,      /* a sample batch is waiting */
+    EVENT_LINK,         /* connection, subscription or write */
+    EVENT_BUTTON,
+    EVENT_HOUSEKEEPING, /* policy polls */
+    EVENT_FLASH,        /* flash operations and their clients */
+    EVENT_DIAGNOSTICS,  /* trace drain, benchmark */
+    NUM_MAIN_EVENTS
+};
+
+void txCompleteEvent(void);
+void deadlineEvent(void);
+void samplesEvent(void);
+void linkEvent(void);
+void buttonEvent(void);
+void housekeepingEvent(void);
+void flashEvent(void);
+void diagnosticsEvent(void);
+
+static const EventDispatcher::EventDescriptor mainEvents[] = {
+    {"tx complete",  EventDispatcher::PRIORITY_RADIO,      txCompleteEvent},
+    {"deadline",     EventDispatcher::PRIORITY_RADIO,      deadlineEvent},
+    {"samples",      EventDispatcher::PRIORITY_SIGNAL,     samplesEvent},
+    {"link",         EventDispatcher::PRIORITY_CONTROL,    linkEvent},
+    {"button",       EventDispatcher::PRIORITY_CONTROL,    buttonEvent},
+    {"housekeeping", EventDispatcher::PRIORITY_BACKGROUND, housekeepingEvent},
+    {"flash",        EventDispatcher::PRIORITY_BACKGROUND, flashEvent},
+    {"diagnostics",  EventDispatcher::PRIORITY_IDLE,       diagnosticsEvent},
+};
+typedef char mainEventTableMismatch[((sizeof(mainEvents) / sizeof(mainEvents[0])) == NUM_MAIN_EVENTS) &&
+                                    (NUM_MAIN_EVENTS <= EventDispatcher::MAX_EVENTS) ? 1 : -1];
+
+static EventDispatcher dispatcher(mainEvents, NUM_MAIN_EVENTS);
+
+/**
+ * Some connected central has subscribed to the heart rate measurement.
+ */
+static bool hrmSubscribed(void)
+{
+    return connections.anySubscribed();
+}
+
+/**
+ * Nobody is wearing the sensor: sample just enough to notice when somebody
+ * puts it on again, send no measurements and advertise slowly.
+ */
+static bool inStandby(void)
+{
+    return hrmPipeline.getContactState() == ContactDetector::STATE_OFF;
+}
+
+void disconnectionCallback(Gap::Handle_t handle)
+{
+    DEBUG("Disconnected handle %u!\n\r", handle);
+    TRACE_EVENT(TRACE_EVENT_DISCONNECTED, handle);
+    BENCHMARK_HOOK(onDisconnected());
+    connections.close(handle);
+    sessionSync.onDisconnected();
+#if DFU_SERVICE
+    dfuService.onDisconnected();
+#endif
+#if RAW_WAVEFORM_EXPORT
+    rawStream.onDisconnected();
+#endif
+    if (connections.getCount() == 0) {
+        notificationScheduler.onDisconnected();
+        linkLost     = true;
+        linkLostTime = now();
+    }
+    DEBUG("Restarting the advertising process\n\r");
+    /* Directed at the last central first, then fast advertising, for a quick reconnection. */
+    advertisingManager.start(now(), peerCache.getCount() > 0);
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_LINK);
+}
+
+void onConnectionCallback(Gap::Handle_t handle)
+{
+    DEBUG("connected. Got handle %u\r\n", handle);
+    TRACE_EVENT(TRACE_EVENT_CONNECTED, handle);
+    BENCHMARK_HOOK(onConnected(now()));
+    connections.open(handle, connectedParams, now()); /* parameters are renegotiated from the main loop */
+    sd_ble_gap_rssi_start(handle); /* for the link monitor; see readLinkRssi() */
+#if DFU_SERVICE
+    dfuService.onConnected(handle);
+#endif
+    if (connections.getCount() == 1) {
+        notificationScheduler.setConnectionInterval(connectedParams.minConnectionInterval);
+        notificationScheduler.onConnected(now());
+    }
+    if (linkLost) {
+        /* How long the measurement stream was interrupted. */
+        linkLost = false;
+        uint32_t gap = now() - linkLostTime;
+        (void)gap;
+        DEBUG("reconnected after %luus\r\n", gap);
+        TRACE_EVENT(TRACE_EVENT_RECONNECTED, (uint16_t)((gap > 65535000) ? 65535 : (gap / 1000)));
+    }
+    directedAdvertising = false; /* a connection ends advertising of either kind */
+    if (connections.isFull()) {
+        advertisingManager.stop();
+    } else {
+        advertisingManager.start(now()); /* the stack stops advertising on a connection; keep inviting more */
+    }
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_LINK);
+}
+
+static void toConnectionParams(const ble_gap_conn_params_t &in, Gap::ConnectionParams_t &out)
+{
+    out.minConnectionInterval        = in.min_conn_interval;
+    out.maxConnectionInterval        = in.max_conn_interval;
+    out.slaveLatency                 = in.slave_latency;
+    out.connectionSupervisionTimeout = in.conn_sup_timeout;
+}
+
+/**
+ * The central has applied connection parameters, ours or its own choice;
+ * the interval it uses is both the minimum and the maximum. The
+ * notification scheduler follows the link its anchors come from.
+ */
+static void connectionParamsUpdated(Gap::Handle_t handle, const ble_gap_conn_params_t &applied)
+{
+    ConnectionContext *c = connections.find(handle);
+    if (c == 0) {
+        return;
+    }
+    toConnectionParams(applied, c->params);
+    if (c == connections.getTxOrigin()) {
+        notificationScheduler.setConnectionInterval(applied.min_conn_interval);
+    }
+}
+
+/**
+ * What BLE_API's callbacks leave out of the SoftDevice events; see
+ * SoftDeviceEvents.h. Runs ahead of the callback for the same event.
+ */
+void bleEventCallback(const ble_evt_t *event)
+{
+    switch (event->header.evt_id) {
+        case BLE_GAP_EVT_CONNECTED:
+            /* The most recent central, for directed advertising after a disconnection. */
+            peerCache.remember(event->evt.gap_evt.params.connected.peer_addr);
+            toConnectionParams(event->evt.gap_evt.params.connected.conn_params, connectedParams);
+            break;
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            connectionParamsUpdated(event->evt.gap_evt.conn_handle,
+                                    event->evt.gap_evt.params.conn_param_update.conn_params);
+            break;
+#if DFU_SERVICE
+        case BLE_GATTS_EVT_WRITE:
+            /* Several image packets can arrive in one connection event; BLE_API only reports the handle. */
+            dfuService.onWriteEvent(event->evt.gatts_evt.params.write.data, event->evt.gatts_evt.params.write.len);
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/**
+ * SoftDevice system events, from the same tap; the end of a flash
+ * operation gives the flash clients their next step.
+ */
+void systemEventCallback(uint32_t event)
+{
+    if (flashStore.onSystemEvent(event)) {
+        dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_FLASH);
+    }
+}
+
+void updatesEnabledCallback(uint16_t charHandle)
+{
+    ConnectionContext *c = connections.getCccdOrigin();
+    if ((c != 0) && (charHandle == hrmProfile.getMeasurementHandle())) {
+        c->hrmSubscribed = true;
+    }
+#if RAW_WAVEFORM_EXPORT
+    rawStream.onUpdatesEnabled(charHandle);
+#endif
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_LINK);
+}
+
+void updatesDisabledCallback(uint16_t charHandle)
+{
+    ConnectionContext *c = connections.getCccdOrigin();
+    if ((c != 0) && (charHandle == hrmProfile.getMeasurementHandle())) {
+        c->hrmSubscribed = false;
+    }
+#if RAW_WAVEFORM_EXPORT
+    rawStream.onUpdatesDisabled(charHandle);
+#endif
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_LINK);
+}
+
+static bool rawStreaming(void)
+{
+#if RAW_WAVEFORM_EXPORT
+    return rawStream.isStreaming();
+#else
+    return false;
+#endif
+}
+
+static bool dfuActive(void)
+{
+#if DFU_SERVICE
+    return dfuService.isActive();
+#else
+    return false;
+#endif
+}
+
+void dataWrittenCallback(uint16_t charHandle)
+{
+    hrmProfile.onDataWritten(charHandle);
+    sessionSync.onDataWritten(charHandle);
+#if DFU_SERVICE
+    dfuService.onDataWritten(charHandle);
+#endif
+    hrvService.onDataWritten(charHandle);
+    diagnosticsService.onDataWritten(charHandle);
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_LINK);
+}
+
+/**
+ * Reset energy expended when the central asks for it through the control
+ * point, and report the new value straight away. Runs in the main thread.
+ */
+void updateEnergyExpended(void)
+{
+    if (hrmProfile.energyResetRequested()) {
+        DEBUG("energy expended reset\r\n");
+        energyExpenditure.reset();
+        hrmPipeline.requestEnergyReport();
+    }
+}
+
+/**
+ * Track the workout session and switch logging to flash on and off as the
+ * central stops and starts listening. Logging stops by sealing the page, so
+ * that a central that has just subscribed can sync everything at once.
+ * Runs in the main thread.
+ */
+void updateSession(void)
+{
+    uint32_t t = now();
+    if (hrmSubscribed()) {
+        sessionActive = true;
+        lastBeatTime  = t;
+    } else if (sessionActive && ((t - lastBeatTime) >= SESSION_IDLE_US)) {
+        sessionActive = false;
+    }
+
+    bool logging = sessionActive && !hrmSubscribed();
+    if (logging != sessionLogging) {
+        sessionLogging = logging;
+        if (logging) {
+            sessionLog.beginSession();
+        } else {
+            sessionLog.seal();
+        }
+    }
+}
+
+/**
+ * Only run beat detection while a central is subscribed to the heart rate
+ * measurement, or while a session is being logged offline, and the sensor
+ * is worn. Otherwise a connected or advertising device only gets low-rate
+ * contact detection (the raw waveform export excepted, which shows whatever
+ * the sensor sees), and once advertising has gone idle the sampling ISR is
+ * stopped. Runs in the main thread so that the detector is never reset
+ * underneath processSamples().
+ */
+void updateAcquisition(void)
+{
+    SensorAcquisition::Mode wanted = SensorAcquisition::MODE_OFF;
+    if (rawStreaming() || ((hrmSubscribed() || sessionActive) && !inStandby())) {
+        wanted = SensorAcquisition::MODE_FULL;
+    } else if (ble.getGapState().connected || (advertisingManager.getPhase() != AdvertisingManager::PHASE_IDLE)) {
+        wanted = SensorAcquisition::MODE_CONTACT_DETECT;
+    }
+    if (wanted == sensor.getMode()) {
+        return;
+    }
+
+    if (wanted == SensorAcquisition::MODE_FULL) {
+        hrmPipeline.restart();
+        hrvAnalyzer.reset(); /* the intervals either side of a gap aren't neighbours */
+    } else if (wanted == SensorAcquisition::MODE_OFF) {
+        hrmPipeline.resetContact();
+    }
+    sensor.setMode(wanted);
+}
+
+/**
+ * Hand each link's latest RSSI to its monitor. BLE_API has no RSSI event,
+ * and BLE_GAP_EVT_RSSI_CHANGED never reaches the application, so the value
+ * the SoftDevice keeps since sd_ble_gap_rssi_start() is read instead, on
+ * each transmission completion: often enough to follow the link, and only
+ * while there is traffic to set the power for. Runs in the main thread.
+ */
+static void readLinkRssi(void)
+{
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        int8_t             rssi;
+        if ((c != 0) && (sd_ble_gap_rssi_get(c->handle, &rssi) == NRF_SUCCESS)) {
+            c->linkMonitor.onRssi(rssi);
+        }
+    }
+}
+
+/**
+ * Hand each link's quality to its parameter manager and apply the TX power
+ * its monitor wants. The S110 has a single TX power setting, so it follows
+ * the first link, and goes back to the default, which advertising needs,
+ * once the last link is gone. Runs in the main thread.
+ */
+void updateLinkQuality(void)
+{
+    static int8_t txPower = LinkMonitor::DEFAULT_TX_POWER;
+
+    int8_t  wanted  = LinkMonitor::DEFAULT_TX_POWER;
+    uint8_t quality = 100;
+    bool    first   = true;
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        if (c == 0) {
+            continue;
+        }
+        LinkMonitor &monitor = c->linkMonitor;
+        monitor.setConnectionInterval(c->params.maxConnectionInterval);
+        monitor.poll(now());
+        c->parameterManager.setLinkQuality(monitor.getLinkQuality());
+        if (first) {
+            wanted  = monitor.getTxPower();
+            quality = monitor.getLinkQuality();
+            first   = false;
+        }
+    }
+
+    if ((wanted != txPower) && (ble.setTxPower(wanted) == BLE_ERROR_NONE)) {
+        DEBUG("tx power %d dBm, link quality %u%%\r\n", wanted, quality);
+        TRACE_EVENT(TRACE_EVENT_TX_POWER, quality, (uint8_t)wanted);
+        txPower = wanted;
+    }
+    (void)quality;
+}
+
+/**
+ * Ask each central for new connection parameters if the policy wants them.
+ * A successful call only means the request was sent; what the central
+ * settles on arrives with BLE_GAP_EVT_CONN_PARAM_UPDATE, see
+ * connectionParamsUpdated(). Runs in the main thread.
+ */
+void updateConnectionParameters(void)
+{
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        if (c == 0) {
+            continue;
+        }
+
+        ConnectionParameterManager &manager = c->parameterManager;
+        manager.setBatteryLow(batteryMonitor.isLow());
+        manager.setBulkTransfer(sessionSync.isActive() || dfuActive() || rawStreaming());
+        Gap::ConnectionParams_t params;
+        if (!manager.poll(now(), params)) {
+            continue;
+        }
+
+        bool success = (ble.updateConnectionParams(c->handle, &params) == BLE_ERROR_NONE);
+        manager.requestCompleted(now(), success);
+        TRACE_EVENT(TRACE_EVENT_CONN_PARAMS, manager.getCurrentProfile(), success);
+        if (!success) {
+            DEBUG("failed to update connection paramter\r\n");
+        }
+    }
+}
+
+void dataSentCallback(unsigned count)
+{
+    (void)count;
+    BENCHMARK_HOOK(onTransmissionComplete(count));
+    notificationScheduler.onTransmissionComplete(now());
+    ConnectionContext *c = connections.getTxOrigin();
+    if (c != 0) {
+        c->linkMonitor.onPacketsSent(now());
+    }
+    sessionSync.onDataSent();
+#if RAW_WAVEFORM_EXPORT
+    rawStream.onDataSent(count);
+#endif
+    dispatcher.post(EventDispatcher::SOURCE_STACK, EVENT_TX_COMPLETE);
+}
+
+/**
+ * Apply advertising phase changes. Runs in the main thread.
+ */
+void updateAdvertising(void)
+{
+    if (wakeRequested) {
+        wakeRequested = false;
+        if (advertisingManager.getPhase() == AdvertisingManager::PHASE_IDLE) {
+            advertisingManager.start(now());
+        }
+    }
+
+    if (inStandby()) {
+        advertisingManager.slowDown(now());
+    }
+
+    AdvertisingManager::Phase phase;
+    if (!advertisingManager.poll(now(), phase)) {
+        return;
+    }
+
+    TRACE_EVENT(TRACE_EVENT_ADVERTISING, phase);
+    BENCHMARK_HOOK(onAdvertisingPhase());
+    if (directedAdvertising) {
+        sd_ble_gap_adv_stop(); /* normally timed out by itself already */
+        directedAdvertising = false;
+    }
+    if (ble.getGapState().advertising) {
+        ble.stopAdvertising();
+    }
+    ble_gap_addr_t       peer;
+    ble_gap_adv_params_t directedParams;
+    uint16_t             interval;
+    switch (phase) {
+        case AdvertisingManager::PHASE_DIRECTED:
+            /* BLE_API only advertises undirected; go to the SoftDevice. Interval and timeout are fixed. */
+            if (!peerCache.getLastPeer(peer)) {
+                break;
+            }
+            memset(&directedParams, 0, sizeof(directedParams));
+            directedParams.type        = BLE_GAP_ADV_TYPE_ADV_DIRECT_IND;
+            directedParams.p_peer_addr = &peer;
+            directedParams.fp          = BLE_GAP_ADV_FP_ANY;
+            DEBUG("directed advertising\r\n");
+            if (sd_ble_gap_adv_start(&directedParams) == NRF_SUCCESS) {
+                directedAdvertising = true;
+                startup.markFirstAdvertisement();
+            }
+            break;
+        case AdvertisingManager::PHASE_FAST:
+        case AdvertisingManager::PHASE_SLOW:
+            interval = (phase == AdvertisingManager::PHASE_FAST) ? Sku::FAST_ADVERTISING_INTERVAL :
+                                                                   Sku::SLOW_ADVERTISING_INTERVAL;
+            DEBUG("advertising interval %u\r\n", interval);
+            ble.setAdvertisingInterval(interval); /* in multiples of 0.625ms. */
+            if (ble.startAdvertising() == BLE_ERROR_NONE) {
+                startup.markFirstAdvertisement();
+            }
+            break;
+        case AdvertisingManager::PHASE_IDLE:
+            DEBUG("advertising timed out\r\n");
+#if ADVERTISING_IDLE_SYSTEM_OFF
+            nrf_gpio_cfg_sense_input(BUTTON1, NRF_GPIO_PIN_PULLUP, NRF_GPIO_PIN_SENSE_LOW);
+            sd_power_system_off(); /* does not return; waking up is a reset */
+#endif
+            break;
+        default:
+            break;
+    }
+}
+
+void wakeButtonCallback(void)
+{
+    wakeRequested = true;
+    dispatcher.post(EventDispatcher::SOURCE_GPIO, EVENT_BUTTON);
+}
+
+/**
+ * The deadline armWakeup() asked for has come. One that comes round again
+ * before the main loop got to the last is counted, not lost.
+ */
+void wakeupCallback(void)
+{
+    dispatcher.post(EventDispatcher::SOURCE_TIMER, EVENT_DEADLINE);
+}
+
+/**
+ * From the sampling ISR, once per batch.
+ */
+void samplesReadyCallback(void)
+{
+    dispatcher.post(EventDispatcher::SOURCE_TIMER, EVENT_SAMPLES);
+}
+
+void ledOffCallback(void)
+{
+    led1 = 0;
+}
+
+/**
+ * The sensor went on or off the skin. Full-rate sampling and fast
+ * advertising come back right away rather than on the next idle pass, so
+ * that the first beat after putting the strap on isn't missed. Runs in the
+ * main thread.
+ */
+void HrmObserver::onContactChanged(bool worn)
+{
+    DEBUG("sensor contact %u\r\n", worn);
+    TRACE_EVENT(TRACE_EVENT_CONTACT, worn);
+    if (worn && (advertisingManager.getPhase() == AdvertisingManager::PHASE_SLOW)) {
+        advertisingManager.start(now());
+    }
+    updateAcquisition();
+}
+
+void HrmObserver::onBeat(const BeatDetector::Beat &beat)
+{
+    lastBeatTime = now();
+    hrvAnalyzer.addBeat(beat.rrInterval);
+    if (sessionLogging) {
+        sessionLog.logBeat(beat.rrInterval, beat.heartRate);
+    }
+    TRACE_EVENT(TRACE_EVENT_BEAT, beat.rrInterval);
+    BENCHMARK_HOOK(onBeat());
+#if LED_HEARTBEAT
+    led1 = 1;
+    ledTimeout.attach_us(ledOffCallback, LED_PULSE_US);
+#endif
+}
+
+void HrmObserver::onMeasurementSent(void)
+{
+    BENCHMARK_HOOK(onNotification());
+    if (startup.getTimeToFirstNotification() == 0) {
+        startup.markFirstNotification();
+        DEBUG("first notification after %luus\r\n", startup.getTimeToFirstNotification());
+    }
+}
+
+void HrmObserver::onMeasurementDropped(void)
+{
+    telemetryLog.onMeasurementDropped();
+}
+
+/**
+ * Consume one batch of raw samples drained from the acquisition ring. Runs in
+ * the main thread.
+ */
+void processSamples(const SensorSample *samples, unsigned count)
+{
+    if (sensor.getMode() != SensorAcquisition::MODE_FULL) {
+        /* Contact detection samples; too slow for the beat detector. */
+        hrmPipeline.processContactSamples(samples, count, 1000000 / SensorAcquisition::CONTACT_RATE_HZ, now());
+        return;
+    }
+
+    TRACE_EVENT(TRACE_EVENT_SAMPLE_BATCH, count);
+#if RAW_WAVEFORM_EXPORT
+    rawStream.push(samples, count);
+    if (rawStream.isStreaming()) {
+        rawStream.updateStatus(sensor.getDroppedSampleCount());
+    }
+#endif
+    hrmPipeline.processSamples(samples, count, now());
+}
+
+/**
+ * Measure the supply voltage, in millivolts, through the ADC's internal
+ * VDD/3 input against the 1.2V band gap. The sensor's AnalogIn shares the
+ * ADC and reconfigures it for every sample, so the sampling interrupt is
+ * held off for the ~70us of the conversion.
+ */
+static uint16_t readSupplyMillivolts(void)
+{
+    uint8_t nested;
+    sd_nvic_critical_region_enter(&nested);
+    NRF_ADC->CONFIG = (ADC_CONFIG_RES_10bit << ADC_CONFIG_RES_Pos) |
+                      (ADC_CONFIG_INPSEL_SupplyOneThirdPrescaling << ADC_CONFIG_INPSEL_Pos) |
+                      (ADC_CONFIG_REFSEL_VBG << ADC_CONFIG_REFSEL_Pos) |
+                      (ADC_CONFIG_PSEL_Disabled << ADC_CONFIG_PSEL_Pos);
+    NRF_ADC->ENABLE      = ADC_ENABLE_ENABLE_Enabled;
+    NRF_ADC->EVENTS_END  = 0;
+    NRF_ADC->TASKS_START = 1;
+    while (!NRF_ADC->EVENTS_END) {
+        /* busy */
+    }
+    NRF_ADC->EVENTS_END = 0;
+    uint32_t result = NRF_ADC->RESULT;
+    sd_nvic_critical_region_exit(nested);
+
+    return (uint16_t)((result * 3600) / 1023);
+}
+
+/**
+ * Take a battery measurement when one is due, and notify the level only if
+ * it changed. Runs in the main thread.
+ */
+void updateBattery(void)
+{
+    BatteryMonitor::Load load = BatteryMonitor::LOAD_IDLE;
+    if (sessionSync.isActive() || dfuActive() || rawStreaming()) {
+        load = BatteryMonitor::LOAD_STREAMING;
+    } else if (ble.getGapState().connected) {
+        load = BatteryMonitor::LOAD_CONNECTED;
+    }
+    batteryMonitor.setLoad(load);
+    if (!batteryMonitor.sampleDue(now())) {
+        return;
+    }
+
+    uint16_t millivolts = readSupplyMillivolts();
+    telemetryLog.onSupplyReading(millivolts);
+    if (batteryMonitor.addReading(millivolts, now())) {
+        uint8_t level = batteryMonitor.getLevel();
+        DEBUG("battery %u%%\r\n", level);
+        ble.updateCharacteristicValue(batteryLevel->getHandle(), &level, sizeof(level));
+    }
+}
+
+/**
+ * Notify one link of a measurement frame. BLE_API's update call doesn't
+ * take a connection handle and notifies the link the stack has; with the
+ * S110's single connection, that is 'link'.
+ */
+static ble_error_t notifyLink(ConnectionContext &link, const uint8_t *data, unsigned length)
+{
+    TRACE_STAGE_BEGIN(updateCycles);
+    ble_error_t error = ble.updateCharacteristicValue(hrmProfile.getMeasurementHandle(), data, length);
+    TRACE_STAGE_END(TRACE_STAGE_GATT_UPDATE, updateCycles);
+    if (error == BLE_ERROR_NONE) {
+        link.linkMonitor.onPacketQueued(now());
+    }
+    TRACE_EVENT(TRACE_EVENT_NOTIFICATION, length, error);
+    return error;
+}
+
+bool HrmLink::isSubscribed(void)
+{
+    return hrmSubscribed();
+}
+
+/**
+ * Notify every subscribed link of the frame. It is encoded once and only
+ * counts as sent when each of them has taken it; a link that refuses it
+ * has it offered again on a later pass, after a transmission has freed a
+ * buffer, while the links that already have it are skipped.
+ */
+bool HrmLink::send(const uint8_t *data, unsigned length)
+{
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        if ((c == 0) || !c->hrmSubscribed || (sentTo & (1 << i))) {
+            continue;
+        }
+        if (notifyLink(*c, data, length) != BLE_ERROR_NONE) {
+            return false;
+        }
+        sentTo |= (1 << i);
+        c->parameterManager.notificationSent(now());
+    }
+    sentTo = 0;
+    return true;
+}
+
+void HrmLink::discard(void)
+{
+    sentTo = 0;
+}
+
+#if TRACE_ENABLED
+#if TRACE_DRAIN_OVER_GATT
+unsigned traceSink(const uint8_t *data, unsigned length)
+{
+    if (!ble.getGapState().connected ||
+        (ble.updateCharacteristicValue(traceDataChar->getHandle(), data, length) != BLE_ERROR_NONE)) {
+        return 0;
+    }
+    return length;
+}
+static const unsigned TRACE_RECORDS_PER_CHUNK = TRACE_CHUNK_SIZE / sizeof(TraceRecord);
+#else
+unsigned traceSink(const uint8_t *data, unsigned length)
+{
+    for (unsigned i = 0; i < length; i++) {
+        if ((i % sizeof(TraceRecord)) == 0) {
+            pc.putc(0xA5); /* sync byte ahead of every record */
+        }
+        pc.putc(data[i]);
+    }
+    return length;
+}
+static const unsigned TRACE_RECORDS_PER_CHUNK = 4;
+#endif /* #if TRACE_DRAIN_OVER_GATT */
+static const unsigned TRACE_RECORDS_PER_IDLE  = 8; /* bound the time spent draining before sleeping */
+#endif /* #if TRACE_ENABLED */
+
+#if BENCHMARK_SCENARIO
+/**
+ * Drive the benchmark scenario and print a result line per measurement
+ * window. The format is versioned so that logs can be compared across commits.
+ */
+void runBenchmark(void)
+{
+    switch (benchmark.poll(now())) {
+        case Benchmark::ACTION_REPORT: {
+            const Benchmark::Counters &c = benchmark.getCounters();
+            pc.printf("BENCH v%u scenario=%u window_us=%lu notifications=%lu tx=%lu connections=%lu "
+                      "disconnections=%lu adv_changes=%lu wakeups=%lu beats=%lu\r\n",
+                      Benchmark::FORMAT_VERSION, BENCHMARK_SCENARIO, c.windowUs, c.notifications, c.txComplete,
+                      c.connections, c.disconnections, c.advertisingChanges, c.wakeups, c.beats);
+            break;
+        }
+        case Benchmark::ACTION_DISCONNECT:
+            ble.disconnect(Gap::REMOTE_USER_TERMINATED_CONNECTION);
+            break;
+        default:
+            break;
+    }
+}
+#endif /* #if BENCHMARK_SCENARIO */
+
+/**
+ * Arm a single timer for the earliest deadline across all producers, so that
+ * the core sleeps in waitForEvent() until there is actually something to do.
+ * Sample batches need no deadline: the acquisition ISR wakes us anyway.
+ */
+void armWakeup(void)
+{
+    static bool     armed = false;
+    static uint32_t armedDeadline;
+
+    uint32_t t = now();
+    uint32_t deadline;
+    bool     haveDeadline = false;
+    uint32_t when;
+
+    if (notificationScheduler.isPending()) {
+        deadline     = notificationScheduler.getFlushTime();
+        haveDeadline = true;
+    }
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        if ((c != 0) && c->parameterManager.getNextPollTime(t, when) &&
+            (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+            deadline     = when;
+            haveDeadline = true;
+        }
+        if ((c != 0) && c->linkMonitor.getNextPollTime(t, when) &&
+            (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+            deadline     = when;
+            haveDeadline = true;
+        }
+    }
+    if (advertisingManager.getNextDeadline(when) && (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+        deadline     = when;
+        haveDeadline = true;
+    }
+    when = batteryMonitor.getNextSampleTime();
+    if (!haveDeadline || ((int32_t)(when - deadline) < 0)) {
+        deadline     = when;
+        haveDeadline = true;
+    }
+    when = telemetryLog.getNextDeadline();
+    if ((int32_t)(when - deadline) < 0) {
+        deadline = when;
+    }
+    if (flashStore.getNextDeadline(when) && (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+        deadline     = when;
+        haveDeadline = true;
+    }
+#if DFU_SERVICE
+    if (dfuService.getNextDeadline(when) && (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+        deadline     = when;
+        haveDeadline = true;
+    }
+#endif
+    if (sessionActive && !hrmSubscribed()) {
+        when = lastBeatTime + SESSION_IDLE_US;
+        if (!haveDeadline || ((int32_t)(when - deadline) < 0)) {
+            deadline     = when;
+            haveDeadline = true;
+        }
+    }
+#if BENCHMARK_SCENARIO
+    if (benchmark.getNextDeadline(when) && (!haveDeadline || ((int32_t)(when - deadline) < 0))) {
+        deadline     = when;
+        haveDeadline = true;
+    }
+#endif
+
+    if (!haveDeadline) {
+        if (armed) {
+            wakeupTimeout.detach();
+            armed = false;
+        }
+        return;
+    }
+    if (armed && (deadline == armedDeadline)) {
+        return;
+    }
+
+    int32_t delay = (int32_t)(deadline - t);
+    wakeupTimeout.attach_us(wakeupCallback, (delay > 0) ? delay : 0);
+    armed         = true;
+    armedDeadline = deadline;
+}
+
+/*
+ * RAM taken by the application's own statics, per subsystem. The total is
+ * checked against RAM_STATIC_BUDGET at compile time, and the table printed
+ * at startup next to what the linker made of the whole image.
+ */
+#if RAW_WAVEFORM_EXPORT
+#define RAW_WAVEFORM_RAM sizeof(RawWaveformStream)
+#else
+#define RAW_WAVEFORM_RAM 0
+#endif
+#if DFU_SERVICE
+#define DFU_RAM sizeof(DfuService)
+#else
+#define DFU_RAM 0
+#endif
+#if TRACE_ENABLED
+#define TRACE_RAM sizeof(Trace)
+#else
+#define TRACE_RAM 0
+#endif
+#if BENCHMARK_SCENARIO
+#define BENCHMARK_RAM sizeof(Benchmark)
+#else
+#define BENCHMARK_RAM 0
+#endif
+#define APPLICATION_RAM(X)                                                                                    \
+    X("gatt arena",      sizeof(gattArena))                                                                  \
+    X("acquisition",     sizeof(SensorAcquisition))                                                          \
+    X("measurement",     sizeof(HrmProfile) + sizeof(HrmPipeline) + sizeof(NotificationScheduler) +          \
+                         sizeof(EnergyExpenditure))                                                          \
+    X("link management", sizeof(ConnectionTable) + sizeof(AdvertisingManager) + sizeof(PeerCache))           \
+    X("battery",         sizeof(BatteryMonitor))                                                             \
+    X("session log",     sizeof(FlashStore) + sizeof(SessionLog) + sizeof(SessionSync))                      \
+    X("dfu",             DFU_RAM)                                                                            \
+    X("hrv",             sizeof(HrvAnalyzer) + sizeof(HrvService))                                           \
+    X("telemetry",       sizeof(TelemetryLog) + TelemetryLog::RETAINED_SIZE + sizeof(DiagnosticsService))    \
+    X("startup",         sizeof(StartupSequencer))                                                           \
+    X("events",          sizeof(EventDispatcher))                                                            \
+    X("raw waveform",    RAW_WAVEFORM_RAM)                                                                   \
+    X("trace",           TRACE_RAM)                                                                          \
+    X("benchmark",       BENCHMARK_RAM)
+
+#define MEMORY_BUDGET_SUM(name, bytes)   + (bytes)
+#define MEMORY_BUDGET_ENTRY(name, bytes) {name, (unsigned)(bytes)},
+MEMORY_BUDGET_ASSERT((0 APPLICATION_RAM(MEMORY_BUDGET_SUM)) <= RAM_STATIC_BUDGET, applicationRamOverBudget);
+
+#if NEED_CONSOLE_OUTPUT
+static const MemoryBudgetEntry memoryBudget[] = {
+    APPLICATION_RAM(MEMORY_BUDGET_ENTRY)
+};
+
+void reportMemoryBudget(void)
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < (sizeof(memoryBudget) / sizeof(memoryBudget[0])); i++) {
+        DEBUG("ram %-16s %5u\r\n", memoryBudget[i].name, memoryBudget[i].bytes);
+        total += memoryBudget[i].bytes;
+    }
+    DEBUG("ram total            %5u of %u\r\n", total, RAM_STATIC_BUDGET);
+    DEBUG("gatt arena %u of %u bytes used\r\n", gattArena.getUsed(), gattArena.getSize());
+    DEBUG("statics end at 0x%08lx, image ends at 0x%05lx of 0x%05x\r\n", getStaticRamEnd(), getImageFlashEnd(),
+          APPLICATION_END);
+}
+#endif /* #if NEED_CONSOLE_OUTPUT */
+
+/*
+ * Startup stages, in the order they run. The GATT table is complete before
+ * the advertising payload is assembled, and advertising starts last, so a
+ * central can never connect to a half-populated service table.
+ */
+void initBleStage(void)
+{
+    ble.init();
+    ble.onDisconnection(disconnectionCallback);
+    ble.onConnection(onConnectionCallback);
+    ble.onDataSent(dataSentCallback);
+    ble.onUpdatesEnabled(updatesEnabledCallback);
+    ble.onUpdatesDisabled(updatesDisabledCallback);
+    ble.onDataWritten(dataWrittenCallback);
+    if (!tapSoftDeviceEvents(bleEventCallback, systemEventCallback)) {
+        DEBUG("no SoftDevice event tap in this build\r\n");
+    }
+
+#if RAW_WAVEFORM_EXPORT
+    uint8_t txBuffers;
+    if (sd_ble_tx_buffer_count_get(&txBuffers) == NRF_SUCCESS) {
+        rawStream.setTxBufferCount(txBuffers);
+    }
+#endif
+
+    ble.getPreferredConnectionParams(&preferredParams);
+    connectedParams = preferredParams; /* in case the SoftDevice's events can't be tapped */
+    notificationScheduler.setConnectionInterval(preferredParams.minConnectionInterval);
+    notificationScheduler.setHoldTime(HrmProfile::HOLD_TIME_US);
+}
+
+void populateGattStage(void)
+{
+    hrmProfile.addService(gattArena);
+
+    /* A first measurement, so that the level reads right from the start. */
+    batteryMonitor.addReading(readSupplyMillivolts(), now());
+    uint8_t *level = gattArena.allocateValue(1);
+    *level = batteryMonitor.getLevel();
+    GattCharacteristic **batteryChars = gattArena.allocateList(1);
+    batteryLevel    = gattArena.addCharacteristic(GattCharacteristic::UUID_BATTERY_LEVEL_CHAR, level, 1, 1,
+                                                  GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_READ |
+                                                  GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    batteryChars[0] = batteryLevel;
+    ble.addService(*gattArena.addService(GattService::UUID_BATTERY_SERVICE, batteryChars, 1));
+
+    sessionSync.addService(gattArena);
+#if DFU_SERVICE
+    dfuService.addService(gattArena);
+#endif
+    hrvService.addService(gattArena);
+    diagnosticsService.addService(gattArena);
+#if RAW_WAVEFORM_EXPORT
+    rawStream.addService(gattArena);
+#endif
+#if TRACE_ENABLED && TRACE_DRAIN_OVER_GATT
+    traceDataChar = gattArena.addCharacteristic(TRACE_DATA_CHAR_UUID, gattArena.allocateValue(TRACE_CHUNK_SIZE),
+                                                TRACE_CHUNK_SIZE, TRACE_CHUNK_SIZE,
+                                                GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+    GattCharacteristic **traceChars = gattArena.allocateList(1);
+    traceChars[0] = traceDataChar;
+    ble.addService(*gattArena.addService(TRACE_SERVICE_UUID, traceChars, 1));
+#endif
+}
+
+void setupAdvertisingStage(void)
+{
+    accumulateAdvertisingImage(ble, advertisingBase, false);
+    accumulateAdvertisingImage(ble, localNameField, !NAME_IN_ADVERTISEMENT);
+    ble.setAdvertisingType(GapAdvertisingParams::ADV_CONNECTABLE_UNDIRECTED);
+}
+
+void flashDataStage(void)
+{
+    sessionLog.init();
+    peerCache.init();
+#if DFU_SERVICE
+    dfuService.init();
+#endif
+
+    /* Why the last run ended; the register accumulates until cleared. */
+    uint32_t resetReason = 0;
+    sd_power_reset_reason_get(&resetReason);
+    sd_power_reset_reason_clr(resetReason);
+    telemetryLog.init(resetReason, now());
+    TelemetryLog::Counters previous;
+    TelemetryLog::Source   source = telemetryLog.getPrevious(previous);
+    (void)source;
+    DEBUG("boot %lu, reset reason 0x%05lx; last run up %lus (source %u), supply down to %umV\r\n",
+          telemetryLog.getCurrent().bootCount, resetReason, previous.uptimeSeconds, source,
+          previous.minSupplyMillivolts);
+}
+
+void warmUpSensorStage(void)
+{
+    sensor.onBatchReady(samplesReadyCallback);
+    sensor.warmUp();
+}
+
+void startAdvertisingStage(void)
+{
+    advertisingManager.start(now(), peerCache.getCount() > 0); /* the last central may still be waiting after a reset */
+    updateAdvertising(); /* on the air now rather than on the first pass of the main loop */
+    wakeButton.fall(wakeButtonCallback);
+}
+
+static const StartupSequencer::StageDescriptor startupStages[] = {
+    {"ble init",          initBleStage},
+    {"gatt database",     populateGattStage},
+    {"advertising setup", setupAdvertisingStage},
+    {"flash data",        flashDataStage},
+    {"sensor warm-up",    warmUpSensorStage},
+    {"advertising start", startAdvertisingStage},
+};
+
+/*
+ * Main loop event handlers, registered in mainEvents. Each runs to
+ * completion, so each only does a bounded amount of work: a flash erase is
+ * started, never waited for, and the radio events are never queued behind
+ * it by more than one handler.
+ */
+void txCompleteEvent(void)
+{
+    readLinkRssi();
+    for (unsigned i = 0; i < ConnectionTable::MAX_CONNECTIONS; i++) {
+        ConnectionContext *c = connections.get(i);
+        if ((c != 0) && c->linkMonitor.hasNewWindow()) {
+            /* A new link quality figure; losses raise the power right away. */
+            dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_HOUSEKEEPING);
+            break;
+        }
+    }
+    if (hrmPipeline.getQueuedCount() > 0) {
+        hrmPipeline.send();
+    }
+    sessionSync.poll();
+#if RAW_WAVEFORM_EXPORT
+    rawStream.pump();
+#endif
+}
+
+/**
+ * The policy polls and the flash clients, behind whatever else is pending.
+ * Deadlines and link events are what changes their answers; a sample batch
+ * only ever gives the session log something to write.
+ */
+static void postPolls(void)
+{
+    dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_HOUSEKEEPING);
+    dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_FLASH);
+    dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_DIAGNOSTICS);
+}
+
+void deadlineEvent(void)
+{
+    postPolls();
+    if (notificationScheduler.shouldFlush(now())) {
+        hrmPipeline.flush(now());
+    }
+#if DFU_SERVICE
+    if (dfuService.resetDue(now())) {
+        DEBUG("resetting for the bootloader\r\n");
+        sd_nvic_SystemReset(); /* does not return */
+    }
+#endif
+}
+
+void samplesEvent(void)
+{
+    bool standby = inStandby();
+    SensorSample batch[SensorAcquisition::BATCH_SIZE]; /* the larger of the two batch sizes */
+    while (sensor.batchReady()) {
+        /* The sampling ISR keeps filling the ring while we work on this batch. */
+        unsigned count = sensor.drain(batch, SensorAcquisition::BATCH_SIZE);
+        processSamples(batch, count);
+    }
+    if (inStandby() != standby) {
+        /* Contact came or went: acquisition and advertising follow it. */
+        dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_HOUSEKEEPING);
+    }
+    if (sessionLogging) {
+        dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_FLASH);
+    }
+}
+
+void linkEvent(void)
+{
+    postPolls();
+    updateLinkQuality(); /* the default TX power back before advertising restarts */
+    updateAcquisition();
+    updateAdvertising();
+    updateEnergyExpended();
+    sessionSync.poll();
+#if DFU_SERVICE
+    dfuService.poll(now());
+#endif
+    hrvService.poll();
+    diagnosticsService.poll();
+}
+
+void buttonEvent(void)
+{
+    updateAdvertising();
+}
+
+void housekeepingEvent(void)
+{
+    updateAdvertising();
+    updateSession();
+    updateAcquisition();
+    updateBattery();
+    updateEnergyExpended();
+    updateLinkQuality();
+    updateConnectionParameters();
+    if (hrmPipeline.getQueuedCount() > 0) {
+        hrmPipeline.send(); /* whatever the last transmission complete left behind */
+    }
+}
+
+void flashEvent(void)
+{
+    flashStore.poll(now());
+    sessionLog.poll(now());
+    peerCache.poll(now());
+    telemetryLog.poll(now());
+    sessionSync.poll();
+#if DFU_SERVICE
+    dfuService.poll(now());
+    if (dfuService.isValidating()) {
+        dispatcher.post(EventDispatcher::SOURCE_MAIN, EVENT_FLASH); /* the next page, after anything more urgent */
+    }
+#endif
+}
+
+void diagnosticsEvent(void)
+{
+#if TRACE_ENABLED
+    trace.drain(traceSink, TRACE_RECORDS_PER_CHUNK, TRACE_RECORDS_PER_IDLE);
+#endif
+#if BENCHMARK_SCENARIO
+    runBenchmark();
+#endif
+}
+
+#if NEED_CONSOLE_OUTPUT
+/**
+ * How far the main loop has fallen behind its interrupts, if at all: posts
+ * lost to a full queue, and posts that found their event already pending.
+ */
+static void reportEventBacklog(void)
+{
+    static uint32_t reportedDropped = 0;
+    uint32_t        dropped = dispatcher.getDroppedCount();
+    if (dropped != reportedDropped) {
+        DEBUG("%lu event posts dropped\r\n", dropped - reportedDropped);
+        reportedDropped = dropped;
+    }
+
+    static uint32_t reportedCoalesced[NUM_MAIN_EVENTS] = {0};
+    for (unsigned i = 0; i < NUM_MAIN_EVENTS; i++) {
+        uint32_t coalesced = dispatcher.getCoalescedCount(i);
+        if (coalesced != reportedCoalesced[i]) {
+            DEBUG("%lu %s events coalesced\r\n", coalesced - reportedCoalesced[i], mainEvents[i].name);
+            reportedCoalesced[i] = coalesced;
+        }
+    }
+}
+#endif
+
+int main(void)
+{
+    led1 = 0;
+    systemClock.start();
+#if TRACE_ENABLED
+    trace.init(now);
+    TRACE_EVENT(TRACE_EVENT_BOOT, 0);
+#endif
+
+    DEBUG("Initialising the nRF51822\n\r");
+    startup.run(startupStages, sizeof(startupStages) / sizeof(startupStages[0]));
+    for (unsigned i = 0; i < startup.getStageCount(); i++) {
+        DEBUG("%s: %luus\r\n", startup.getStageName(i), startup.getStageDuration(i));
+    }
+    DEBUG("first advertisement after %luus\r\n", startup.getTimeToFirstAdvertisement());
+#if NEED_CONSOLE_OUTPUT
+    reportMemoryBudget();
+#endif
+
+#if BENCHMARK_SCENARIO
+    if (BENCHMARK_SCENARIO != BENCHMARK_IDLE_ADVERTISING) {
+        sensor.setSampleSource(Benchmark::syntheticSample);
+    }
+    benchmark.begin(now());
+#endif
+
+    postPolls();
+    while (true) {
+        uint32_t woken = now();
+        /* A wakeup that posted nothing (a single sample, most of the time) changed no deadline either. */
+        if (dispatcher.dispatch() > 0) {
+#if NEED_CONSOLE_OUTPUT
+            reportEventBacklog();
+#endif
+            armWakeup();
+            telemetryLog.onLoopPass(now() - woken);
+        }
+        ble.waitForEvent();
+        BENCHMARK_HOOK(onWakeup());
+    }
+}